@@ -0,0 +1,209 @@
+// Compares the broadphase backends on the body distributions our scenes
+// produce. Usage: broadphase_bench [bodies] [ticks]
+
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <absl/strings/str_format.h>
+#include <absl/time/clock.h>
+#include <absl/time/time.h>
+
+#include "sunset/aabb_tree.h"
+#include "sunset/broadphase.h"
+#include "sunset/hash_grid.h"
+#include "sunset/octree.h"
+#include "sunset/sweep_and_prune.h"
+
+namespace {
+
+struct Body {
+  AABB aabb;
+  glm::vec3 velocity;
+};
+
+struct Scene {
+  std::string name;
+  std::vector<Body> bodies;
+  // Bodies leaving the world box wrap around to the other side.
+  float extent;
+};
+
+using SceneFactory = std::function<Scene(size_t, std::mt19937 &)>;
+
+Body makeBody(glm::vec3 center, float half, glm::vec3 velocity) {
+  return {AABB{center - glm::vec3(half), center + glm::vec3(half)},
+          velocity};
+}
+
+// Boxes of mixed sizes drifting randomly in a cube.
+Scene uniformScene(size_t count, std::mt19937 &rng) {
+  float extent = 2.0f * std::cbrt(static_cast<float>(count));
+  std::uniform_real_distribution<float> pos(-extent, extent);
+  std::uniform_real_distribution<float> half(0.1f, 1.0f);
+  std::uniform_real_distribution<float> vel(-0.05f, 0.05f);
+
+  Scene scene{"uniform", {}, extent};
+  for (size_t i = 0; i < count; i++) {
+    scene.bodies.push_back(makeBody({pos(rng), pos(rng), pos(rng)},
+                                    half(rng),
+                                    {vel(rng), vel(rng), vel(rng)}));
+  }
+  return scene;
+}
+
+// Small bullets like the ones spawned in main.cpp, flying along x in
+// narrow lanes.
+Scene streamScene(size_t count, std::mt19937 &rng) {
+  float extent = 4.0f * std::sqrt(static_cast<float>(count));
+  std::uniform_real_distribution<float> along(-extent, extent);
+  std::uniform_real_distribution<float> across(-8.0f, 8.0f);
+  std::uniform_real_distribution<float> speed(0.3f, 0.5f);
+
+  Scene scene{"stream", {}, extent};
+  for (size_t i = 0; i < count; i++) {
+    scene.bodies.push_back(makeBody({along(rng), across(rng), across(rng)},
+                                    0.05f, {speed(rng), 0.0f, 0.0f}));
+  }
+  return scene;
+}
+
+// Crates stacked on a floor, barely moving.
+Scene pileScene(size_t count, std::mt19937 &rng) {
+  size_t side = static_cast<size_t>(std::sqrt(static_cast<float>(count)));
+  std::uniform_real_distribution<float> jitter(-0.01f, 0.01f);
+
+  Scene scene{"pile", {}, static_cast<float>(side)};
+  for (size_t i = 0; i < count; i++) {
+    glm::vec3 center{static_cast<float>(i % side),
+                     static_cast<float>(i / (side * side)),
+                     static_cast<float>((i / side) % side)};
+    scene.bodies.push_back(makeBody(center, 0.5f,
+                                    {jitter(rng), jitter(rng),
+                                     jitter(rng)}));
+  }
+  return scene;
+}
+
+void step(Scene &scene) {
+  for (Body &body : scene.bodies) {
+    body.aabb = body.aabb.translate(body.velocity);
+    for (int axis = 0; axis < 3; axis++) {
+      float wrap = 2.0f * scene.extent;
+      if (body.aabb.min[axis] > scene.extent) {
+        body.aabb.min[axis] -= wrap;
+        body.aabb.max[axis] -= wrap;
+      } else if (body.aabb.max[axis] < -scene.extent) {
+        body.aabb.min[axis] += wrap;
+        body.aabb.max[axis] += wrap;
+      }
+    }
+  }
+}
+
+void run(const std::string &backend_name, Broadphase &broadphase,
+         Scene scene, size_t ticks) {
+  std::vector<std::pair<Entity, Entity>> pairs;
+  std::vector<Entity> candidates;
+  std::vector<BroadphaseProxy> proxies(scene.bodies.size());
+
+  auto gather = [&] {
+    for (size_t i = 0; i < scene.bodies.size(); i++) {
+      proxies[i] = {static_cast<Entity>(i + 1), scene.bodies[i].aabb};
+    }
+  };
+
+  gather();
+  absl::Time start = absl::Now();
+  broadphase.sync(proxies);
+  absl::Duration build = absl::Now() - start;
+
+  absl::Duration update_time = absl::ZeroDuration();
+  absl::Duration pair_time = absl::ZeroDuration();
+  absl::Duration query_time = absl::ZeroDuration();
+  size_t pair_count = 0;
+  size_t candidate_count = 0;
+
+  for (size_t tick = 0; tick < ticks; tick++) {
+    step(scene);
+
+    // Same as PhysicsSystem::syncBroadphase at the start of a tick.
+    gather();
+    start = absl::Now();
+    broadphase.sync(proxies);
+    update_time += absl::Now() - start;
+
+    start = absl::Now();
+    pairs.clear();
+    broadphase.queryPairs(pairs);
+    pair_time += absl::Now() - start;
+    pair_count += pairs.size();
+
+    // What moveObjectWithCollisions does: one swept-box query per body.
+    start = absl::Now();
+    for (const Body &body : scene.bodies) {
+      candidates.clear();
+      broadphase.query(body.aabb.merge(body.aabb.translate(body.velocity)),
+                       candidates);
+      candidate_count += candidates.size();
+    }
+    query_time += absl::Now() - start;
+  }
+
+  auto per_tick = [ticks](absl::Duration total) {
+    return absl::ToDoubleMilliseconds(total) / static_cast<double>(ticks);
+  };
+
+  std::cout << absl::StrFormat(
+      "%-8s %-16s %8zu %10.2f %10.3f %10.3f %10.3f %10zu %10zu\n",
+      scene.name, backend_name, scene.bodies.size(),
+      absl::ToDoubleMilliseconds(build), per_tick(update_time),
+      per_tick(pair_time), per_tick(query_time), pair_count / ticks,
+      candidate_count / ticks);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t bodies = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000;
+  size_t ticks = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 60;
+
+  std::vector<SceneFactory> scenes = {uniformScene, streamScene,
+                                     pileScene};
+
+  std::vector<
+      std::pair<std::string, std::function<std::unique_ptr<Broadphase>()>>>
+      backends = {
+          {"aabb_tree", [] { return std::make_unique<DynamicAABBTree>(); }},
+          {"sweep_and_prune",
+           [] { return std::make_unique<SweepAndPrune>(0); }},
+          {"hash_grid", [] { return std::make_unique<HashGrid>(1.0f); }},
+          {"loose_octree",
+           [] {
+             return std::make_unique<LooseOcTree>(
+                 AABB{glm::vec3(-1024.0f), glm::vec3(1024.0f)});
+           }},
+      };
+
+  std::cout << absl::StrFormat(
+      "%-8s %-16s %8s %10s %10s %10s %10s %10s %10s\n", "scene", "backend",
+      "bodies", "build ms", "sync ms", "pairs ms", "query ms", "pairs",
+      "candidates");
+
+  for (const SceneFactory &make_scene : scenes) {
+    std::mt19937 rng(42);
+    Scene scene = make_scene(bodies, rng);
+
+    for (const auto &[backend_name, make_backend] : backends) {
+      std::unique_ptr<Broadphase> broadphase = make_backend();
+      run(backend_name, *broadphase, scene, ticks);
+    }
+  }
+
+  return 0;
+}
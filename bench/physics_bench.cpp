@@ -0,0 +1,246 @@
+// Runs PhysicsSystem on standard scenes without a window or backend and
+// reports its throughput. Usage: physics_bench [bodies] [ticks]
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <absl/strings/str_format.h>
+#include <absl/time/clock.h>
+#include <absl/time/time.h>
+
+#include "sunset/ecs.h"
+#include "sunset/event_queue.h"
+#include "sunset/physics.h"
+
+namespace {
+
+std::atomic<size_t> allocations{0};
+
+} // namespace
+
+// Every allocation in the process goes through here, so the ones made
+// during a tick can be counted.
+void *operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *ptr = std::malloc(size ? size : 1)) return ptr;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, std::size_t /* size */) noexcept {
+  std::free(ptr);
+}
+
+namespace {
+
+const glm::vec3 kGravity{0.0f, -0.01f, 0.0f};
+
+struct Scene {
+  std::string name;
+  // Run before each tick, e.g. to steer agents.
+  std::function<void(ECS &, size_t)> drive;
+};
+
+using SceneFactory = std::function<Scene(ECS &, size_t, std::mt19937 &)>;
+
+AABB boxAround(glm::vec3 center, glm::vec3 half) {
+  return {center - half, center + half};
+}
+
+Entity addBody(ECS &ecs, glm::vec3 center, glm::vec3 half,
+               PhysicsComponent physics) {
+  Entity entity = ecs.createEntity();
+  physics.collider = boxAround(center, half);
+  ecs.addComponents(entity, Transform{.position = center}, physics);
+  return entity;
+}
+
+Entity addStatic(ECS &ecs, glm::vec3 center, glm::vec3 half) {
+  return addBody(ecs, center, half,
+                 {.type = PhysicsComponent::Type::Static});
+}
+
+// Crates dropped in layers onto a floor, settling into a pile.
+Scene pileScene(ECS &ecs, size_t count, std::mt19937 &rng) {
+  size_t side = std::max<size_t>(
+      1, static_cast<size_t>(std::sqrt(static_cast<float>(count) / 8)));
+  std::uniform_real_distribution<float> jitter(-0.1f, 0.1f);
+
+  float extent = side * 0.6f;
+  addStatic(ecs, {extent, -0.5f, extent}, {extent + 1.0f, 0.5f,
+                                           extent + 1.0f});
+  for (size_t i = 0; i < count; i++) {
+    glm::vec3 center{(i % side) * 1.2f + jitter(rng),
+                     1.0f + (i / (side * side)) * 1.2f,
+                     ((i / side) % side) * 1.2f + jitter(rng)};
+    addBody(ecs, center, glm::vec3(0.5f),
+            {.acceleration = kGravity,
+             .material = {.friction = 0.5f, .restitution = 0.2f}});
+  }
+  return {"pile", {}};
+}
+
+// Small continuous projectiles flying every which way inside a closed
+// box, hitting each other and the walls.
+Scene stormScene(ECS &ecs, size_t count, std::mt19937 &rng) {
+  float extent = 2.0f * std::cbrt(static_cast<float>(count));
+  std::uniform_real_distribution<float> pos(-extent, extent);
+  std::normal_distribution<float> dir(0.0f, 1.0f);
+
+  for (int axis = 0; axis < 3; axis++) {
+    for (float side : {-1.0f, 1.0f}) {
+      glm::vec3 center(0.0f);
+      center[axis] = side * (extent + 1.0f);
+      glm::vec3 half(extent + 2.0f);
+      half[axis] = 0.5f;
+      addStatic(ecs, center, half);
+    }
+  }
+  for (size_t i = 0; i < count; i++) {
+    glm::vec3 velocity{dir(rng), dir(rng), dir(rng)};
+    addBody(ecs, {pos(rng), pos(rng), pos(rng)}, glm::vec3(0.05f),
+            {.velocity = glm::normalize(velocity) * 0.5f,
+             .continuous = true});
+  }
+  return {"storm", {}};
+}
+
+// Chains of 16 links hanging from fixed anchors, released sideways.
+Scene chainScene(ECS &ecs, size_t count, std::mt19937 & /* rng */) {
+  constexpr size_t kLinks = 16;
+  size_t chains = std::max<size_t>(1, count / kLinks);
+  size_t side = static_cast<size_t>(
+      std::ceil(std::sqrt(static_cast<float>(chains))));
+
+  for (size_t chain = 0; chain < chains; chain++) {
+    glm::vec3 anchor{(chain % side) * 3.0f, kLinks + 2.0f,
+                     (chain / side) * 20.0f};
+    Entity previous = addStatic(ecs, anchor, glm::vec3(0.1f));
+    for (size_t link = 1; link < kLinks; link++) {
+      Entity entity =
+          addBody(ecs, anchor + glm::vec3(0.0f, 0.0f, link * 1.0f),
+                  glm::vec3(0.2f), {.acceleration = kGravity});
+      ecs.addComponents(entity, Constraint{previous, 1.0f});
+      previous = entity;
+    }
+  }
+  return {"chains", {}};
+}
+
+// Agents walking a walled grid, each picking a new heading now and then.
+Scene mazeScene(ECS &ecs, size_t count, std::mt19937 &rng) {
+  size_t walls = count / 4;
+  size_t agents = count - walls;
+  size_t side = std::max<size_t>(
+      2, static_cast<size_t>(std::sqrt(static_cast<float>(count))));
+  float cell = 4.0f;
+  std::bernoulli_distribution coin(0.5);
+  std::uniform_real_distribution<float> pos(0.0f, side * cell);
+
+  for (size_t i = 0; i < walls; i++) {
+    glm::vec3 corner{(i % side) * cell, 1.0f,
+                     ((i / side) % side) * cell};
+    glm::vec3 half = coin(rng) ? glm::vec3(cell * 0.5f, 1.0f, 0.1f)
+                               : glm::vec3(0.1f, 1.0f, cell * 0.5f);
+    addStatic(ecs, corner + glm::vec3(half.x, 0.0f, half.z), half);
+  }
+  for (size_t i = 0; i < agents; i++) {
+    Entity entity =
+        addBody(ecs, {pos(rng), 1.0f, pos(rng)}, glm::vec3(0.3f),
+                {.material = {.friction = 0.5f, .restitution = 0.0f}});
+    ecs.addComponents(entity, MovementIntent{});
+  }
+
+  // Headings change every second, and not all at once.
+  auto headings = std::make_shared<std::vector<glm::vec3>>();
+  auto heading_rng = std::make_shared<std::mt19937>(rng());
+  return {"maze", [=](ECS &ecs, size_t tick) {
+            std::uniform_real_distribution<float> angle(0.0f, 6.2832f);
+            size_t agent = 0;
+            ecs.forEach(std::function(
+                [&](Entity entity, MovementIntent *intent) {
+                  if (agent >= headings->size()) {
+                    headings->emplace_back(0.0f);
+                  }
+                  glm::vec3 &heading = (*headings)[agent];
+                  if ((tick + agent++) % 60 == 0) {
+                    float a = angle(*heading_rng);
+                    heading = {std::cos(a), 0.0f, std::sin(a)};
+                  }
+                  intent->displacement += heading * 0.05f;
+                }));
+          }};
+}
+
+void run(const SceneFactory &make_scene, size_t bodies, size_t ticks) {
+  ECS ecs;
+  EventQueue event_queue;
+  PhysicsSystem physics;
+  std::mt19937 rng(42);
+  Scene scene = make_scene(ecs, bodies, rng);
+
+  size_t contacts = 0;
+  event_queue.subscribe(
+      std::function([&](const Collision &) { contacts++; }));
+
+  // The first update builds the broadphase and static BVH.
+  absl::Time start = absl::Now();
+  physics.update(ecs, event_queue, physics.step());
+  event_queue.process();
+  absl::Duration build = absl::Now() - start;
+  contacts = 0;
+
+  size_t tested_count = 0;
+  size_t allocation_count = 0;
+  absl::Duration step_time = absl::ZeroDuration();
+  for (size_t tick = 0; tick < ticks; tick++) {
+    if (scene.drive) scene.drive(ecs, tick);
+
+    size_t allocated = allocations.load(std::memory_order_relaxed);
+    start = absl::Now();
+    physics.update(ecs, event_queue, physics.step());
+    step_time += absl::Now() - start;
+    allocation_count +=
+        allocations.load(std::memory_order_relaxed) - allocated;
+
+    tested_count += physics.testedPairs();
+    event_queue.process();
+  }
+
+  double seconds = absl::ToDoubleSeconds(step_time);
+  std::cout << absl::StrFormat(
+      "%-8s %8zu %10.2f %10.1f %10.3f %10zu %10zu %10zu\n", scene.name,
+      bodies, absl::ToDoubleMilliseconds(build), ticks / seconds,
+      seconds * 1000.0 / ticks, tested_count / ticks, contacts / ticks,
+      allocation_count / ticks);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t bodies = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000;
+  size_t ticks = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 120;
+  if (ticks == 0) {
+    std::cerr << "usage: physics_bench [bodies] [ticks], ticks > 0\n";
+    return 1;
+  }
+
+  std::vector<SceneFactory> scenes = {pileScene, stormScene, chainScene,
+                                      mazeScene};
+
+  std::cout << absl::StrFormat("%-8s %8s %10s %10s %10s %10s %10s %10s\n",
+                               "scene", "bodies", "build ms", "ticks/s",
+                               "ms/tick", "tested", "contacts", "allocs");
+  for (const SceneFactory &make_scene : scenes) {
+    run(make_scene, bodies, ticks);
+  }
+  return 0;
+}
@@ -0,0 +1,141 @@
+// Compares building world matrices with glm against the batched kernels
+// in transform_batch.h at each SIMD level. Usage:
+// transform_bench [transforms] [iterations]
+
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <absl/strings/str_format.h>
+#include <absl/time/clock.h>
+#include <absl/time/time.h>
+#include <glm/ext/matrix_transform.hpp>
+
+#include "sunset/aabb_batch.h"
+#include "sunset/transform_batch.h"
+
+namespace {
+
+struct Pose {
+  glm::vec3 position;
+  glm::quat rotation;
+  float scale;
+};
+
+std::vector<Pose> randomPoses(size_t count, std::mt19937 &rng) {
+  std::normal_distribution<float> dist(0.0f, 1.0f);
+  std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+  std::vector<Pose> poses;
+  for (size_t i = 0; i < count; i++) {
+    poses.push_back(
+        {{dist(rng), dist(rng), dist(rng)},
+         glm::normalize(glm::quat(dist(rng), dist(rng), dist(rng),
+                                  dist(rng))),
+         scale(rng)});
+  }
+  return poses;
+}
+
+// The path calculateModelMatrix takes.
+glm::mat4 glmCompose(const Pose &pose) {
+  glm::mat4 model = glm::translate(glm::mat4(1.0f), pose.position);
+  model *= glm::toMat4(pose.rotation);
+  return glm::scale(model, glm::vec3(pose.scale));
+}
+
+// Sums the matrices so the work can't be optimized away.
+float checksum(const std::vector<glm::mat4> &matrices) {
+  float sum = 0.0f;
+  for (const glm::mat4 &m : matrices) {
+    sum += m[0][0] + m[1][1] + m[2][2] + m[3][0];
+  }
+  return sum;
+}
+
+void run(const std::string &name, size_t transforms, size_t iterations,
+         const std::function<void()> &fn,
+         const std::vector<glm::mat4> &out) {
+  fn();
+  absl::Time start = absl::Now();
+  for (size_t i = 0; i < iterations; i++) fn();
+  absl::Duration total = absl::Now() - start;
+
+  double ms = absl::ToDoubleMilliseconds(total) /
+              static_cast<double>(iterations);
+  std::cout << absl::StrFormat("%-18s %10zu %10.3f %10.2f %14.3f\n", name,
+                               transforms, ms,
+                               ms * 1e6 / static_cast<double>(transforms),
+                               checksum(out));
+}
+
+std::string levelName(SimdLevel level) {
+  switch (level) {
+    case SimdLevel::AVX2:
+      return "avx2";
+    case SimdLevel::SSE:
+      return "sse";
+    default:
+      return "scalar";
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t transforms =
+      argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+  size_t iterations = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100;
+
+  std::mt19937 rng(42);
+  std::vector<Pose> poses = randomPoses(transforms, rng);
+  std::vector<Pose> parent_poses = randomPoses(transforms, rng);
+
+  TRSBatch batch;
+  batch.reserve(transforms);
+  std::vector<glm::mat4> locals, parents;
+  for (size_t i = 0; i < transforms; i++) {
+    batch.push(poses[i].position, poses[i].rotation, poses[i].scale);
+    locals.push_back(glmCompose(poses[i]));
+    parents.push_back(glmCompose(parent_poses[i]));
+  }
+  std::vector<glm::mat4> out(transforms);
+
+  std::cout << absl::StrFormat("%-18s %10s %10s %10s %14s\n", "kernel",
+                               "transforms", "ms", "ns each", "checksum");
+
+  run("compose glm", transforms, iterations,
+      [&] {
+        for (size_t i = 0; i < transforms; i++) {
+          out[i] = glmCompose(poses[i]);
+        }
+      },
+      out);
+  SimdLevel best = detectSimdLevel();
+  for (SimdLevel level :
+       {SimdLevel::Scalar, SimdLevel::SSE, SimdLevel::AVX2}) {
+    if (level > best) break;
+    setSimdLevel(level);
+    run("compose " + levelName(level), transforms, iterations,
+        [&] { composeTRS(batch.view(), out); }, out);
+  }
+
+  run("multiply glm", transforms, iterations,
+      [&] {
+        for (size_t i = 0; i < transforms; i++) {
+          out[i] = parents[i] * locals[i];
+        }
+      },
+      out);
+  for (SimdLevel level :
+       {SimdLevel::Scalar, SimdLevel::SSE, SimdLevel::AVX2}) {
+    if (level > best) break;
+    setSimdLevel(level);
+    run("multiply " + levelName(level), transforms, iterations,
+        [&] { multiplyAffine(parents, locals, out); }, out);
+  }
+
+  return 0;
+}
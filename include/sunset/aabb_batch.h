@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "sunset/geometry.h"
+
+// Boxes stored as six separate coordinate arrays, the layout the batch
+// kernels below read 4 (SSE) or 8 (AVX2) boxes at a time from.
+class AABBBatch {
+ public:
+  struct View {
+    const float *min_x;
+    const float *min_y;
+    const float *min_z;
+    const float *max_x;
+    const float *max_y;
+    const float *max_z;
+    size_t size;
+
+    AABB get(size_t i) const {
+      return {{min_x[i], min_y[i], min_z[i]},
+              {max_x[i], max_y[i], max_z[i]}};
+    }
+  };
+
+  size_t size() const { return min_x_.size(); }
+
+  bool empty() const { return min_x_.empty(); }
+
+  void clear();
+
+  void reserve(size_t count);
+
+  void push(const AABB &aabb);
+
+  void set(size_t i, const AABB &aabb);
+
+  void resize(size_t count);
+
+  AABB get(size_t i) const { return view().get(i); }
+
+  // Removes box i, shifting the following ones down.
+  void erase(size_t i);
+
+  // Moves box `from` to `to`, shifting the boxes in between by one.
+  void rotate(size_t from, size_t to);
+
+  // Coordinate `axis` of the lower corners, e.g. for sorting.
+  const std::vector<float> &mins(int axis) const;
+
+  // Coordinate `axis` of the upper corners.
+  const std::vector<float> &maxs(int axis) const;
+
+  View view() const { return view(0, size()); }
+
+  View view(size_t begin, size_t end) const;
+
+ private:
+  std::vector<float> min_x_, min_y_, min_z_;
+  std::vector<float> max_x_, max_y_, max_z_;
+};
+
+enum class SimdLevel { Scalar, SSE, AVX2 };
+
+// Best level the CPU supports; detected once.
+SimdLevel detectSimdLevel();
+
+// Level the kernels use, detectSimdLevel() unless overridden.
+SimdLevel simdLevel();
+
+// Caps the kernels at `level` (clamped to what the CPU supports), e.g. to
+// compare against the scalar path.
+void setSimdLevel(SimdLevel level);
+
+// Defined where the SSE and AVX2 kernels can be compiled. Each one has a
+// scalar version taking a start index, which it calls to finish the
+// tail that doesn't fill a vector.
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SUNSET_X86_SIMD 1
+#endif
+
+inline size_t maskWords(size_t count) { return (count + 63) / 64; }
+
+// Sets bit i of `mask` when `box` overlaps boxes[i] (touching counts, as
+// in AABB::intersects). `mask` holds maskWords(boxes.size) words.
+void overlapMask(const AABB &box, const AABBBatch::View &boxes,
+                 std::span<uint64_t> mask);
+
+// Calls fn(i) for every set bit below `count`, in increasing order.
+template <typename F>
+void forEachSetBit(std::span<const uint64_t> mask, size_t count, F &&fn) {
+  for (size_t word = 0; word < maskWords(count); word++) {
+    for (uint64_t bits = mask[word]; bits != 0; bits &= bits - 1) {
+      size_t i = word * 64 + static_cast<size_t>(__builtin_ctzll(bits));
+      if (i >= count) return;
+      fn(i);
+    }
+  }
+}
+
+// Slab test of `ray` against each box: entry distance in [0,
+// max_distance], or infinity on a miss. Matches Ray::intersect.
+void raySlabs(const Ray &ray, float max_distance,
+              const AABBBatch::View &boxes, std::span<float> out);
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "sunset/broadphase.h"
+
+// Incrementally maintained bounding volume hierarchy over fattened leaf
+// boxes. A leaf is only reinserted when its body leaves the fat box, and
+// inserts pick the sibling with the lowest surface area cost, with tree
+// rotations keeping it balanced.
+class DynamicAABBTree : public Broadphase {
+ public:
+  static constexpr float kDefaultMargin = 0.1f;
+
+  explicit DynamicAABBTree(float margin = kDefaultMargin);
+
+  void insert(Entity entity, const AABB &aabb) override;
+
+  void remove(Entity entity) override;
+
+  void update(Entity entity, const AABB &aabb) override;
+
+  bool contains(Entity entity) const override {
+    return leaves_.contains(entity);
+  }
+
+  size_t size() const override { return leaves_.size(); }
+
+  void entities(std::vector<Entity> &out) const override;
+
+  void query(const AABB &aabb, std::vector<Entity> &out) const override;
+
+  void queryRay(const Ray &ray, float max_distance,
+                std::vector<Entity> &out) const override;
+
+  void queryPairs(
+      std::vector<std::pair<Entity, Entity>> &out) const override;
+
+  // Height of the root; 0 for a single leaf, -1 when empty.
+  int32_t height() const;
+
+ private:
+  static constexpr int32_t kNull = -1;
+
+  struct Node {
+    AABB aabb;
+    // Parent while in the tree, next free node while on the free list.
+    int32_t parent{kNull};
+    int32_t child1{kNull};
+    int32_t child2{kNull};
+    int32_t height{0};
+    Entity entity{0};
+
+    bool isLeaf() const { return child1 == kNull; }
+  };
+
+  float margin_;
+  std::vector<Node> nodes_;
+  int32_t root_{kNull};
+  int32_t free_list_{kNull};
+  std::unordered_map<Entity, int32_t> leaves_;
+
+  int32_t allocateNode();
+
+  void freeNode(int32_t index);
+
+  void insertLeaf(int32_t leaf);
+
+  void removeLeaf(int32_t leaf);
+
+  // Walks from `index` to the root, rebalancing and refitting each node.
+  void refit(int32_t index);
+
+  int32_t balance(int32_t index);
+};
@@ -86,6 +86,9 @@ struct VertexAttribute {
   uint32_t binding;
   uint64_t offset;
   uint32_t stride;
+  // Advance once every `divisor` instances instead of once per vertex;
+  // 0 makes it a per-vertex attribute.
+  uint32_t divisor = 0;
 };
 
 struct Uniform {
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "sunset/aabb_batch.h"
+#include "sunset/ecs.h"
+#include "sunset/flat_hash.h"
+
+// The per-step physics state of every body, one array per field, indexed
+// by body. Loops over all bodies stream through these instead of the
+// PhysicsComponents, which also carry cold fields (mass, material,
+// collision source). Filled from the ECS at the start of a step and its
+// velocities written back once the bodies have been integrated.
+class BodyStore {
+ public:
+  // Copies the bodies out of the ECS, in forEach order, and saves their
+  // transforms as the previous pose.
+  void gather(ECS &ecs);
+
+  // Writes the velocities back. Nothing may be added to or removed from
+  // the ECS since gather().
+  void scatter(ECS &ecs) const;
+
+  // Adds acceleration * ticks to the velocity of every awake body that
+  // isn't Static.
+  void integrate(float ticks);
+
+  size_t size() const { return entities_.size(); }
+
+  // Index of `entity`, if it was gathered.
+  const uint32_t *find(Entity entity);
+
+  Entity entity(uint32_t body) const { return entities_[body]; }
+
+  glm::vec3 position(uint32_t body) const { return positions_[body]; }
+
+  glm::vec3 velocity(uint32_t body) const { return velocities_[body]; }
+
+  void setVelocity(uint32_t body, glm::vec3 velocity) {
+    velocities_[body] = velocity;
+  }
+
+  const AABBBatch &colliders() const { return colliders_; }
+
+  void setCollider(uint32_t body, const AABB &aabb) {
+    colliders_.set(body, aabb);
+  }
+
+  bool isStatic(uint32_t body) const { return static_[body]; }
+
+  bool sleeping(uint32_t body) const { return sleeping_[body]; }
+
+  void setSleeping(uint32_t body, bool sleeping) {
+    sleeping_[body] = sleeping;
+  }
+
+ private:
+  std::vector<Entity> entities_;
+  std::vector<glm::vec3> positions_;
+  std::vector<glm::vec3> velocities_;
+  std::vector<glm::vec3> accelerations_;
+  AABBBatch colliders_;
+  std::vector<uint8_t> static_;
+  std::vector<uint8_t> sleeping_;
+
+  // Built on the first find() after a gather; most steps need none.
+  FlatHashMap<Entity, uint32_t> index_;
+  bool indexed_{false};
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "sunset/ecs.h"
+#include "sunset/geometry.h"
+
+struct BroadphaseProxy {
+  Entity entity;
+  AABB aabb;
+};
+
+// Spatial index over the colliders of the physics world, used to find
+// the bodies a moving body may touch without scanning all of them.
+// Queries may report false positives (e.g. from fattened boxes), never
+// false negatives; callers run the exact test.
+class Broadphase {
+ public:
+  virtual ~Broadphase() = default;
+
+  virtual void insert(Entity entity, const AABB &aabb) = 0;
+
+  virtual void remove(Entity entity) = 0;
+
+  virtual void update(Entity entity, const AABB &aabb) = 0;
+
+  virtual bool contains(Entity entity) const = 0;
+
+  virtual size_t size() const = 0;
+
+  // Appends every tracked entity.
+  virtual void entities(std::vector<Entity> &out) const = 0;
+
+  // Appends the entities whose boxes may overlap `aabb`.
+  virtual void query(const AABB &aabb, std::vector<Entity> &out) const = 0;
+
+  // Appends the entities whose boxes `ray` may hit within max_distance.
+  // By default, those overlapping the bounds of the segment.
+  virtual void queryRay(const Ray &ray, float max_distance,
+                        std::vector<Entity> &out) const;
+
+  // Appends every pair of entities whose boxes may overlap, once each,
+  // with first < second.
+  virtual void queryPairs(
+      std::vector<std::pair<Entity, Entity>> &out) const = 0;
+
+  // Brings the index in line with `proxies`: inserts new entities,
+  // updates known ones and removes the ones that are gone.
+  virtual void sync(std::span<const BroadphaseProxy> proxies);
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "sunset/flat_hash.h"
+
+// Distance constraints between bodies, gathered once per step and solved
+// together: velocities with sequential impulses warm started from the
+// previous step, then positions by projection. Constraints are coloured
+// so that none in a colour share a movable body; each colour is solved
+// in parallel and the result doesn't depend on the thread count.
+class ConstraintSolver {
+ public:
+  // Constraints solved per chunk of a colour.
+  static constexpr size_t kGrain = 256;
+
+  // Empties the solver for the next step. Impulses of the constraints
+  // solved last are kept for warm starting.
+  void clear();
+
+  // Adds a body and returns its index. Bodies with zero inverse mass are
+  // never moved.
+  uint32_t addBody(glm::vec3 position, glm::vec3 velocity,
+                   float inverse_mass);
+
+  // Keeps bodies a and b `distance` apart. `key` identifies the
+  // constraint from step to step.
+  void addConstraint(uint64_t key, uint32_t a, uint32_t b, float distance);
+
+  void solve(int iterations);
+
+  size_t bodies() const { return inverse_masses_.size(); }
+
+  size_t constraints() const { return keys_.size(); }
+
+  // Colours of the last solve.
+  size_t colours() const { return colour_offsets_.size() - 1; }
+
+  glm::vec3 position(uint32_t body) const { return positions_[body]; }
+
+  glm::vec3 velocity(uint32_t body) const { return velocities_[body]; }
+
+ private:
+  // Colours tracked per body; constraints that fit none are solved
+  // serially after the others.
+  static constexpr uint32_t kMaxColours = 64;
+
+  std::vector<glm::vec3> positions_;
+  std::vector<glm::vec3> velocities_;
+  std::vector<float> inverse_masses_;
+
+  // Constraints as added, then reordered by colour in solve().
+  std::vector<uint64_t> keys_;
+  std::vector<uint32_t> body_a_;
+  std::vector<uint32_t> body_b_;
+  std::vector<float> distances_;
+  // Impulse applied along the constraint this step so far.
+  std::vector<float> impulses_;
+  std::vector<uint32_t> colour_offsets_{0};
+  // Start of the constraints that fit no colour.
+  uint32_t serial_begin_{0};
+
+  FlatHashMap<uint64_t, float> warm_impulses_;
+
+  void colour();
+
+  template <typename F>
+  void forEachColour(F &&solve_range);
+};
@@ -4,6 +4,7 @@
 #include "sunset/event_queue.h"
 
 struct Player {
+  // Walking speed in units per reference physics step.
   float speed;
   float sensitivity;
   bool sprinting;
@@ -15,6 +15,26 @@
 
 using Entity = uint32_t;
 
+// Entity references are saved as a node holding one integer, of any
+// width.
+template <>
+inline absl::StatusOr<Entity> deserializeTree(const PropertyTree &tree) {
+  if (tree.properties.empty()) {
+    return absl::InvalidArgumentError("Invalid entity");
+  }
+  return std::visit(
+      [](const auto &value) -> absl::StatusOr<Entity> {
+        using V = std::decay_t<decltype(value)>;
+        if constexpr (std::is_integral_v<V>) {
+          if (value >= 0 && static_cast<uint64_t>(value) <= UINT32_MAX) {
+            return static_cast<Entity>(value);
+          }
+        }
+        return absl::InvalidArgumentError("Invalid entity");
+      },
+      tree.properties[0]);
+}
+
 struct ComponentType {
   std::type_index type;
   size_t size;
@@ -255,15 +275,20 @@ class ECS {
     arch->addComponent(index, comp);
   }
 
+  // Null when `e` is destroyed or lacks a T.
   template <typename T>
   T const *getComponent(Entity e) const {
+    if (e >= entity_locations_.size()) return nullptr;
     auto [archetype, index] = entity_locations_[e];
+    if (!archetype) return nullptr;
     return archetype->getComponent<T>(index);
   }
 
   template <typename T>
   T *getComponent(Entity e) {
+    if (e >= entity_locations_.size()) return nullptr;
     auto [archetype, index] = entity_locations_[e];
+    if (!archetype) return nullptr;
     return archetype->getComponent<T>(index);
   }
 
@@ -1,9 +1,12 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <deque>
 #include <map>
 #include <mutex>
+#include <string>
 #include <unordered_map>
-#include <queue>
 #include <functional>
 #include <any>
 #include <vector>
@@ -12,8 +15,73 @@
 #include <absl/time/time.h>
 #include <absl/time/clock.h>
 
+#include "sunset/utils.h"
+
+// Log2 buckets over microseconds: bucket 0 is < 1us, bucket i covers
+// [2^(i-1), 2^i) us and the last bucket catches everything slower.
+struct LatencyHistogram {
+  static constexpr size_t kBuckets = 20;
+
+  std::array<uint64_t, kBuckets> buckets{};
+  uint64_t count{0};
+  absl::Duration total{absl::ZeroDuration()};
+  absl::Duration max{absl::ZeroDuration()};
+
+  void record(absl::Duration duration);
+
+  absl::Duration mean() const;
+
+  // Upper bound of the bucket containing the given fraction of samples.
+  absl::Duration percentile(double fraction) const;
+};
+
+struct EventTypeStats {
+  std::string name;
+  // Counters of the frame in progress.
+  uint64_t sent{0};
+  uint64_t delivered{0};
+  // Counters of the last completed frame.
+  uint64_t last_sent{0};
+  uint64_t last_delivered{0};
+  uint64_t coalesced{0};
+  uint64_t last_coalesced{0};
+  uint64_t total_sent{0};
+  uint64_t total_delivered{0};
+  // One histogram per subscribed handler, in subscription order.
+  std::vector<LatencyHistogram> handler_time;
+};
+
+struct EventQueueStats {
+  bool enabled{false};
+  uint64_t frames{0};
+  size_t depth{0};
+  size_t peak_depth{0};
+  size_t last_peak_depth{0};
+  size_t delayed_size{0};
+  std::vector<EventTypeStats> types;
+};
+
+// How send() treats an event whose type already has one waiting in the
+// queue. KeepLatest overwrites the waiting event, Sum folds the new one
+// into it through T::merge, KeepAll (the default) queues every event.
+enum class CoalescePolicy { KeepAll, KeepLatest, Sum };
+
+// Points in the frame at which queued events are dispatched. Each event
+// type is routed to one phase (EndOfFrame unless changed with route<T>),
+// and process(phase) flushes only that phase's channel, so reactions to
+// e.g. collisions can run in the frame that produced them.
+enum class EventPhase : uint8_t { PostPhysics, PreRender, EndOfFrame };
+
+inline constexpr size_t kEventPhaseCount = 3;
+
+template <typename T>
+concept MergeableEvent = requires(T queued, const T &next) {
+  queued.merge(next);
+};
+
 class EventQueue {
   using Handler = std::function<void(const std::any &)>;
+  using Coalescer = std::function<void(std::any &, const std::any &)>;
 
   struct QueuedEvent {
     std::type_index type;
@@ -26,11 +94,26 @@ class EventQueue {
     std::any data;
   };
 
+  struct Channel {
+    std::deque<QueuedEvent> events;
+    // Sequence number of events.front().
+    uint64_t head_seq{0};
+  };
+
  public:
   template <typename T>
   void send(const T &event) {
     std::lock_guard guard(mutex_);
-    queue_.push({std::type_index(typeid(T)), event});
+    bool coalesced = push({std::type_index(typeid(T)), event});
+#ifdef SUNSET_EVENT_STATS
+    EventTypeStats &stats = typeStats<T>();
+    stats.sent++;
+    stats.total_sent++;
+    if (coalesced) stats.coalesced++;
+    stats_.peak_depth = std::max(stats_.peak_depth, depth());
+#else
+    unused(coalesced);
+#endif
   }
 
   template <typename T>
@@ -39,6 +122,9 @@ class EventQueue {
     absl::Time trigger = absl::Now() + delay;
     delayed_.emplace(trigger,
                      QueuedEvent{std::type_index(typeid(T)), event});
+#ifdef SUNSET_EVENT_STATS
+    typeStats<T>();
+#endif
   }
 
   template <typename T>
@@ -47,13 +133,101 @@ class EventQueue {
       handler(std::any_cast<const T &>(data));
     };
     handlers[std::type_index(typeid(T))].push_back(wrapper);
+#ifdef SUNSET_EVENT_STATS
+    std::lock_guard guard(mutex_);
+    typeStats<T>().handler_time.emplace_back();
+#endif
+  }
+
+  // The policy is a template argument so that Sum on a type without
+  // T::merge fails to compile.
+  template <typename T, CoalescePolicy Policy>
+  void setCoalescing() {
+    std::lock_guard guard(mutex_);
+    auto type = std::type_index(typeid(T));
+
+    if constexpr (Policy == CoalescePolicy::KeepAll) {
+      coalescers_.erase(type);
+    } else if constexpr (Policy == CoalescePolicy::KeepLatest) {
+      coalescers_[type] = [](std::any &queued, const std::any &next) {
+        queued = next;
+      };
+    } else {
+      static_assert(MergeableEvent<T>,
+                    "CoalescePolicy::Sum requires T::merge");
+      coalescers_[type] = [](std::any &queued, const std::any &next) {
+        std::any_cast<T &>(queued).merge(std::any_cast<const T &>(next));
+      };
+    }
+  }
+
+  template <typename T>
+  void route(EventPhase phase) {
+    std::lock_guard guard(mutex_);
+    auto type = std::type_index(typeid(T));
+    routes_[type] = phase;
+    // Events already queued stay in their old channel; don't merge new
+    // ones into them.
+    pending_.erase(type);
   }
 
+  // Dispatches the events queued in one phase's channel, including those
+  // sent to it by its own handlers.
+  void process(EventPhase phase);
+
+  // Dispatches every channel in phase order until all are empty, and
+  // closes the frame for the stats.
   void process();
 
+  // Snapshot of the recorded counters. Returns an empty, disabled
+  // snapshot unless built with SUNSET_EVENT_STATS.
+  EventQueueStats stats() const;
+
  private:
-  std::queue<QueuedEvent> queue_;
+  std::array<Channel, kEventPhaseCount> channels_;
   std::multimap<absl::Time, QueuedEvent> delayed_;
   std::unordered_map<std::type_index, std::vector<Handler>> handlers;
-  std::mutex mutex_;
+  std::unordered_map<std::type_index, EventPhase> routes_;
+  std::unordered_map<std::type_index, Coalescer> coalescers_;
+  // Sequence number of the waiting event of each coalesced type.
+  std::unordered_map<std::type_index, uint64_t> pending_;
+  mutable std::mutex mutex_;
+
+  EventPhase routeOf(std::type_index type) const;
+
+  Channel &channel(EventPhase phase) {
+    return channels_[static_cast<size_t>(phase)];
+  }
+
+  size_t depth() const;
+
+  // Queues the event in its channel or folds it into a waiting one of the
+  // same type. Returns true if it was folded. Expects mutex_ to be held.
+  bool push(QueuedEvent event);
+
+  QueuedEvent pop(Channel &channel);
+
+  // Moves due delayed events into their channels.
+  void flushDelayed(absl::Time now);
+
+  // Runs the handlers of every event in the channel. Expects `lock` to
+  // hold mutex_; it is released around handler calls.
+  void dispatch(Channel &channel, std::unique_lock<std::mutex> &lock);
+
+#ifdef SUNSET_EVENT_STATS
+  EventQueueStats stats_{.enabled = true};
+  std::unordered_map<std::type_index, size_t> stats_index_;
+
+  template <typename T>
+  EventTypeStats &typeStats() {
+    auto [it, inserted] = stats_index_.try_emplace(
+        std::type_index(typeid(T)), stats_.types.size());
+    if (inserted) {
+      stats_.types.push_back({.name = demangle(typeid(T).name())});
+    }
+    return stats_.types[it->second];
+  }
+
+  void endFrameStats();
+#endif
 };
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// splitmix64 finalizer; spreads packed integer keys over the table.
+inline uint64_t mixHash(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+// Open-addressing hash map with linear probing over a single flat array,
+// for integer keys on hot paths where std::unordered_map's per-node
+// allocation and pointer chasing dominate. Erase shifts the following
+// entries back instead of leaving tombstones. Pointers into the map are
+// invalidated by any insertion.
+template <typename K, typename V>
+class FlatHashMap {
+  static_assert(std::is_integral_v<K>, "FlatHashMap keys are integers");
+
+  struct Slot {
+    K key;
+    V value;
+    bool used;
+  };
+
+ public:
+  size_t size() const { return size_; }
+
+  bool empty() const { return size_ == 0; }
+
+  void clear() {
+    for (Slot &slot : slots_) {
+      slot.used = false;
+    }
+    size_ = 0;
+  }
+
+  void reserve(size_t count) {
+    // Keep the load factor under 1/2.
+    size_t capacity = std::bit_ceil(std::max<size_t>(count * 2, 16));
+    if (capacity > slots_.size()) {
+      rehash(capacity);
+    }
+  }
+
+  V *find(K key) {
+    if (slots_.empty()) {
+      return nullptr;
+    }
+    for (size_t i = home(key);; i = next(i)) {
+      Slot &slot = slots_[i];
+      if (!slot.used) return nullptr;
+      if (slot.key == key) return &slot.value;
+    }
+  }
+
+  const V *find(K key) const {
+    return const_cast<FlatHashMap *>(this)->find(key);
+  }
+
+  bool contains(K key) const { return find(key) != nullptr; }
+
+  // Returns the value for `key`, default-constructing it if missing, and
+  // whether it was inserted.
+  std::pair<V *, bool> tryEmplace(K key) {
+    reserve(size_ + 1);
+    for (size_t i = home(key);; i = next(i)) {
+      Slot &slot = slots_[i];
+      if (!slot.used) {
+        slot = {key, V{}, true};
+        size_++;
+        return {&slot.value, true};
+      }
+      if (slot.key == key) return {&slot.value, false};
+    }
+  }
+
+  V &operator[](K key) { return *tryEmplace(key).first; }
+
+  bool erase(K key) {
+    if (slots_.empty()) {
+      return false;
+    }
+
+    size_t i = home(key);
+    for (;; i = next(i)) {
+      if (!slots_[i].used) return false;
+      if (slots_[i].key == key) break;
+    }
+
+    // Pull back any later entry of the probe run that may no longer be
+    // reachable from its home slot.
+    size_t hole = i;
+    for (size_t j = next(i); slots_[j].used; j = next(j)) {
+      size_t want = home(slots_[j].key);
+      if (((j - want) & mask()) >= ((j - hole) & mask())) {
+        slots_[hole] = slots_[j];
+        hole = j;
+      }
+    }
+    slots_[hole].used = false;
+    size_--;
+    return true;
+  }
+
+  template <typename F>
+  void forEach(F &&fn) const {
+    for (const Slot &slot : slots_) {
+      if (slot.used) fn(slot.key, slot.value);
+    }
+  }
+
+ private:
+  std::vector<Slot> slots_;
+  size_t size_{0};
+
+  size_t mask() const { return slots_.size() - 1; }
+
+  size_t home(K key) const {
+    return mixHash(static_cast<uint64_t>(key)) & mask();
+  }
+
+  size_t next(size_t i) const { return (i + 1) & mask(); }
+
+  void rehash(size_t capacity) {
+    assert(std::has_single_bit(capacity));
+    std::vector<Slot> old = std::move(slots_);
+    slots_.assign(capacity, Slot{K{}, V{}, false});
+    for (const Slot &slot : old) {
+      if (!slot.used) continue;
+      for (size_t i = home(slot.key);; i = next(i)) {
+        if (!slots_[i].used) {
+          slots_[i] = slot;
+          break;
+        }
+      }
+    }
+  }
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <optional>
 #include <string>
 #include <vector>
@@ -26,6 +27,14 @@ struct AABB {
 
   bool contains(const glm::vec3 &point) const;
 
+  bool contains(const AABB &other) const;
+
+  AABB merge(const AABB &other) const;
+
+  AABB expand(float margin) const;
+
+  float getSurfaceArea() const;
+
   float getRadius() const;
 
   AABB translate(const glm::vec3 &direction) const;
@@ -47,6 +56,34 @@ struct TypeDeserializer<AABB> {
 
 std::ostream &operator<<(std::ostream &os, const AABB &aabb);
 
+struct Ray {
+  glm::vec3 origin;
+  // Need not be normalized; distances are in units of its length.
+  glm::vec3 direction;
+
+  glm::vec3 at(float t) const { return origin + direction * t; }
+
+  // Slab test. Returns the entry distance (0 if the origin is inside) of
+  // the first hit within [0, max_distance].
+  std::optional<float> intersect(const AABB &aabb,
+                                 float max_distance) const;
+};
+
+struct RayHit {
+  Entity entity;
+  float distance;
+};
+
+// Six inward-facing planes (xyz normal, w offset) in world space.
+struct Frustum {
+  std::array<glm::vec4, 6> planes;
+
+  static Frustum fromViewProjection(const glm::mat4 &view_projection);
+
+  // Conservative: may accept boxes near the corners that are outside.
+  bool intersects(const AABB &aabb) const;
+};
+
 struct Rect {
   uint32_t x;
   uint32_t y;
@@ -191,6 +228,11 @@ struct TypeDeserializer<glm::vec3> {
   }
 };
 
+// Node named `name` that TypeDeserializer<glm::vec3> reads back.
+inline PropertyTree serializeVec3(std::string name, glm::vec3 v) {
+  return PropertyTree{std::move(name), {v.x, v.y, v.z}};
+}
+
 struct SavedTransform {
   glm::vec3 position;
   glm::quat rotation;
@@ -283,6 +325,13 @@ absl::StatusOr<MeshRenderable> loadSavedMesh(
     MeshRef const &ref, SavedMesh const &saved_mesh,
     std::optional<Image> texture_image, Backend &backend);
 
+// Uploads the mesh `mesh_ref` points to, textured with `texture_ref` if
+// given, reusing what earlier calls uploaded. This is what compileScene
+// turns MeshRefs into.
+absl::StatusOr<MeshRenderable> compileMeshRef(
+    Backend &backend, const MeshRef &mesh_ref,
+    const TextureRef *texture_ref = nullptr);
+
 struct Transform {
   // relative to parent
   glm::vec3 position;
@@ -295,8 +344,29 @@ struct Transform {
   std::vector<Entity> children;
   std::optional<Entity> parent;
 
-  glm::mat4 cached_model;
-  bool dirty;
+  // World matrix as of the last TransformSystem::update. Whatever moves,
+  // rotates, scales or reparents the entity sets `dirty` so that it and
+  // its descendants are recomputed.
+  glm::mat4 cached_model{1.0f};
+  bool dirty{true};
+
+  // Pose at the start of the last physics step, if the entity is
+  // simulated; rendering blends from it towards the current pose.
+  struct Pose {
+    glm::vec3 position;
+    glm::quat rotation;
+  };
+  std::optional<Pose> previous;
+
+  glm::vec3 interpolatedPosition(float alpha) const {
+    return previous ? glm::mix(previous->position, position, alpha)
+                    : position;
+  }
+
+  glm::quat interpolatedRotation(float alpha) const {
+    return previous ? glm::slerp(previous->rotation, rotation, alpha)
+                    : rotation;
+  }
 
   std::optional<PropertyTree> serialize() const {
     // TODO:
@@ -312,7 +382,11 @@ struct Transform {
   }
 };
 
-glm::mat4 calculateModelMatrix(ECS const &ecs, Entity entity);
+// `alpha` blends each transform in the hierarchy between its previous
+// and current pose; 1 uses the current pose. Walks up the whole
+// hierarchy; per-frame code should read Transform::cached_model instead.
+glm::mat4 calculateModelMatrix(ECS const &ecs, Entity entity,
+                               float alpha = 1.0f);
 
 MeshRenderable compileMesh(
     Backend &backend, const Mesh &mesh,
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "sunset/broadphase.h"
+#include "sunset/flat_hash.h"
+
+// Uniform grid hashed into a flat table, for dense crowds of similarly
+// sized bodies. sync() rebuilds the whole grid in parallel; between
+// rebuilds, bodies that leave their (fattened) cells are kept in a side
+// list that every query scans. Bodies covering too many cells are kept in
+// that list permanently, so a cell size near the typical body size works
+// best.
+class HashGrid : public Broadphase {
+ public:
+  static constexpr float kDefaultCellSize = 1.0f;
+  static constexpr float kDefaultMargin = 0.1f;
+
+  explicit HashGrid(float cell_size = kDefaultCellSize,
+                    float margin = kDefaultMargin);
+
+  void insert(Entity entity, const AABB &aabb) override;
+
+  void remove(Entity entity) override;
+
+  void update(Entity entity, const AABB &aabb) override;
+
+  bool contains(Entity entity) const override {
+    return index_.contains(entity);
+  }
+
+  size_t size() const override { return index_.size(); }
+
+  void entities(std::vector<Entity> &out) const override;
+
+  void query(const AABB &aabb, std::vector<Entity> &out) const override;
+
+  void queryPairs(
+      std::vector<std::pair<Entity, Entity>> &out) const override;
+
+  void sync(std::span<const BroadphaseProxy> proxies) override;
+
+  float cellSize() const { return cell_size_; }
+
+ private:
+  // A body spanning more cells than this goes to the side list.
+  static constexpr int64_t kMaxCellsPerBody = 64;
+
+  struct Body {
+    AABB aabb;
+    // Box the grid cells were computed from.
+    AABB fat;
+    Entity entity;
+    bool live;
+    // Not (or no longer correctly) in the cells; see side_.
+    bool side;
+  };
+
+  struct CellRange {
+    uint32_t begin;
+    uint32_t count;
+  };
+
+  struct CellBox {
+    glm::ivec3 min;
+    glm::ivec3 max;
+
+    int64_t count() const;
+  };
+
+  float cell_size_;
+  float inv_cell_size_;
+  float margin_;
+
+  std::vector<Body> bodies_;
+  FlatHashMap<Entity, uint32_t> index_;
+  // Body indices grouped by cell, and the range of each cell.
+  std::vector<uint32_t> cell_bodies_;
+  FlatHashMap<uint64_t, CellRange> cells_;
+  std::vector<uint32_t> side_;
+
+  CellBox cellsOf(const AABB &aabb) const;
+
+  static uint64_t cellKey(const glm::ivec3 &cell);
+
+  void rebuild();
+
+  void moveToSide(uint32_t body);
+
+  // Calls fn(body index) for each body in the cells or the side list that
+  // may overlap `aabb`, once each.
+  template <typename F>
+  void forEachCandidate(const AABB &aabb, F &&fn) const;
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "sunset/geometry.h"
+#include "sunset/property_tree.h"
+
+// Terrain surface sampled on a regular grid in the xz plane. Sample
+// (x, z) is at origin + (x, 0, z) * cell_size, raised by heights[z *
+// columns + x], and the surface is bilinear within each cell. Everything
+// below it is solid. Lookups only visit the cells under the query, so
+// they cost the same whatever the size of the grid.
+class Heightfield {
+ public:
+  Heightfield() = default;
+
+  // `heights` is rows of `columns` samples; there must be at least two
+  // rows and two columns.
+  Heightfield(glm::vec3 origin, float cell_size, int32_t columns,
+              std::vector<float> heights);
+
+  int32_t columns() const { return columns_; }
+
+  int32_t rows() const { return rows_; }
+
+  bool empty() const { return heights_.empty(); }
+
+  const AABB &bounds() const { return bounds_; }
+
+  // Surface height at (x, z), if that is over the grid.
+  std::optional<float> heightAt(float x, float z) const;
+
+  // Highest point of the surface over the part of the box's xz footprint
+  // that is over the grid, if any is.
+  std::optional<float> maxHeight(const AABB &aabb) const;
+
+  // Upward normal of the surface at (x, z), clamped to the grid.
+  glm::vec3 normalAt(float x, float z) const;
+
+  // Distance to where `ray` first meets the surface within max_distance;
+  // 0 if it starts below it.
+  std::optional<float> raycast(const Ray &ray, float max_distance) const;
+
+  std::optional<PropertyTree> serialize() const;
+
+  static absl::StatusOr<Heightfield> deserialize(PropertyTree const &tree);
+
+ private:
+  glm::vec3 origin_{0.0f};
+  float cell_size_{1.0f};
+  int32_t columns_{0};
+  int32_t rows_{0};
+  std::vector<float> heights_;
+  AABB bounds_;
+
+  float sample(int32_t x, int32_t z) const {
+    return origin_.y + heights_[z * columns_ + x];
+  }
+
+  // Height at grid coordinates (gx, gz), which must be within the grid.
+  float heightAtGrid(float gx, float gz) const;
+};
+
+template <>
+inline absl::StatusOr<Heightfield> deserializeTree(
+    const PropertyTree &tree) {
+  return Heightfield::deserialize(tree);
+}
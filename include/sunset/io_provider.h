@@ -76,11 +76,24 @@ struct MouseMoved {
   double y;
   double dx;
   double dy;
+
+  // Keeps the latest cursor position and accumulates the motion.
+  void merge(const MouseMoved &next) {
+    x = next.x;
+    y = next.y;
+    dx += next.dx;
+    dy += next.dy;
+  }
 };
 
 struct MouseScrolled {
   double dx;
   double dy;
+
+  void merge(const MouseScrolled &next) {
+    dx += next.dx;
+    dy += next.dy;
+  }
 };
 
 class IOProvider {
@@ -2,16 +2,17 @@
 
 #include <algorithm>
 #include <array>
+#include <cstdint>
 #include <memory>
 #include <optional>
+#include <vector>
 
 #include <glm/glm.hpp>
 
+#include "sunset/broadphase.h"
+#include "sunset/flat_hash.h"
 #include "sunset/geometry.h"
 
-// TODO:
-// octree that all it does is have an AABB and Entity and partitions soly based on them.
-
 template <typename T>
 class OcTree;
 
@@ -102,3 +103,119 @@ class OcTree {
     return nullptr;
   }
 };
+
+// Payload tag selecting the loose entity index below.
+struct LooseEntities {};
+
+// Loose octree that partitions entities by their AABB alone. Each node's
+// loose bounds are its cell grown by half a cell on every side, so a box
+// is stored in the node at the depth matching its size whose cell holds
+// its center; that node is found directly, without descending the tree.
+// Moving a box within the same cell is O(1). Boxes whose center is
+// outside the root are kept at the root. Nodes are created on demand and
+// freed when their subtree empties.
+template <>
+class OcTree<LooseEntities> : public Broadphase {
+ public:
+  static constexpr size_t kDefaultMaxDepth = 10;
+  static constexpr size_t kMaxDepthLimit = 15;
+
+  explicit OcTree(const AABB &bounds, size_t max_depth = kDefaultMaxDepth);
+
+  void insert(Entity entity, const AABB &aabb) override;
+
+  void remove(Entity entity) override;
+
+  // Same as move().
+  void update(Entity entity, const AABB &aabb) override;
+
+  void move(Entity entity, const AABB &aabb);
+
+  bool contains(Entity entity) const override {
+    return lookup_.contains(entity);
+  }
+
+  size_t size() const override { return lookup_.size(); }
+
+  void entities(std::vector<Entity> &out) const override;
+
+  void query(const AABB &aabb, std::vector<Entity> &out) const override;
+
+  void queryRay(const Ray &ray, float max_distance,
+                std::vector<Entity> &out) const override;
+
+  void queryPairs(
+      std::vector<std::pair<Entity, Entity>> &out) const override;
+
+  void queryFrustum(const Frustum &frustum,
+                    std::vector<Entity> &out) const;
+
+  // Appends the boxes hit within max_distance, nearest first.
+  void raycast(const Ray &ray, float max_distance,
+               std::vector<RayHit> &out) const;
+
+  const AABB &bounds() const { return bounds_; }
+
+ private:
+  static constexpr int32_t kNull = -1;
+
+  struct Node {
+    // Tight cell; the loose bounds are derived from it.
+    AABB cell;
+    glm::ivec3 coords;
+    uint32_t depth;
+    int32_t parent{kNull};
+    std::array<int32_t, 8> children;
+    std::vector<uint32_t> items;
+    // Items in this node and its descendants.
+    uint32_t count{0};
+  };
+
+  struct Item {
+    AABB aabb;
+    Entity entity;
+    int32_t node;
+    // Index in the node's item list.
+    uint32_t slot;
+  };
+
+  struct Placement {
+    uint32_t depth;
+    glm::ivec3 coords;
+  };
+
+  AABB bounds_;
+  float edge_;
+  size_t max_depth_;
+  // Cell edge and number of stored boxes at each depth.
+  std::array<float, kMaxDepthLimit + 1> edges_;
+  std::array<uint32_t, kMaxDepthLimit + 1> level_items_{};
+
+  std::vector<Node> nodes_;
+  std::vector<int32_t> free_nodes_;
+  FlatHashMap<uint64_t, int32_t> node_lookup_;
+
+  std::vector<Item> items_;
+  std::vector<uint32_t> free_items_;
+  FlatHashMap<Entity, uint32_t> lookup_;
+
+  static uint64_t nodeKey(uint32_t depth, const glm::ivec3 &coords);
+
+  AABB looseBounds(const Node &node) const;
+
+  Placement place(const AABB &aabb) const;
+
+  int32_t findOrCreateNode(const Placement &placement);
+
+  void attach(uint32_t item, int32_t node);
+
+  void detach(uint32_t item);
+
+  // Visits the nodes whose loose bounds pass `accept`, parents first,
+  // starting from the given nodes.
+  template <typename Accept, typename Visit>
+  void traverse(std::span<const int32_t> roots, Accept &&accept,
+                Visit &&visit) const;
+};
+
+using LooseOcTree = OcTree<LooseEntities>;
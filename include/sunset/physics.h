@@ -1,13 +1,26 @@
 #pragma once
 
-#include <set>
 #include <algorithm>
+#include <cstdint>
+#include <memory>
 #include <optional>
+#include <span>
+#include <utility>
+#include <vector>
 
+#include "sunset/aabb_batch.h"
+#include "sunset/body_store.h"
+#include "sunset/broadphase.h"
+#include "sunset/constraint_solver.h"
 #include "sunset/event_queue.h"
 #include "sunset/ecs.h"
+#include "sunset/flat_hash.h"
 #include "sunset/geometry.h"
+#include "sunset/heightfield.h"
 #include "sunset/property_tree.h"
+#include "sunset/static_bvh.h"
+
+class ThreadPool;
 
 struct PhysicsMaterial {
   float friction{0.5f};
@@ -29,11 +42,21 @@ struct PhysicsComponent {
 
   glm::vec3 velocity{0.0f};
   glm::vec3 acceleration{0.0f};
+  // Must be positive for Regular bodies; the others ignore it.
   float mass{1.0f};
   Type type{Type::Regular};
   PhysicsMaterial material;
   AABB collider;
   Entity collision_source;
+  // Sweep the collider along each step's motion and stop at the first
+  // thing it would hit, so small fast bodies such as projectiles can't
+  // pass through thin ones between steps.
+  bool continuous{false};
+  // Set once the body has rested for a while; sleeping bodies are not
+  // integrated or moved until something touches or pushes them.
+  bool sleeping{false};
+  // Seconds the body has moved slower than the sleep threshold.
+  float rest_time{0.0f};
 
   std::optional<PropertyTree> serialize() const {
     // TODO:
@@ -43,7 +66,13 @@ struct PhysicsComponent {
 
   static absl::StatusOr<PhysicsComponent> deserialize(
       PropertyTree const &tree) {
-    return deserializeTree<PhysicsComponent>(tree);
+    PhysicsComponent physics =
+        TRY(deserializeTree<PhysicsComponent>(tree));
+    if (physics.type == Type::Regular && !(physics.mass > 0.0f)) {
+      return absl::InvalidArgumentError(absl::StrFormat(
+          "Regular body needs a positive mass, got %f", physics.mass));
+    }
+    return physics;
   }
 };
 
@@ -73,6 +102,79 @@ struct TypeDeserializer<PhysicsComponent> {
   }
 };
 
+// Movement a body makes on its own, e.g. a player walking. Each physics
+// step moves the body by it together with its velocity, in a single
+// collision pass.
+struct MovementIntent {
+  // One-off offset, summed until the next step and then zeroed.
+  glm::vec3 displacement{0.0f};
+  // Held until changed, in units per reference step like
+  // PhysicsComponent::velocity without kMotionScale. Each step moves
+  // the body by it scaled to the step's length, so the distance covered
+  // doesn't depend on the frame or tick rate.
+  glm::vec3 velocity{0.0f};
+
+  std::optional<PropertyTree> serialize() const {
+    return PropertyTree{"MovementIntent",
+                        {},
+                        {serializeVec3("Displacement", displacement),
+                         serializeVec3("Velocity", velocity)}};
+  }
+
+  static absl::StatusOr<MovementIntent> deserialize(
+      PropertyTree const &tree) {
+    // Saved empty before the fields were serialized.
+    if (tree.children.empty()) return MovementIntent{};
+    return deserializeTree<MovementIntent>(tree);
+  }
+};
+
+template <>
+struct TypeDeserializer<MovementIntent> {
+  static std::vector<FieldDescriptor<MovementIntent>> getFields() {
+    return {
+        makeSetter("Displacement", &MovementIntent::displacement),
+        makeSetter("Velocity", &MovementIntent::velocity),
+    };
+  }
+};
+
+// Ground for the bodies above it. Terrain isn't in the broadphase: a
+// moving body is lifted out of it after its move, at a cost that doesn't
+// depend on the size of the heightfield.
+struct TerrainComponent {
+  Heightfield heightfield;
+  PhysicsMaterial material;
+
+  std::optional<PropertyTree> serialize() const {
+    PropertyTree tree = {"TerrainComponent"};
+    if (std::optional<PropertyTree> field = heightfield.serialize()) {
+      tree.children.push_back(*std::move(field));
+    }
+    tree.children.push_back(
+        {"Material",
+         {},
+         {{"Friction", {material.friction}},
+          {"Restitution", {material.restitution}}}});
+    return tree;
+  }
+
+  static absl::StatusOr<TerrainComponent> deserialize(
+      PropertyTree const &tree) {
+    return deserializeTree<TerrainComponent>(tree);
+  }
+};
+
+template <>
+struct TypeDeserializer<TerrainComponent> {
+  static std::vector<FieldDescriptor<TerrainComponent>> getFields() {
+    return {
+        makeSetter("Heightfield", &TerrainComponent::heightfield),
+        makeSetter("Material", &TerrainComponent::material),
+    };
+  }
+};
+
 struct EnterCollider {
   Entity entity;
   Entity collider;
@@ -90,15 +192,43 @@ struct Collision {
   glm::vec3 velocity_b;
 };
 
+// Keeps the entity `distance` away from `other`, like a rigid rod.
 struct Constraint {
   Entity other;
   float distance;
+
+  std::optional<PropertyTree> serialize() const {
+    PropertyTree tree = {"Constraint"};
+    tree.children.push_back({"Other", {static_cast<int32_t>(other)}});
+    tree.children.push_back({"Distance", {distance}});
+    return tree;
+  }
+
+  static absl::StatusOr<Constraint> deserialize(PropertyTree const &tree) {
+    return deserializeTree<Constraint>(tree);
+  }
+};
+
+template <>
+struct TypeDeserializer<Constraint> {
+  static std::vector<FieldDescriptor<Constraint>> getFields() {
+    return {
+        makeSetter("Other", &Constraint::other),
+        makeSetter("Distance", &Constraint::distance, true),
+    };
+  }
 };
 
 struct CollisionPair {
   Entity entity_a;
   Entity entity_b;
 
+  // Same for both orders of the entities.
+  uint64_t key() const noexcept {
+    auto [low, high] = std::minmax(entity_a, entity_b);
+    return (static_cast<uint64_t>(low) << 32) | high;
+  }
+
   bool operator==(const CollisionPair &other) const noexcept {
     return (entity_a == other.entity_a && entity_b == other.entity_b) ||
            (entity_a == other.entity_b && entity_b == other.entity_a);
@@ -114,40 +244,334 @@ struct CollisionPair {
   }
 };
 
+enum class BroadphaseType {
+  AABBTree,
+  SweepAndPrune,
+  HashGrid,
+  LooseOcTree,
+};
+
+template <>
+inline absl::StatusOr<BroadphaseType> deserializeTree(
+    const PropertyTree &tree) {
+  if (tree.properties.size() < 1) {
+    return absl::InvalidArgumentError("Invalid broadphase type");
+  }
+  return static_cast<BroadphaseType>(
+      TRY(extractProperty<int16_t>(tree.properties[0])));
+}
+
+// Per-scene tuning, read from the scene's optional PhysicsSettings node.
+struct PhysicsSettings {
+  BroadphaseType broadphase{BroadphaseType::AABBTree};
+  // Grid cell edge for HashGrid; around the size of a typical body.
+  float cell_size{1.0f};
+  // Axis the bodies spread along, for SweepAndPrune.
+  int16_t sweep_axis{0};
+  // Region covered by LooseOcTree.
+  AABB bounds{glm::vec3(-512.0f), glm::vec3(512.0f)};
+  // Fixed simulation steps per second, independent of the frame rate.
+  float tick_rate{60.0f};
+  // Most steps run in one frame; a slower frame drops the excess time.
+  int16_t max_substeps{5};
+};
+
+template <>
+struct TypeDeserializer<PhysicsSettings> {
+  static std::vector<FieldDescriptor<PhysicsSettings>> getFields() {
+    return {
+        makeSetter("Broadphase", &PhysicsSettings::broadphase, true),
+        makeSetter("CellSize", &PhysicsSettings::cell_size, true),
+        makeSetter("SweepAxis", &PhysicsSettings::sweep_axis, true),
+        makeSetter("Bounds", &PhysicsSettings::bounds),
+        makeSetter("TickRate", &PhysicsSettings::tick_rate, true),
+        makeSetter("MaxSubsteps", &PhysicsSettings::max_substeps, true),
+    };
+  }
+};
+
+std::unique_ptr<Broadphase> makeBroadphase(const PhysicsSettings &settings);
+
+// Which bodies the spatial queries of PhysicsSystem report.
+struct QueryFilter {
+  // Left out, e.g. the body a ray is cast from.
+  std::optional<Entity> ignore;
+  // Also report trigger volumes (Collider bodies).
+  bool colliders{false};
+};
+
 struct CollisionData {
   glm::vec3 normal;
 };
 
 class PhysicsSystem {
   static constexpr float kVelocityEpsilon = 0.0001f;
+  // An island falls asleep once all its bodies moved slower than
+  // kSleepSpeed (units per second) for kSleepTime seconds.
+  static constexpr float kSleepSpeed = 0.05f;
+  static constexpr float kSleepTime = 0.5f;
+  // How far apart bodies still count as touching when waking them.
+  static constexpr float kSleepMargin = 0.01f;
+  // A continuous body slides along at most this many faces per step, and
+  // stops this far short of each.
+  static constexpr int kMaxSweeps = 3;
+  static constexpr float kContactSkin = 0.0001f;
+  // Solver passes over the constraints per step.
+  static constexpr int kConstraintIterations = 8;
 
  public:
+  // Velocities and accelerations are tuned per step at this rate, moving
+  // bodies by velocity * kMotionScale per step.
+  static constexpr float kReferenceTickRate = 60.0f;
+  static constexpr float kMotionScale = 0.166f;
+
+  PhysicsSystem();
+
   static PhysicsSystem &instance();
 
+  // Moves `entity` right away, with its own collision pass. Movement
+  // that can wait for the next step should go through MovementIntent.
   bool moveObject(ECS &ecs, Entity entity, glm::vec3 direction,
                   EventQueue &event_queue);
 
+  // Advances the simulation by `dt` seconds, normally step(). Motion
+  // scales with dt, so bodies move as fast at any tick rate.
   void update(ECS &ecs, EventQueue &event_queue, float dt);
 
+  // Replaces the spatial index used for collision candidates. The new one
+  // is filled on the next update.
+  void setBroadphase(std::unique_ptr<Broadphase> broadphase);
+
+  void configure(const PhysicsSettings &settings);
+
+  // Runs the parallel parts of a step on `pool` rather than the shared
+  // one; null goes back to ThreadPool::instance(). Results are the same
+  // for any pool size.
+  void setThreadPool(ThreadPool *pool) { thread_pool_ = pool; }
+
+  // Length of one fixed step in seconds.
+  float step() const { return 1.0f / tick_rate_; }
+
+  int maxSubsteps() const { return max_substeps_; }
+
+  // Wakes `entity` and, transitively, the sleeping bodies touching it.
+  // Setting a sleeping body's velocity wakes it on the next update;
+  // anything else that changes its situation (e.g. removing what it
+  // rests on) should call this.
+  void wake(ECS &ecs, Entity entity);
+
+  // Mover and candidate pairs the last update's collision passes
+  // tested: each candidate the broadphases returned for a move's swept
+  // box, after leaving out other islands.
+  size_t testedPairs() const { return tested_pairs_; }
+
+  // Index of every collider but the Static ones as of the last update,
+  // for other systems' proximity queries.
+  const Broadphase &broadphase() const { return *broadphase_; }
+
+  // Static colliders never move, so they are kept apart in a BVH that is
+  // only rebuilt when the set of them changes.
+  const StaticBVH &staticBVH() const { return static_bvh_; }
+
+  // Uses `bvh`, e.g. one saved with the scene, instead of building one.
+  // It is still rebuilt if it doesn't match the Static bodies.
+  void setStaticBVH(StaticBVH bvh) { static_bvh_ = std::move(bvh); }
+
+  // Builds the static BVH and fills the broadphase now rather than on
+  // the next update.
+  void bakeStatic(ECS &ecs);
+
+  // Spatial queries against the colliders as of the last update. A hit's
+  // distance is in units of the ray direction or sweep motion; ties go to
+  // the lowest entity. The batch variants write result i for input i and
+  // run on the thread pool. Rays and boxes also report terrain, sweeps
+  // and spheres don't.
+
+  // Nearest collider `ray` hits within max_distance.
+  std::optional<RayHit> raycast(ECS &ecs, const Ray &ray,
+                                float max_distance,
+                                const QueryFilter &filter = {}) const;
+
+  void raycast(ECS &ecs, std::span<const Ray> rays, float max_distance,
+               std::span<std::optional<RayHit>> hits,
+               const QueryFilter &filter = {}) const;
+
+  // First collider `box` touches when moved by `motion`, with the
+  // fraction of the motion travelled, in [0, 1].
+  std::optional<RayHit> sweepAABB(ECS &ecs, const AABB &box,
+                                  glm::vec3 motion,
+                                  const QueryFilter &filter = {}) const;
+
+  void sweepAABB(ECS &ecs, std::span<const AABB> boxes,
+                 std::span<const glm::vec3> motions,
+                 std::span<std::optional<RayHit>> hits,
+                 const QueryFilter &filter = {}) const;
+
+  // Appends the bodies whose colliders overlap the shape, in entity
+  // order.
+  void overlapAABB(ECS &ecs, const AABB &aabb, std::vector<Entity> &out,
+                   const QueryFilter &filter = {}) const;
+
+  void overlapSphere(ECS &ecs, glm::vec3 center, float radius,
+                     std::vector<Entity> &out,
+                     const QueryFilter &filter = {}) const;
+
  private:
-  std::set<CollisionPair> collision_pairs_;
-  std::set<CollisionPair> new_collisions_;
+  // Queries cast or tested per chunk of a batch.
+  static constexpr size_t kQueryGrain = 64;
+
+  struct QueryScratch {
+    std::vector<Entity> candidates;
+    AABBBatch boxes;
+    std::vector<float> distances;
+    std::vector<uint64_t> mask;
+  };
+
+  // Scratch space and results of a run of moves. Islands are solved with
+  // one per worker, and the results applied in island order afterwards.
+  struct MoveContext {
+    std::vector<Entity> candidates;
+    // Colliders of candidates, and which of them the swept box overlaps.
+    AABBBatch candidate_boxes;
+    std::vector<uint64_t> candidate_mask;
+    // Solid candidates grown by a continuous body's half extents, and the
+    // time of impact of its center against each.
+    AABBBatch sweep_boxes;
+    std::vector<Entity> sweep_entities;
+    std::vector<float> sweep_hits;
+    // Colliders that moved, to update in the broadphase. The broadphase
+    // only sees them after all islands are solved, so moves check the
+    // current island's entries, from island_moved on, themselves.
+    std::vector<BroadphaseProxy> moved;
+    size_t island_moved{0};
+    std::vector<Collision> collisions;
+    std::vector<CollisionPair> collider_pairs;
+    size_t tested_pairs{0};
+    // Island being solved; other islands' bodies are off limits.
+    std::optional<uint32_t> island;
+  };
+
+  struct Mover {
+    Entity entity;
+    glm::vec3 direction;
+  };
+
+  // A body a mover's swept box reaches this step, which the move may
+  // push or read.
+  struct Contact {
+    uint32_t mover;
+    Entity other;
+  };
+
+  // Collider overlaps of the last step, sorted by key, and those found
+  // so far in this one. The buffers are swapped each step.
+  std::vector<CollisionPair> collision_pairs_;
+  std::vector<CollisionPair> new_collisions_;
+  std::unique_ptr<Broadphase> broadphase_;
+  float tick_rate_{kReferenceTickRate};
+  size_t tested_pairs_{0};
+  int max_substeps_{5};
+  // Hot state of every body for the current step.
+  BodyStore bodies_;
+  std::vector<BroadphaseProxy> proxies_;
+  StaticBVH static_bvh_;
+  std::vector<BroadphaseProxy> static_proxies_;
+  // Entities with a TerrainComponent as of the last update.
+  std::vector<Entity> terrains_;
+  MoveContext serial_context_;
+
+  // Bodies moving this step, and the island of every body a move may
+  // change, grouped as island_movers_[island_offsets_[i]..[i + 1]).
+  std::vector<Mover> movers_;
+  // Contacts of this step's movers, in mover order; islands are the
+  // connected groups of them.
+  std::vector<Contact> contacts_;
+  // MovementIntent motion taken for this step.
+  FlatHashMap<Entity, glm::vec3> intents_;
+  FlatHashMap<Entity, uint32_t> island_of_;
+  std::vector<uint32_t> island_movers_;
+  std::vector<uint32_t> island_offsets_;
+
+  ThreadPool *thread_pool_{nullptr};
+
+  ConstraintSolver constraint_solver_;
+  // Solver body index of each constrained entity, and the reverse.
+  FlatHashMap<Entity, uint32_t> constraint_bodies_;
+  std::vector<Entity> constraint_entities_;
+
+  ThreadPool &threadPool() const;
+
+  // Refills the broadphase and, if the Static bodies changed, the static
+  // BVH from the colliders in bodies_.
+  void syncBroadphase();
+
+  // Candidates from both the broadphase and the static BVH.
+  void queryColliders(const AABB &aabb, std::vector<Entity> &out) const;
+
+  // Gathers contacts_ and splits movers_ into islands: groups whose swept
+  // boxes chain together through bodies that can be pushed. Bodies that
+  // can't are only read, so islands can be solved concurrently.
+  // Deterministic for a given ECS state.
+  void buildIslands(ECS &ecs, float dt);
+
+  void solveIslands(ECS &ecs, EventQueue &event_queue, float dt);
+
+  // Advances the rest timers of this step's movers and puts islands
+  // whose movers have all rested long enough to sleep.
+  void updateSleep(ECS &ecs, float dt);
+
+  // Applies the broadphase updates and events collected in `context`.
+  void flushMoves(MoveContext &context, EventQueue &event_queue);
+
+  // Box covering everything a move by `direction` may touch.
+  AABB pathBox(const PhysicsComponent &physics, const Transform &transform,
+               glm::vec3 direction, float dt) const noexcept;
+
+  // Moves a continuous body's motion up to its first time of impact
+  // against the solid candidates, sliding the remainder along the face
+  // hit. Returns whether it hit anything.
+  bool sweepContinuous(ECS &ecs, Entity entity, glm::vec3 &motion,
+                       MoveContext &context);
+
+  // Lifts `entity` out of any terrain it ended its move in, bouncing it
+  // off the surface. Returns whether it touched any.
+  bool resolveTerrain(ECS &ecs, Entity entity, MoveContext &context);
+
+  void moveHierarchialAABB(ECS &ecs, Entity e, glm::vec3 direction,
+                           MoveContext &context);
 
   bool moveObjectWithCollisions(ECS &ecs, Entity entity,
                                 glm::vec3 direction, float dt,
-                                EventQueue &event_queue);
+                                MoveContext &context);
 
   std::optional<glm::vec3> computeCollisionNormal(
       const PhysicsComponent &a_physics, const AABB &a_aabb,
       const PhysicsComponent &b_physics, const AABB &b_aabb,
       glm::vec3 direction) const noexcept;
 
-  void applyConstraintForces(ECS &ecs, float dt) noexcept;
+  // Solves every Constraint together and writes the bodies back once,
+  // velocities to bodies_.
+  // Static and Infinite bodies hold still; constraints between bodies
+  // that are all asleep or fixed are left out.
+  void solveConstraints(ECS &ecs);
 
   void applyCollisionImpulse(PhysicsComponent *a_physics,
                              PhysicsComponent *b_physics, glm::vec3 normal);
 
-  void resolveObjectOverlap(ECS &ecs, Entity a, Entity b) const;
+  void resolveObjectOverlap(ECS &ecs, Entity a, Entity b,
+                            MoveContext &context);
 
   void generateColliderEvents(EventQueue &event_queue);
+
+  // Keeps the candidates `filter` accepts, sorted, and gathers their
+  // colliders grown by `margin` on each side.
+  void filterCandidates(ECS &ecs, const QueryFilter &filter,
+                        glm::vec3 margin, QueryScratch &scratch) const;
+
+  // Nearest hit of `ray` against the colliders grown by `half_extents`,
+  // i.e. of a box of that size centered on the origin, swept along it.
+  std::optional<RayHit> castBox(ECS &ecs, const Ray &ray,
+                                float max_distance, glm::vec3 half_extents,
+                                const QueryFilter &filter,
+                                QueryScratch &scratch) const;
 };
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "sunset/ecs.h"
+#include "sunset/event_queue.h"
+#include "sunset/geometry.h"
+#include "sunset/physics.h"
+
+struct Projectile {
+  glm::vec3 position;
+  glm::vec3 velocity;
+  glm::vec3 acceleration{0.0f};
+  // Seconds until it disappears.
+  float lifetime{5.0f};
+  float damage{0.0f};
+  // Particles pass through everything; projectiles stop at the first
+  // collider or terrain in their way.
+  bool collides{true};
+};
+
+// A projectile reached `entity`, and is gone.
+struct ProjectileHit {
+  Entity entity;
+  glm::vec3 position;
+  float damage;
+};
+
+// Bullets, sparks and other short-lived points, kept out of the ECS in
+// fixed-capacity arrays, one per coordinate. They move like
+// PhysicsComponents of the same velocity and acceleration, but only
+// against the world: nothing collides with them, and each is treated as a
+// point, swept with a ray from where it was to where it is.
+class ProjectileSystem {
+ public:
+  explicit ProjectileSystem(size_t capacity);
+
+  // False, and nothing is added, once the pool is full.
+  bool spawn(const Projectile &projectile);
+
+  // Advances every projectile by `dt` seconds, sends a ProjectileHit for
+  // each that ran into a collider of `physics` as of its last update, and
+  // drops those and the expired ones. The last projectile takes the place
+  // of a removed one, so indices aren't stable across updates.
+  void update(ECS &ecs, const PhysicsSystem &physics,
+              EventQueue &event_queue, float dt);
+
+  void clear() { size_ = 0; }
+
+  size_t size() const { return size_; }
+
+  size_t capacity() const { return capacity_; }
+
+  glm::vec3 position(size_t i) const {
+    return {positions_[0][i], positions_[1][i], positions_[2][i]};
+  }
+
+  // Position before the last update, to blend from when rendering.
+  glm::vec3 previousPosition(size_t i) const {
+    return {previous_[0][i], previous_[1][i], previous_[2][i]};
+  }
+
+  glm::vec3 velocity(size_t i) const {
+    return {velocities_[0][i], velocities_[1][i], velocities_[2][i]};
+  }
+
+ private:
+  using Columns = std::array<std::vector<float>, 3>;
+
+  size_t capacity_;
+  size_t size_{0};
+  Columns positions_;
+  Columns previous_;
+  Columns velocities_;
+  Columns accelerations_;
+  std::vector<float> lifetimes_;
+  std::vector<float> damages_;
+  std::vector<uint8_t> collides_;
+
+  // Rays of the colliding projectiles and which projectile each is for.
+  std::vector<Ray> rays_;
+  std::vector<uint32_t> ray_owners_;
+  std::vector<std::optional<RayHit>> hits_;
+
+  void set(size_t i, const Projectile &projectile);
+
+  // Moves the last projectile into slot i.
+  void swapRemove(size_t i);
+};
@@ -217,3 +217,8 @@ inline absl::StatusOr<PropertyTree> deserializeTree(
 absl::StatusOr<Property> readProperty(std::istream &input);
 
 absl::StatusOr<PropertyTree> readPropertyTree(std::istream &input);
+
+// Writes `tree` in the format readPropertyTree reads, arrays
+// uncompressed.
+absl::Status writePropertyTree(std::ostream &output,
+                               const PropertyTree &tree);
@@ -2,7 +2,11 @@
 
 #include "sunset/backend.h"
 #include "sunset/ecs.h"
+#include "sunset/event_queue.h"
+#include "sunset/geometry.h"
 #include "sunset/image.h"
+#include "sunset/projectiles.h"
+#include "sunset/transform_system.h"
 
 class DebugOverlay {
  public:
@@ -10,14 +14,21 @@ class DebugOverlay {
 
   void update(ECS &ecs, std::vector<Command> &commands);
 
+  // Draws the per-type event counters and handler latencies of `queue`
+  // below the fps counter. Pass nullptr to hide the panel.
+  void showEventStats(const EventQueue *queue) { event_queue_ = queue; }
+
  private:
   Pipeline text_pipeline_;
   Pipeline aabb_pipeline_;
   Font font_;
   absl::Time last_frame_;
+  const EventQueue *event_queue_{nullptr};
 
   void initializePipeline(Backend &backend);
 
+  void drawEventStats(std::vector<Command> &commands);
+
   void drawText(const std::string &text, float x, float y,
                 std::vector<Command> &commands);
 };
@@ -28,9 +39,39 @@ class RenderingSystem {
 
   void update(ECS &ecs, std::vector<Command> &commands, bool debug = false);
 
+  DebugOverlay &debugOverlay() { return debug_overlay_; }
+
+  // Fraction of a physics step to blend simulated transforms by, see
+  // FixedTimestep::alpha().
+  void setInterpolation(float alpha) { interpolation_ = alpha; }
+
+  // Draws every projectile of `projectiles` as a copy of `mesh` scaled by
+  // `scale`, all in one instanced draw.
+  void showProjectiles(Backend &backend,
+                       const ProjectileSystem &projectiles,
+                       MeshRenderable mesh, float scale = 1.0f);
+
  private:
+  struct ProjectileBatch {
+    const ProjectileSystem *projectiles;
+    MeshRenderable mesh;
+    float scale;
+    // Holds an xyz position and a scale per projectile.
+    Handle instance_buffer;
+  };
+
   Handle pipeline_handle_;
+  Handle projectile_pipeline_handle_;
   DebugOverlay debug_overlay_;
+  TransformSystem transforms_;
+  float interpolation_{1.0f};
+  std::optional<ProjectileBatch> projectile_batch_;
+  std::vector<glm::vec4> projectile_instances_;
 
   void initializePipeline(Backend &backend);
+
+  void initializeProjectilePipeline(Backend &backend);
+
+  void drawProjectiles(const glm::mat4 &view, const glm::mat4 &projection,
+                       std::vector<Command> &commands);
 };
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+
+#include "sunset/io_provider.h"
+
+// Wraps another provider and appends every input event it produces to a
+// binary log, tagged with the frame it was polled in. The events are
+// captured as they are dispatched, so the log holds exactly what the
+// handlers saw. The log ends with a record of the last frame, written
+// when the recorder is destroyed.
+class RecordingIO : public IOProvider {
+ public:
+  RecordingIO(std::unique_ptr<IOProvider> inner, EventQueue &event_queue,
+              const std::filesystem::path &path);
+
+  ~RecordingIO() override;
+
+  bool poll(EventQueue &event_queue) override;
+
+  bool valid() override { return inner_->valid() && out_.good(); }
+
+ private:
+  std::unique_ptr<IOProvider> inner_;
+  std::ofstream out_;
+  uint32_t frame_{0};
+
+  template <typename T>
+  void record(const T &event);
+};
+
+// Feeds a log written by RecordingIO back into the queue, one recorded
+// frame per poll. Needs no window or GL context; poll returns false on
+// the frame the recorded session ended on, or once a truncated log runs
+// out.
+class ReplayIO : public IOProvider {
+ public:
+  explicit ReplayIO(const std::filesystem::path &path);
+
+  bool poll(EventQueue &event_queue) override;
+
+  bool valid() override { return valid_; }
+
+ private:
+  struct Record {
+    uint32_t frame;
+    uint8_t kind;
+  };
+
+  std::ifstream in_;
+  uint32_t frame_{0};
+  std::optional<Record> next_;
+  bool valid_{false};
+  bool exhausted_{false};
+
+  void readHeader();
+
+  bool dispatch(uint8_t kind, EventQueue &event_queue);
+};
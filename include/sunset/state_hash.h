@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <vector>
+
+#include "sunset/ecs.h"
+
+// Fingerprint of the simulation after a physics step: the Transform
+// position and PhysicsComponent velocity of every body, bit for bit, in
+// entity order. Two runs agree on a tick exactly when their hashes do
+// (barring collisions).
+struct StateHash {
+  struct Body {
+    Entity entity;
+    uint64_t hash;
+
+    bool operator==(const Body &) const = default;
+  };
+
+  uint64_t hash;
+  std::vector<Body> bodies;
+};
+
+StateHash hashPhysicsState(ECS &ecs);
+
+// Appends the state hash of every tick to a binary log, for
+// StateHashVerifier to check a later run against.
+class StateHashRecorder {
+ public:
+  explicit StateHashRecorder(const std::filesystem::path &path);
+
+  void record(const StateHash &state);
+
+  bool valid() const { return out_.good(); }
+
+ private:
+  std::ofstream out_;
+  uint32_t tick_{0};
+};
+
+// First point where a run stopped matching a recorded one. `entity` is
+// the lowest entity whose state differs or that only one run has.
+struct Divergence {
+  uint32_t tick;
+  std::optional<Entity> entity;
+};
+
+// Reads a log written by StateHashRecorder and compares each tick of the
+// current run with it.
+class StateHashVerifier {
+ public:
+  explicit StateHashVerifier(const std::filesystem::path &path);
+
+  // Compares `state` with the next recorded tick. Ticks past the end of
+  // the log aren't checked.
+  std::optional<Divergence> verify(const StateHash &state);
+
+  bool valid() const { return valid_; }
+
+  // Whether every recorded tick has been compared.
+  bool exhausted() const { return exhausted_; }
+
+  // Ticks compared so far.
+  uint32_t ticks() const { return tick_; }
+
+ private:
+  std::ifstream in_;
+  // Length of the log, to check recorded body counts against.
+  std::streamoff size_{0};
+  uint32_t tick_{0};
+  bool valid_{false};
+  bool exhausted_{false};
+  std::vector<StateHash::Body> recorded_;
+};
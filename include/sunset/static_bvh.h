@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "sunset/broadphase.h"
+#include "sunset/flat_hash.h"
+#include "sunset/geometry.h"
+#include "sunset/property_tree.h"
+
+// Bounding volume hierarchy over colliders that never move, built once
+// with the binned surface area heuristic and never updated. Nodes sit in
+// one array in depth-first order, each left child right after its
+// parent, and the leaves' boxes are stored in the order they're visited.
+class StaticBVH {
+ public:
+  static constexpr uint32_t kMaxLeafSize = 4;
+  static constexpr int kBins = 16;
+
+  StaticBVH() = default;
+
+  explicit StaticBVH(std::span<const BroadphaseProxy> proxies);
+
+  size_t size() const { return entities_.size(); }
+
+  bool empty() const { return entities_.empty(); }
+
+  // Box `entity` was baked with, if it was.
+  const AABB *find(Entity entity) const;
+
+  // Appends the entities whose boxes overlap `aabb`. Exact, unlike the
+  // dynamic broadphases.
+  void query(const AABB &aabb, std::vector<Entity> &out) const;
+
+  // Appends the entities whose boxes `ray` hits within max_distance.
+  void queryRay(const Ray &ray, float max_distance,
+                std::vector<Entity> &out) const;
+
+  std::optional<PropertyTree> serialize() const;
+
+  static absl::StatusOr<StaticBVH> deserialize(PropertyTree const &tree);
+
+ private:
+  struct Node {
+    AABB aabb;
+    // Leaves: boxes [first, first + count). Inner nodes: count is 0 and
+    // first is the right child.
+    uint32_t first;
+    uint32_t count;
+  };
+
+  std::vector<Node> nodes_;
+  std::vector<Entity> entities_;
+  std::vector<AABB> boxes_;
+  FlatHashMap<Entity, uint32_t> index_;
+
+  void build(std::span<uint32_t> items,
+             std::span<const BroadphaseProxy> proxies, int depth);
+
+  void buildIndex();
+
+  template <typename Accept, typename Visit>
+  void traverse(Accept &&accept, Visit &&visit) const;
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "sunset/aabb_batch.h"
+#include "sunset/broadphase.h"
+
+// Sweep-and-prune over one axis. Boxes are kept in a persistent array
+// sorted by their lower bound on that axis, and moved bodies are put back
+// in place with insertion sort, which is close to O(1) per body when
+// motion is coherent (conveyors, projectile streams). Best when the
+// sweep axis is the one along which the bodies spread out the most. The
+// boxes are stored as an AABBBatch so each sweep run is tested with the
+// batch overlap kernel.
+//
+// The sorted entries are grouped into blocks, and a max tree over each
+// block's largest upper bound lets queries skip the blocks that end
+// before them. A single long box, like a conveyor belt, then only costs
+// the block it sits in rather than widening every query.
+class SweepAndPrune : public Broadphase {
+ public:
+  explicit SweepAndPrune(int axis = 0);
+
+  void insert(Entity entity, const AABB &aabb) override;
+
+  // Linear in the number of tracked bodies.
+  void remove(Entity entity) override;
+
+  void update(Entity entity, const AABB &aabb) override;
+
+  bool contains(Entity entity) const override {
+    return slots_.contains(entity);
+  }
+
+  size_t size() const override { return entities_.size(); }
+
+  void entities(std::vector<Entity> &out) const override;
+
+  void query(const AABB &aabb, std::vector<Entity> &out) const override;
+
+  void queryPairs(
+      std::vector<std::pair<Entity, Entity>> &out) const override;
+
+  // Batched form of the per-entity calls: one insertion sort pass for the
+  // moved bodies and one merge for the new ones.
+  void sync(std::span<const BroadphaseProxy> proxies) override;
+
+ private:
+  // Runs shorter than this are tested one box at a time.
+  static constexpr size_t kMinBatch = 8;
+  // Entries per block, one overlap mask word.
+  static constexpr size_t kBlockSize = 64;
+
+  int axis_;
+  // Parallel arrays sorted by the lower bound along the axis.
+  AABBBatch boxes_;
+  std::vector<Entity> entities_;
+  std::vector<uint32_t> endpoint_slots_;
+  // Stable slot of each entity, and the sorted index of each slot, so
+  // insertion sort moves don't touch the hash map.
+  std::unordered_map<Entity, uint32_t> slots_;
+  std::vector<size_t> positions_;
+  std::vector<uint32_t> free_slots_;
+  // Implicit binary tree over the blocks, leaves at [leaves_,
+  // 2 * leaves_): the largest upper bound along the axis below each node,
+  // or -infinity where there are no entries.
+  std::vector<float> block_uppers_;
+  size_t leaves_{0};
+
+  float lower(size_t index) const { return boxes_.mins(axis_)[index]; }
+
+  uint32_t allocateSlot();
+
+  // Moves the entry at `from` to `to` in all the parallel arrays, without
+  // fixing positions_.
+  void moveEntry(size_t from, size_t to);
+
+  // Moves the entry at `index` to its sorted place.
+  void sortFrom(size_t index);
+
+  // Recomputes the blocks holding entries [begin, end), which may reach
+  // past the last entry after a removal. Rebuilds the tree when the
+  // blocks outgrow it or after clearBlocks().
+  void refreshBlocks(size_t begin, size_t end);
+
+  void clearBlocks() { leaves_ = 0; }
+
+  // Calls fn(index) for each entry in [begin, end) overlapping `box`.
+  template <typename F>
+  void forEachOverlap(const AABB &box, size_t begin, size_t end,
+                      F &&fn) const;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data-parallel loops in the engine
+// systems. The calling thread takes part in the work and parallelFor
+// returns once every chunk is done.
+class ThreadPool {
+ public:
+  using RangeFn = std::function<void(size_t begin, size_t end)>;
+
+  explicit ThreadPool(size_t workers);
+
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  // Shared pool with one worker per hardware thread besides the caller.
+  static ThreadPool &instance();
+
+  size_t concurrency() const { return workers_.size() + 1; }
+
+  // Splits [0, count) into contiguous chunks of at least `grain` items and
+  // runs `fn` on them. Small ranges run inline on the caller.
+  void parallelFor(size_t count, size_t grain, const RangeFn &fn);
+
+ private:
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable work_ready_;
+  std::condition_variable work_done_;
+
+  // The loop being run; parallelFor calls don't overlap.
+  std::mutex loop_mutex_;
+  const RangeFn *fn_{nullptr};
+  size_t count_{0};
+  size_t chunk_{0};
+  size_t next_chunk_{0};
+  size_t chunks_{0};
+  size_t finished_{0};
+  uint64_t generation_{0};
+  bool stopping_{false};
+
+  void workerLoop();
+
+  // Runs chunks of the current loop until none are left.
+  void runChunks(std::unique_lock<std::mutex> &lock);
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+
+// Accumulates real frame time and hands it out as whole fixed steps, so
+// the simulation advances at the same rate whatever the frame rate.
+class FixedTimestep {
+ public:
+  explicit FixedTimestep(float step, int max_substeps = 5)
+      : step_(step), max_substeps_(max_substeps) {
+    assert(step > 0.0f && max_substeps > 0);
+  }
+
+  // Adds `elapsed` seconds and returns how many steps to run now. When a
+  // slow frame owes more than max_substeps, the excess time is dropped
+  // rather than carried into the next frames.
+  int advance(float elapsed) {
+    accumulator_ += std::max(elapsed, 0.0f);
+    int steps = static_cast<int>(accumulator_ / step_);
+    if (steps > max_substeps_) {
+      steps = max_substeps_;
+      accumulator_ = 0.0f;
+    } else {
+      accumulator_ -= static_cast<float>(steps) * step_;
+    }
+    return steps;
+  }
+
+  // How far between the last two steps the current time is, in [0, 1).
+  float alpha() const { return std::min(accumulator_ / step_, 1.0f); }
+
+  float step() const { return step_; }
+
+ private:
+  float step_;
+  int max_substeps_;
+  float accumulator_{0.0f};
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Positions, rotations and uniform scales stored as separate arrays, the
+// layout composeTRS reads 4 (SSE) or 8 (AVX2) transforms at a time from.
+class TRSBatch {
+ public:
+  struct View {
+    const float *position_x;
+    const float *position_y;
+    const float *position_z;
+    const float *rotation_x;
+    const float *rotation_y;
+    const float *rotation_z;
+    const float *rotation_w;
+    const float *scale;
+    size_t size;
+  };
+
+  size_t size() const { return scale_.size(); }
+
+  void clear();
+
+  void reserve(size_t count);
+
+  void push(const glm::vec3 &position, const glm::quat &rotation,
+            float scale);
+
+  View view() const;
+
+ private:
+  std::vector<float> position_x_, position_y_, position_z_;
+  std::vector<float> rotation_x_, rotation_y_, rotation_z_, rotation_w_;
+  std::vector<float> scale_;
+};
+
+// Writes translate(position) * toMat4(rotation) * scale for each
+// transform, the matrix calculateModelMatrix builds, without the full
+// 4x4 multiplies. Rotations are expected to be unit quaternions.
+void composeTRS(const TRSBatch::View &transforms,
+                std::span<glm::mat4> out);
+
+// out[i] = parents[i] * locals[i] for affine matrices (last row 0 0 0 1),
+// as composeTRS produces. `out` may be `locals`.
+void multiplyAffine(std::span<const glm::mat4> parents,
+                    std::span<const glm::mat4> locals,
+                    std::span<glm::mat4> out);
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "sunset/ecs.h"
+#include "sunset/geometry.h"
+#include "sunset/transform_batch.h"
+
+// Keeps Transform::cached_model, the world matrix, up to date, visiting
+// every hierarchy from its root so a parent is always done before its
+// children. Only dirty transforms, the ones mid-interpolation and the
+// descendants of either are recomputed; the rest keep last frame's
+// matrix. The recomputed ones are composed and multiplied by their
+// parents in batches, one hierarchy level at a time.
+class TransformSystem {
+ public:
+  // `alpha` blends each transform between its previous and current pose,
+  // as in calculateModelMatrix.
+  void update(ECS &ecs, float alpha = 1.0f);
+
+  // Transforms recomputed by the last update.
+  size_t recomputed() const { return changed_.size(); }
+
+ private:
+  struct Pending {
+    Entity entity;
+    // Transform of the parent, null for roots, and its depth among the
+    // transforms recomputed this update, or -1 if it is unchanged.
+    const Transform *parent;
+    int parent_depth;
+  };
+
+  struct Changed {
+    Transform *transform;
+    const Transform *parent;
+    int depth;
+  };
+
+  std::vector<Pending> stack_;
+  // Sorted by depth before the matrices are computed, so each parent
+  // is done before its children.
+  std::vector<Changed> changed_;
+  TRSBatch poses_;
+  std::vector<glm::mat4> parents_;
+  std::vector<glm::mat4> matrices_;
+};
@@ -0,0 +1,309 @@
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <limits>
+#include <optional>
+
+#include "sunset/aabb_batch.h"
+
+namespace {
+
+constexpr float kInfinity = std::numeric_limits<float>::infinity();
+
+SimdLevel &currentLevel() {
+  static SimdLevel level = detectSimdLevel();
+  return level;
+}
+
+template <typename T>
+void rotateColumn(std::vector<T> &column, size_t from, size_t to) {
+  if (from < to) {
+    std::rotate(column.begin() + from, column.begin() + from + 1,
+                column.begin() + to + 1);
+  } else if (to < from) {
+    std::rotate(column.begin() + to, column.begin() + from,
+                column.begin() + from + 1);
+  }
+}
+
+void overlapScalar(const AABB &box, const AABBBatch::View &boxes,
+                   size_t begin, std::span<uint64_t> mask) {
+  for (size_t i = begin; i < boxes.size; i++) {
+    bool hit = boxes.min_x[i] <= box.max.x && boxes.max_x[i] >= box.min.x &&
+               boxes.min_y[i] <= box.max.y && boxes.max_y[i] >= box.min.y &&
+               boxes.min_z[i] <= box.max.z && boxes.max_z[i] >= box.min.z;
+    if (hit) mask[i / 64] |= uint64_t{1} << (i % 64);
+  }
+}
+
+void raySlabsScalar(const Ray &ray, float max_distance,
+                    const AABBBatch::View &boxes, size_t begin,
+                    std::span<float> out) {
+  for (size_t i = begin; i < boxes.size; i++) {
+    std::optional<float> t = ray.intersect(boxes.get(i), max_distance);
+    out[i] = t ? *t : kInfinity;
+  }
+}
+
+#ifdef SUNSET_X86_SIMD
+
+// Axis `axis` of the lower and upper corners.
+struct Columns {
+  const float *min;
+  const float *max;
+};
+
+Columns columns(const AABBBatch::View &boxes, int axis) {
+  switch (axis) {
+    case 0:
+      return {boxes.min_x, boxes.max_x};
+    case 1:
+      return {boxes.min_y, boxes.max_y};
+    default:
+      return {boxes.min_z, boxes.max_z};
+  }
+}
+
+void overlapSSE(const AABB &box, const AABBBatch::View &boxes,
+                std::span<uint64_t> mask) {
+  size_t i = 0;
+  for (; i + 4 <= boxes.size; i += 4) {
+    __m128 hit = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (int axis = 0; axis < 3; axis++) {
+      Columns c = columns(boxes, axis);
+      hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_loadu_ps(c.min + i),
+                                         _mm_set1_ps(box.max[axis])));
+      hit = _mm_and_ps(hit, _mm_cmpge_ps(_mm_loadu_ps(c.max + i),
+                                         _mm_set1_ps(box.min[axis])));
+    }
+    uint64_t bits = static_cast<uint32_t>(_mm_movemask_ps(hit));
+    mask[i / 64] |= bits << (i % 64);
+  }
+  overlapScalar(box, boxes, i, mask);
+}
+
+__attribute__((target("avx2"))) void overlapAVX2(
+    const AABB &box, const AABBBatch::View &boxes,
+    std::span<uint64_t> mask) {
+  size_t i = 0;
+  for (; i + 8 <= boxes.size; i += 8) {
+    __m256 hit = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (int axis = 0; axis < 3; axis++) {
+      Columns c = columns(boxes, axis);
+      hit = _mm256_and_ps(
+          hit, _mm256_cmp_ps(_mm256_loadu_ps(c.min + i),
+                             _mm256_set1_ps(box.max[axis]), _CMP_LE_OQ));
+      hit = _mm256_and_ps(
+          hit, _mm256_cmp_ps(_mm256_loadu_ps(c.max + i),
+                             _mm256_set1_ps(box.min[axis]), _CMP_GE_OQ));
+    }
+    uint64_t bits = static_cast<uint32_t>(_mm256_movemask_ps(hit));
+    mask[i / 64] |= bits << (i % 64);
+  }
+  overlapScalar(box, boxes, i, mask);
+}
+
+// The ray is the same for every lane, so the per-axis branches of
+// Ray::intersect (zero direction, which slab is entered first) are taken
+// once per axis rather than per box.
+
+void raySlabsSSE(const Ray &ray, float max_distance,
+                 const AABBBatch::View &boxes, std::span<float> out) {
+  size_t i = 0;
+  for (; i + 4 <= boxes.size; i += 4) {
+    __m128 t_enter = _mm_setzero_ps();
+    __m128 t_exit = _mm_set1_ps(max_distance);
+    __m128 miss = _mm_setzero_ps();
+
+    for (int axis = 0; axis < 3; axis++) {
+      Columns c = columns(boxes, axis);
+      __m128 min = _mm_loadu_ps(c.min + i);
+      __m128 max = _mm_loadu_ps(c.max + i);
+      __m128 origin = _mm_set1_ps(ray.origin[axis]);
+
+      if (ray.direction[axis] == 0.0f) {
+        miss = _mm_or_ps(miss, _mm_or_ps(_mm_cmplt_ps(origin, min),
+                                         _mm_cmpgt_ps(origin, max)));
+        continue;
+      }
+
+      __m128 inv = _mm_set1_ps(1.0f / ray.direction[axis]);
+      __m128 t0 = _mm_mul_ps(_mm_sub_ps(min, origin), inv);
+      __m128 t1 = _mm_mul_ps(_mm_sub_ps(max, origin), inv);
+      if (ray.direction[axis] < 0.0f) std::swap(t0, t1);
+
+      t_enter = _mm_max_ps(t0, t_enter);
+      t_exit = _mm_min_ps(t1, t_exit);
+    }
+
+    miss = _mm_or_ps(miss, _mm_cmpgt_ps(t_enter, t_exit));
+    _mm_storeu_ps(out.data() + i,
+                  _mm_or_ps(_mm_andnot_ps(miss, t_enter),
+                            _mm_and_ps(miss, _mm_set1_ps(kInfinity))));
+  }
+  raySlabsScalar(ray, max_distance, boxes, i, out);
+}
+
+__attribute__((target("avx2"))) void raySlabsAVX2(
+    const Ray &ray, float max_distance, const AABBBatch::View &boxes,
+    std::span<float> out) {
+  size_t i = 0;
+  for (; i + 8 <= boxes.size; i += 8) {
+    __m256 t_enter = _mm256_setzero_ps();
+    __m256 t_exit = _mm256_set1_ps(max_distance);
+    __m256 miss = _mm256_setzero_ps();
+
+    for (int axis = 0; axis < 3; axis++) {
+      Columns c = columns(boxes, axis);
+      __m256 min = _mm256_loadu_ps(c.min + i);
+      __m256 max = _mm256_loadu_ps(c.max + i);
+      __m256 origin = _mm256_set1_ps(ray.origin[axis]);
+
+      if (ray.direction[axis] == 0.0f) {
+        miss = _mm256_or_ps(
+            miss, _mm256_or_ps(_mm256_cmp_ps(origin, min, _CMP_LT_OQ),
+                               _mm256_cmp_ps(origin, max, _CMP_GT_OQ)));
+        continue;
+      }
+
+      __m256 inv = _mm256_set1_ps(1.0f / ray.direction[axis]);
+      __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(min, origin), inv);
+      __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(max, origin), inv);
+      if (ray.direction[axis] < 0.0f) std::swap(t0, t1);
+
+      t_enter = _mm256_max_ps(t0, t_enter);
+      t_exit = _mm256_min_ps(t1, t_exit);
+    }
+
+    miss = _mm256_or_ps(miss, _mm256_cmp_ps(t_enter, t_exit, _CMP_GT_OQ));
+    _mm256_storeu_ps(out.data() + i,
+                     _mm256_blendv_ps(t_enter, _mm256_set1_ps(kInfinity),
+                                      miss));
+  }
+  raySlabsScalar(ray, max_distance, boxes, i, out);
+}
+
+#endif
+
+} // namespace
+
+void AABBBatch::clear() {
+  resize(0);
+}
+
+void AABBBatch::reserve(size_t count) {
+  for (auto *column :
+       {&min_x_, &min_y_, &min_z_, &max_x_, &max_y_, &max_z_}) {
+    column->reserve(count);
+  }
+}
+
+void AABBBatch::resize(size_t count) {
+  for (auto *column :
+       {&min_x_, &min_y_, &min_z_, &max_x_, &max_y_, &max_z_}) {
+    column->resize(count);
+  }
+}
+
+void AABBBatch::push(const AABB &aabb) {
+  resize(size() + 1);
+  set(size() - 1, aabb);
+}
+
+void AABBBatch::set(size_t i, const AABB &aabb) {
+  min_x_[i] = aabb.min.x;
+  min_y_[i] = aabb.min.y;
+  min_z_[i] = aabb.min.z;
+  max_x_[i] = aabb.max.x;
+  max_y_[i] = aabb.max.y;
+  max_z_[i] = aabb.max.z;
+}
+
+void AABBBatch::erase(size_t i) {
+  for (auto *column :
+       {&min_x_, &min_y_, &min_z_, &max_x_, &max_y_, &max_z_}) {
+    column->erase(column->begin() + i);
+  }
+}
+
+void AABBBatch::rotate(size_t from, size_t to) {
+  for (auto *column :
+       {&min_x_, &min_y_, &min_z_, &max_x_, &max_y_, &max_z_}) {
+    rotateColumn(*column, from, to);
+  }
+}
+
+const std::vector<float> &AABBBatch::mins(int axis) const {
+  assert(axis >= 0 && axis < 3);
+  return axis == 0 ? min_x_ : axis == 1 ? min_y_ : min_z_;
+}
+
+const std::vector<float> &AABBBatch::maxs(int axis) const {
+  assert(axis >= 0 && axis < 3);
+  return axis == 0 ? max_x_ : axis == 1 ? max_y_ : max_z_;
+}
+
+AABBBatch::View AABBBatch::view(size_t begin, size_t end) const {
+  assert(begin <= end && end <= size());
+  return {min_x_.data() + begin, min_y_.data() + begin,
+          min_z_.data() + begin, max_x_.data() + begin,
+          max_y_.data() + begin, max_z_.data() + begin,
+          end - begin};
+}
+
+SimdLevel detectSimdLevel() {
+#ifdef SUNSET_X86_SIMD
+  static const SimdLevel detected = [] {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+    if (__builtin_cpu_supports("sse2")) return SimdLevel::SSE;
+    return SimdLevel::Scalar;
+  }();
+  return detected;
+#else
+  return SimdLevel::Scalar;
+#endif
+}
+
+SimdLevel simdLevel() { return currentLevel(); }
+
+void setSimdLevel(SimdLevel level) {
+  currentLevel() = std::min(level, detectSimdLevel());
+}
+
+void overlapMask(const AABB &box, const AABBBatch::View &boxes,
+                 std::span<uint64_t> mask) {
+  assert(mask.size() >= maskWords(boxes.size));
+  std::fill_n(mask.begin(), maskWords(boxes.size), 0);
+
+  switch (simdLevel()) {
+#ifdef SUNSET_X86_SIMD
+    case SimdLevel::AVX2:
+      overlapAVX2(box, boxes, mask);
+      return;
+    case SimdLevel::SSE:
+      overlapSSE(box, boxes, mask);
+      return;
+#endif
+    default:
+      overlapScalar(box, boxes, 0, mask);
+  }
+}
+
+void raySlabs(const Ray &ray, float max_distance,
+              const AABBBatch::View &boxes, std::span<float> out) {
+  assert(out.size() >= boxes.size);
+
+  switch (simdLevel()) {
+#ifdef SUNSET_X86_SIMD
+    case SimdLevel::AVX2:
+      raySlabsAVX2(ray, max_distance, boxes, out);
+      return;
+    case SimdLevel::SSE:
+      raySlabsSSE(ray, max_distance, boxes, out);
+      return;
+#endif
+    default:
+      raySlabsScalar(ray, max_distance, boxes, 0, out);
+  }
+}
@@ -0,0 +1,341 @@
+#include <algorithm>
+#include <cassert>
+
+#include "sunset/aabb_tree.h"
+
+DynamicAABBTree::DynamicAABBTree(float margin) : margin_(margin) {}
+
+int32_t DynamicAABBTree::allocateNode() {
+  if (free_list_ == kNull) {
+    nodes_.emplace_back();
+    return static_cast<int32_t>(nodes_.size() - 1);
+  }
+
+  int32_t index = free_list_;
+  free_list_ = nodes_[index].parent;
+  nodes_[index] = Node{};
+  return index;
+}
+
+void DynamicAABBTree::freeNode(int32_t index) {
+  nodes_[index].parent = free_list_;
+  nodes_[index].height = -1;
+  free_list_ = index;
+}
+
+void DynamicAABBTree::insert(Entity entity, const AABB &aabb) {
+  assert(!leaves_.contains(entity));
+
+  int32_t leaf = allocateNode();
+  nodes_[leaf].aabb = aabb.expand(margin_);
+  nodes_[leaf].entity = entity;
+  leaves_[entity] = leaf;
+
+  insertLeaf(leaf);
+}
+
+void DynamicAABBTree::remove(Entity entity) {
+  auto it = leaves_.find(entity);
+  if (it == leaves_.end()) {
+    return;
+  }
+
+  removeLeaf(it->second);
+  freeNode(it->second);
+  leaves_.erase(it);
+}
+
+void DynamicAABBTree::update(Entity entity, const AABB &aabb) {
+  auto it = leaves_.find(entity);
+  if (it == leaves_.end()) {
+    insert(entity, aabb);
+    return;
+  }
+
+  int32_t leaf = it->second;
+  if (nodes_[leaf].aabb.contains(aabb)) {
+    return;
+  }
+
+  removeLeaf(leaf);
+  nodes_[leaf].aabb = aabb.expand(margin_);
+  insertLeaf(leaf);
+}
+
+void DynamicAABBTree::entities(std::vector<Entity> &out) const {
+  out.reserve(out.size() + leaves_.size());
+  for (const auto &[entity, leaf] : leaves_) {
+    out.push_back(entity);
+  }
+}
+
+void DynamicAABBTree::query(const AABB &aabb,
+                            std::vector<Entity> &out) const {
+  if (root_ == kNull) {
+    return;
+  }
+
+  int32_t stack[256];
+  size_t top = 0;
+  stack[top++] = root_;
+
+  while (top > 0) {
+    const Node &node = nodes_[stack[--top]];
+    if (!node.aabb.intersects(aabb)) {
+      continue;
+    }
+
+    if (node.isLeaf()) {
+      out.push_back(node.entity);
+    } else {
+      assert(top + 2 <= std::size(stack));
+      stack[top++] = node.child1;
+      stack[top++] = node.child2;
+    }
+  }
+}
+
+void DynamicAABBTree::queryRay(const Ray &ray, float max_distance,
+                               std::vector<Entity> &out) const {
+  if (root_ == kNull) {
+    return;
+  }
+
+  int32_t stack[256];
+  size_t top = 0;
+  stack[top++] = root_;
+
+  while (top > 0) {
+    const Node &node = nodes_[stack[--top]];
+    if (!ray.intersect(node.aabb, max_distance)) {
+      continue;
+    }
+
+    if (node.isLeaf()) {
+      out.push_back(node.entity);
+    } else {
+      assert(top + 2 <= std::size(stack));
+      stack[top++] = node.child1;
+      stack[top++] = node.child2;
+    }
+  }
+}
+
+void DynamicAABBTree::queryPairs(
+    std::vector<std::pair<Entity, Entity>> &out) const {
+  std::vector<Entity> candidates;
+  for (const auto &[entity, leaf] : leaves_) {
+    candidates.clear();
+    query(nodes_[leaf].aabb, candidates);
+    for (Entity other : candidates) {
+      if (entity < other) {
+        out.emplace_back(entity, other);
+      }
+    }
+  }
+}
+
+int32_t DynamicAABBTree::height() const {
+  return root_ == kNull ? -1 : nodes_[root_].height;
+}
+
+void DynamicAABBTree::insertLeaf(int32_t leaf) {
+  if (root_ == kNull) {
+    root_ = leaf;
+    nodes_[leaf].parent = kNull;
+    return;
+  }
+
+  // Descend towards the sibling that minimizes the added surface area.
+  AABB leaf_aabb = nodes_[leaf].aabb;
+  int32_t index = root_;
+  while (!nodes_[index].isLeaf()) {
+    const Node &node = nodes_[index];
+
+    float area = node.aabb.getSurfaceArea();
+    float combined_area = node.aabb.merge(leaf_aabb).getSurfaceArea();
+
+    // Cost of pairing the leaf with this node under a new parent.
+    float cost = 2.0f * combined_area;
+    // Minimum cost pushed onto the ancestors by descending further.
+    float inheritance_cost = 2.0f * (combined_area - area);
+
+    auto descendCost = [&](int32_t child) {
+      const Node &c = nodes_[child];
+      float merged = c.aabb.merge(leaf_aabb).getSurfaceArea();
+      return (c.isLeaf() ? merged : merged - c.aabb.getSurfaceArea()) +
+             inheritance_cost;
+    };
+
+    float cost1 = descendCost(node.child1);
+    float cost2 = descendCost(node.child2);
+
+    if (cost < cost1 && cost < cost2) {
+      break;
+    }
+
+    index = cost1 < cost2 ? node.child1 : node.child2;
+  }
+
+  int32_t sibling = index;
+  int32_t old_parent = nodes_[sibling].parent;
+  int32_t new_parent = allocateNode();
+
+  nodes_[new_parent].parent = old_parent;
+  nodes_[new_parent].aabb = leaf_aabb.merge(nodes_[sibling].aabb);
+  nodes_[new_parent].height = nodes_[sibling].height + 1;
+  nodes_[new_parent].child1 = sibling;
+  nodes_[new_parent].child2 = leaf;
+  nodes_[sibling].parent = new_parent;
+  nodes_[leaf].parent = new_parent;
+
+  if (old_parent == kNull) {
+    root_ = new_parent;
+  } else if (nodes_[old_parent].child1 == sibling) {
+    nodes_[old_parent].child1 = new_parent;
+  } else {
+    nodes_[old_parent].child2 = new_parent;
+  }
+
+  refit(new_parent);
+}
+
+void DynamicAABBTree::removeLeaf(int32_t leaf) {
+  if (leaf == root_) {
+    root_ = kNull;
+    return;
+  }
+
+  int32_t parent = nodes_[leaf].parent;
+  int32_t grandparent = nodes_[parent].parent;
+  int32_t sibling = nodes_[parent].child1 == leaf ? nodes_[parent].child2
+                                                  : nodes_[parent].child1;
+
+  freeNode(parent);
+
+  if (grandparent == kNull) {
+    root_ = sibling;
+    nodes_[sibling].parent = kNull;
+    return;
+  }
+
+  if (nodes_[grandparent].child1 == parent) {
+    nodes_[grandparent].child1 = sibling;
+  } else {
+    nodes_[grandparent].child2 = sibling;
+  }
+  nodes_[sibling].parent = grandparent;
+
+  refit(grandparent);
+}
+
+void DynamicAABBTree::refit(int32_t index) {
+  while (index != kNull) {
+    index = balance(index);
+
+    Node &node = nodes_[index];
+    const Node &child1 = nodes_[node.child1];
+    const Node &child2 = nodes_[node.child2];
+
+    node.height = 1 + std::max(child1.height, child2.height);
+    node.aabb = child1.aabb.merge(child2.aabb);
+
+    index = node.parent;
+  }
+}
+
+int32_t DynamicAABBTree::balance(int32_t ia) {
+  Node &a = nodes_[ia];
+  if (a.isLeaf() || a.height < 2) {
+    return ia;
+  }
+
+  int32_t ib = a.child1;
+  int32_t ic = a.child2;
+  Node &b = nodes_[ib];
+  Node &c = nodes_[ic];
+
+  int32_t skew = c.height - b.height;
+
+  // Rotate C up.
+  if (skew > 1) {
+    int32_t if_ = c.child1;
+    int32_t ig = c.child2;
+    Node &f = nodes_[if_];
+    Node &g = nodes_[ig];
+
+    c.child1 = ia;
+    c.parent = a.parent;
+    a.parent = ic;
+
+    if (c.parent == kNull) {
+      root_ = ic;
+    } else if (nodes_[c.parent].child1 == ia) {
+      nodes_[c.parent].child1 = ic;
+    } else {
+      nodes_[c.parent].child2 = ic;
+    }
+
+    if (f.height > g.height) {
+      c.child2 = if_;
+      a.child2 = ig;
+      g.parent = ia;
+      a.aabb = b.aabb.merge(g.aabb);
+      c.aabb = a.aabb.merge(f.aabb);
+      a.height = 1 + std::max(b.height, g.height);
+      c.height = 1 + std::max(a.height, f.height);
+    } else {
+      c.child2 = ig;
+      a.child2 = if_;
+      f.parent = ia;
+      a.aabb = b.aabb.merge(f.aabb);
+      c.aabb = a.aabb.merge(g.aabb);
+      a.height = 1 + std::max(b.height, f.height);
+      c.height = 1 + std::max(a.height, g.height);
+    }
+
+    return ic;
+  }
+
+  // Rotate B up.
+  if (skew < -1) {
+    int32_t id = b.child1;
+    int32_t ie = b.child2;
+    Node &d = nodes_[id];
+    Node &e = nodes_[ie];
+
+    b.child1 = ia;
+    b.parent = a.parent;
+    a.parent = ib;
+
+    if (b.parent == kNull) {
+      root_ = ib;
+    } else if (nodes_[b.parent].child1 == ia) {
+      nodes_[b.parent].child1 = ib;
+    } else {
+      nodes_[b.parent].child2 = ib;
+    }
+
+    if (d.height > e.height) {
+      b.child2 = id;
+      a.child1 = ie;
+      e.parent = ia;
+      a.aabb = c.aabb.merge(e.aabb);
+      b.aabb = a.aabb.merge(d.aabb);
+      a.height = 1 + std::max(c.height, e.height);
+      b.height = 1 + std::max(a.height, d.height);
+    } else {
+      b.child2 = ie;
+      a.child1 = id;
+      d.parent = ia;
+      a.aabb = c.aabb.merge(d.aabb);
+      b.aabb = a.aabb.merge(e.aabb);
+      a.height = 1 + std::max(c.height, d.height);
+      b.height = 1 + std::max(a.height, e.height);
+    }
+
+    return ib;
+  }
+
+  return ia;
+}
@@ -26,7 +26,8 @@ struct AnimationClip {
 void stepSkeletal(ECS &ecs) {
   ecs.forEach(std::function(
       [&](Entity entity, Transform *transform, Skeleton *skeleton) {
-        glm::mat4 model = calculateModelMatrix(ecs, entity);
+        // Up to date once the TransformSystem has run this frame.
+        const glm::mat4 &model = transform->cached_model;
         size_t count = skeleton->bones.size();
         skeleton->final_transforms.resize(count);
 
@@ -147,104 +147,112 @@ class UploadCache {
   std::unordered_map<RRef, Handle> cache_;
 };
 
-void compileScene(ECS &ecs, Backend &backend) {
-  std::vector<std::pair<Entity, MeshRenderable>> to_add;
-
-  ecs.forEach(std::function([&](Entity entity, MeshRef *mesh_ref) {
-    PropertyTree tree =
-        ResourceManager::instance()
-            .getResource(mesh_ref->rref.scope, mesh_ref->rref.resource_id)
-            .value();
-
-    absl::StatusOr<SavedMesh> saved_mesh = deserializeTree<SavedMesh>(tree);
-    if (!saved_mesh.ok()) return;
-
-    std::optional<Handle> texture_handle = std::nullopt;
-    std::optional<std::string> texture_path = std::nullopt;
-
-    // Handle texture processing with cache
-    if (TextureRef *texture_ref = ecs.getComponent<TextureRef>(entity)) {
-      // Check if texture is already cached
-      if (UploadCache::instance().contains(texture_ref->rref)) {
-        texture_handle = UploadCache::instance().get(texture_ref->rref);
-      } else {
-        // Texture not cached, need to load and upload it
-        std::optional<PropertyTree> tex_tree =
-            ResourceManager::instance()
-                .getResource(texture_ref->rref.scope,
-                             texture_ref->rref.resource_id)
-                .value();
-
-        absl::StatusOr<Texture> saved =
-            deserializeTree<Texture>(tex_tree.value());
-        assert(saved.ok());
-        texture_path = saved->src;
-
-        std::optional<Image> texture_image;
-        if (texture_path.has_value()) {
-          absl::StatusOr<Image> result = loadTextureFromSrc(*texture_path);
-          if (result.ok()) {
-            texture_image = *result;
-            // Upload texture to backend and cache the handle
-            Handle uploaded_texture = backend.uploadTexture(*texture_image);
-            UploadCache::instance().insert(texture_ref->rref, uploaded_texture);
-            texture_handle = uploaded_texture;
-          }
+absl::StatusOr<MeshRenderable> compileMeshRef(
+    Backend &backend, const MeshRef &mesh_ref,
+    const TextureRef *texture_ref) {
+  PropertyTree tree =
+      ResourceManager::instance()
+          .getResource(mesh_ref.rref.scope, mesh_ref.rref.resource_id)
+          .value();
+
+  absl::StatusOr<SavedMesh> saved_mesh = deserializeTree<SavedMesh>(tree);
+  if (!saved_mesh.ok()) return saved_mesh.status();
+
+  std::optional<Handle> texture_handle = std::nullopt;
+  std::optional<std::string> texture_path = std::nullopt;
+
+  // Handle texture processing with cache
+  if (texture_ref) {
+    // Check if texture is already cached
+    if (UploadCache::instance().contains(texture_ref->rref)) {
+      texture_handle = UploadCache::instance().get(texture_ref->rref);
+    } else {
+      // Texture not cached, need to load and upload it
+      std::optional<PropertyTree> tex_tree =
+          ResourceManager::instance()
+              .getResource(texture_ref->rref.scope,
+                           texture_ref->rref.resource_id)
+              .value();
+
+      absl::StatusOr<Texture> saved =
+          deserializeTree<Texture>(tex_tree.value());
+      assert(saved.ok());
+      texture_path = saved->src;
+
+      std::optional<Image> texture_image;
+      if (texture_path.has_value()) {
+        absl::StatusOr<Image> result = loadTextureFromSrc(*texture_path);
+        if (result.ok()) {
+          texture_image = *result;
+          // Upload texture to backend and cache the handle
+          Handle uploaded_texture = backend.uploadTexture(*texture_image);
+          UploadCache::instance().insert(texture_ref->rref, uploaded_texture);
+          texture_handle = uploaded_texture;
         }
       }
     }
+  }
 
-    // Handle mesh processing with cache
-    std::optional<Handle> mesh_vertex_handle = std::nullopt;
-    std::optional<Handle> mesh_index_handle = std::nullopt;
+  // Handle mesh processing with cache
+  std::optional<Handle> mesh_vertex_handle = std::nullopt;
+  std::optional<Handle> mesh_index_handle = std::nullopt;
+  
+  // Check if mesh is already cached
+  if (UploadCache::instance().contains(mesh_ref.rref)) {
+    // For mesh, we might need to store both vertex and index handles
+    // This assumes the cached Handle represents the vertex buffer
+    // You might need to modify this based on your actual mesh caching strategy
+    mesh_vertex_handle = UploadCache::instance().get(mesh_ref.rref);
     
-    // Check if mesh is already cached
-    if (UploadCache::instance().contains(mesh_ref->rref)) {
-      // For mesh, we might need to store both vertex and index handles
-      // This assumes the cached Handle represents the vertex buffer
-      // You might need to modify this based on your actual mesh caching strategy
-      mesh_vertex_handle = UploadCache::instance().get(mesh_ref->rref);
-      
-      // If you need separate caching for vertex and index buffers, you could use
-      // modified RRefs or store a compound handle structure
-    }
+    // If you need separate caching for vertex and index buffers, you could use
+    // modified RRefs or store a compound handle structure
+  }
+  
+  absl::StatusOr<MeshRenderable> renderable;
+  
+  if (mesh_vertex_handle.has_value()) {
+    // Mesh is cached, construct MeshRenderable from cached data
+    // You'll need to also cache other mesh data like vertex_count, index_count, normal
+    // This is a simplified version - you might need to extend your cache to store
+    // complete MeshRenderable data or use a different caching strategy
     
-    absl::StatusOr<MeshRenderable> renderable;
+    // For now, we still need to load the mesh to get counts and normal
+    // A more sophisticated approach would cache the entire MeshRenderable
+    std::optional<Image> texture_image; // We already have the handle, so no image needed
+    renderable = loadSavedMesh(mesh_ref, *saved_mesh, texture_image, backend);
     
-    if (mesh_vertex_handle.has_value()) {
-      // Mesh is cached, construct MeshRenderable from cached data
-      // You'll need to also cache other mesh data like vertex_count, index_count, normal
-      // This is a simplified version - you might need to extend your cache to store
-      // complete MeshRenderable data or use a different caching strategy
-      
-      // For now, we still need to load the mesh to get counts and normal
-      // A more sophisticated approach would cache the entire MeshRenderable
-      std::optional<Image> texture_image; // We already have the handle, so no image needed
-      renderable = loadSavedMesh(*mesh_ref, *saved_mesh, texture_image, backend);
-      
-      if (renderable.ok()) {
-        // Replace the uploaded handles with cached ones
-        renderable->vertex_buffer = *mesh_vertex_handle;
-        if (texture_handle.has_value()) {
-          renderable->texture = texture_handle;
-        }
+    if (renderable.ok()) {
+      // Replace the uploaded handles with cached ones
+      renderable->vertex_buffer = *mesh_vertex_handle;
+      if (texture_handle.has_value()) {
+        renderable->texture = texture_handle;
       }
-    } else {
-      // Mesh not cached, need to load and upload it
-      std::optional<Image> texture_image; // We handle texture separately now
-      renderable = loadSavedMesh(*mesh_ref, *saved_mesh, texture_image, backend);
+    }
+  } else {
+    // Mesh not cached, need to load and upload it
+    std::optional<Image> texture_image; // We handle texture separately now
+    renderable = loadSavedMesh(mesh_ref, *saved_mesh, texture_image, backend);
+    
+    if (renderable.ok()) {
+      // Cache the mesh handles
+      UploadCache::instance().insert(mesh_ref.rref, renderable->vertex_buffer);
       
-      if (renderable.ok()) {
-        // Cache the mesh handles
-        UploadCache::instance().insert(mesh_ref->rref, renderable->vertex_buffer);
-        
-        // Set the texture handle if we have one
-        if (texture_handle.has_value()) {
-          renderable->texture = texture_handle;
-        }
+      // Set the texture handle if we have one
+      if (texture_handle.has_value()) {
+        renderable->texture = texture_handle;
       }
     }
+  }
 
+  return renderable;
+}
+
+void compileScene(ECS &ecs, Backend &backend) {
+  std::vector<std::pair<Entity, MeshRenderable>> to_add;
+
+  ecs.forEach(std::function([&](Entity entity, MeshRef *mesh_ref) {
+    absl::StatusOr<MeshRenderable> renderable = compileMeshRef(
+        backend, *mesh_ref, ecs.getComponent<TextureRef>(entity));
     if (renderable.ok()) {
       to_add.emplace_back(entity, std::move(*renderable));
     }
@@ -0,0 +1,56 @@
+#include <cassert>
+
+#include "sunset/physics.h"
+
+#include "sunset/body_store.h"
+
+void BodyStore::gather(ECS &ecs) {
+  entities_.clear();
+  positions_.clear();
+  velocities_.clear();
+  accelerations_.clear();
+  colliders_.clear();
+  static_.clear();
+  sleeping_.clear();
+  indexed_ = false;
+
+  ecs.forEach(std::function([&](Entity entity, PhysicsComponent *physics,
+                                Transform *transform) {
+    transform->previous = {transform->position, transform->rotation};
+    entities_.push_back(entity);
+    positions_.push_back(transform->position);
+    velocities_.push_back(physics->velocity);
+    accelerations_.push_back(physics->acceleration);
+    colliders_.push(physics->collider);
+    static_.push_back(physics->type == PhysicsComponent::Type::Static);
+    sleeping_.push_back(physics->sleeping);
+  }));
+}
+
+void BodyStore::scatter(ECS &ecs) const {
+  uint32_t body = 0;
+  ecs.forEach(std::function([&](Entity entity, PhysicsComponent *physics,
+                                Transform * /* transform */) {
+    assert(body < size() && entities_[body] == entity);
+    physics->velocity = velocities_[body++];
+  }));
+}
+
+void BodyStore::integrate(float ticks) {
+  for (size_t i = 0; i < size(); i++) {
+    float scale = (static_[i] | sleeping_[i]) ? 0.0f : ticks;
+    velocities_[i] += accelerations_[i] * scale;
+  }
+}
+
+const uint32_t *BodyStore::find(Entity entity) {
+  if (!indexed_) {
+    index_.clear();
+    index_.reserve(size());
+    for (uint32_t i = 0; i < size(); i++) {
+      index_[entities_[i]] = i;
+    }
+    indexed_ = true;
+  }
+  return index_.find(entity);
+}
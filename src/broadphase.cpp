@@ -0,0 +1,37 @@
+#include <algorithm>
+
+#include "sunset/broadphase.h"
+
+void Broadphase::queryRay(const Ray &ray, float max_distance,
+                          std::vector<Entity> &out) const {
+  AABB segment{ray.origin, ray.origin};
+  query(segment.extendTo(ray.at(max_distance)), out);
+}
+
+void Broadphase::sync(std::span<const BroadphaseProxy> proxies) {
+  std::vector<Entity> tracked;
+  entities(tracked);
+  std::sort(tracked.begin(), tracked.end());
+
+  std::vector<Entity> live;
+  live.reserve(proxies.size());
+  for (const BroadphaseProxy &proxy : proxies) {
+    live.push_back(proxy.entity);
+  }
+  std::sort(live.begin(), live.end());
+
+  std::vector<Entity> stale;
+  std::set_difference(tracked.begin(), tracked.end(), live.begin(),
+                      live.end(), std::back_inserter(stale));
+  for (Entity entity : stale) {
+    remove(entity);
+  }
+
+  for (const BroadphaseProxy &proxy : proxies) {
+    if (contains(proxy.entity)) {
+      update(proxy.entity, proxy.aabb);
+    } else {
+      insert(proxy.entity, proxy.aabb);
+    }
+  }
+}
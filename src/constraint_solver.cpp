@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <cassert>
+
+#include "sunset/thread_pool.h"
+
+#include "sunset/constraint_solver.h"
+
+namespace {
+
+constexpr float kMinLength = 1e-6f;
+
+template <typename T>
+void permute(std::vector<T> &column, const std::vector<uint32_t> &order) {
+  std::vector<T> sorted(column.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    sorted[i] = column[order[i]];
+  }
+  column.swap(sorted);
+}
+
+} // namespace
+
+void ConstraintSolver::clear() {
+  positions_.clear();
+  velocities_.clear();
+  inverse_masses_.clear();
+  keys_.clear();
+  body_a_.clear();
+  body_b_.clear();
+  distances_.clear();
+  impulses_.clear();
+  colour_offsets_.assign(1, 0);
+  serial_begin_ = 0;
+}
+
+uint32_t ConstraintSolver::addBody(glm::vec3 position, glm::vec3 velocity,
+                                   float inverse_mass) {
+  positions_.push_back(position);
+  velocities_.push_back(velocity);
+  inverse_masses_.push_back(inverse_mass);
+  return static_cast<uint32_t>(inverse_masses_.size() - 1);
+}
+
+void ConstraintSolver::addConstraint(uint64_t key, uint32_t a, uint32_t b,
+                                     float distance) {
+  assert(a < bodies() && b < bodies());
+  keys_.push_back(key);
+  body_a_.push_back(a);
+  body_b_.push_back(b);
+  distances_.push_back(distance);
+  const float *warm = warm_impulses_.find(key);
+  impulses_.push_back(warm ? *warm : 0.0f);
+}
+
+void ConstraintSolver::colour() {
+  // Greedy: each constraint takes the lowest colour neither of its
+  // movable bodies is in yet.
+  std::vector<uint64_t> used(bodies(), 0);
+  std::vector<uint32_t> colour_of(constraints());
+  std::vector<uint32_t> counts(kMaxColours + 1, 0);
+  for (size_t i = 0; i < constraints(); i++) {
+    uint32_t a = body_a_[i];
+    uint32_t b = body_b_[i];
+    uint64_t taken = 0;
+    if (inverse_masses_[a] > 0.0f) taken |= used[a];
+    if (inverse_masses_[b] > 0.0f) taken |= used[b];
+
+    uint32_t colour =
+        ~taken == 0 ? kMaxColours
+                    : static_cast<uint32_t>(__builtin_ctzll(~taken));
+    if (colour < kMaxColours) {
+      used[a] |= uint64_t{1} << colour;
+      used[b] |= uint64_t{1} << colour;
+    }
+    colour_of[i] = colour;
+    counts[colour]++;
+  }
+
+  // Stable counting sort by colour keeps the order within a colour.
+  colour_offsets_.assign(1, 0);
+  std::vector<uint32_t> starts(counts.size());
+  uint32_t total = 0;
+  for (size_t colour = 0; colour < counts.size(); colour++) {
+    if (colour == kMaxColours) serial_begin_ = total;
+    starts[colour] = total;
+    total += counts[colour];
+    if (counts[colour] > 0) colour_offsets_.push_back(total);
+  }
+  std::vector<uint32_t> order(constraints());
+  for (size_t i = 0; i < constraints(); i++) {
+    order[starts[colour_of[i]]++] = static_cast<uint32_t>(i);
+  }
+
+  permute(keys_, order);
+  permute(body_a_, order);
+  permute(body_b_, order);
+  permute(distances_, order);
+  permute(impulses_, order);
+}
+
+template <typename F>
+void ConstraintSolver::forEachColour(F &&solve_range) {
+  for (size_t colour = 0; colour + 1 < colour_offsets_.size(); colour++) {
+    uint32_t begin = colour_offsets_[colour];
+    uint32_t end = colour_offsets_[colour + 1];
+    // The overflow bucket may share bodies, so it stays on one thread.
+    size_t grain = begin >= serial_begin_ ? end - begin : kGrain;
+    ThreadPool::instance().parallelFor(
+        end - begin, grain, [&](size_t first, size_t last) {
+          solve_range(begin + first, begin + last);
+        });
+  }
+}
+
+void ConstraintSolver::solve(int iterations) {
+  colour();
+
+  // Fixed bodies may be shared within a colour, so they must not even be
+  // written with a zero change.
+  auto push = [&](std::vector<glm::vec3> &column, uint32_t body,
+                  glm::vec3 change) {
+    if (inverse_masses_[body] > 0.0f) column[body] += change;
+  };
+
+  auto axis = [&](size_t i) {
+    glm::vec3 delta = positions_[body_b_[i]] - positions_[body_a_[i]];
+    float length = glm::length(delta);
+    return length > kMinLength ? delta / length : glm::vec3(0.0f);
+  };
+
+  // Velocities: remove the relative velocity along each constraint,
+  // starting from last step's impulses.
+  forEachColour([&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      uint32_t a = body_a_[i];
+      uint32_t b = body_b_[i];
+      glm::vec3 impulse = axis(i) * impulses_[i];
+      push(velocities_, a, -impulse * inverse_masses_[a]);
+      push(velocities_, b, impulse * inverse_masses_[b]);
+    }
+  });
+  for (int iteration = 0; iteration < iterations; iteration++) {
+    forEachColour([&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        uint32_t a = body_a_[i];
+        uint32_t b = body_b_[i];
+        float w_a = inverse_masses_[a];
+        float w_b = inverse_masses_[b];
+        if (w_a + w_b == 0.0f) continue;
+
+        glm::vec3 n = axis(i);
+        float relative = glm::dot(velocities_[b] - velocities_[a], n);
+        float lambda = -relative / (w_a + w_b);
+        impulses_[i] += lambda;
+        push(velocities_, a, -n * (lambda * w_a));
+        push(velocities_, b, n * (lambda * w_b));
+      }
+    });
+  }
+
+  // Positions: project each pair back to its distance, split by inverse
+  // mass.
+  for (int iteration = 0; iteration < iterations; iteration++) {
+    forEachColour([&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        uint32_t a = body_a_[i];
+        uint32_t b = body_b_[i];
+        float w_a = inverse_masses_[a];
+        float w_b = inverse_masses_[b];
+        if (w_a + w_b == 0.0f) continue;
+
+        glm::vec3 delta = positions_[b] - positions_[a];
+        float length = glm::length(delta);
+        if (length < kMinLength) continue;
+
+        glm::vec3 correction =
+            delta * ((length - distances_[i]) / (length * (w_a + w_b)));
+        push(positions_, a, correction * w_a);
+        push(positions_, b, -correction * w_b);
+      }
+    });
+  }
+
+  warm_impulses_.clear();
+  for (size_t i = 0; i < constraints(); i++) {
+    warm_impulses_[keys_[i]] = impulses_[i];
+  }
+}
@@ -8,34 +8,35 @@
 #include "sunset/controller.h"
 
 FreeController::FreeController(ECS &ecs, EventQueue &event_queue) {
+  // Each frame's key state sets the walking velocity, which the physics
+  // steps move the player by, however many run per frame.
   event_queue.subscribe(std::function([&](KeyPressed const &pressed) {
-    ecs.forEach(std::function(
-        [&](Entity entity, Player *player, Transform *transform) {
-          glm::vec3 forward =
-              glm::rotate(transform->rotation, glm::vec3(0, 0, -1));
-          glm::vec3 right =
-              glm::rotate(transform->rotation, glm::vec3(1, 0, 0));
-
-          if (pressed.map.test(static_cast<size_t>(Key::W))) {
-            PhysicsSystem::instance().moveObject(
-                ecs, entity, player->speed * forward, event_queue);
-          }
-
-          if (pressed.map.test(static_cast<size_t>(Key::S))) {
-            PhysicsSystem::instance().moveObject(
-                ecs, entity, player->speed * -forward, event_queue);
-          }
-
-          if (pressed.map.test(static_cast<size_t>(Key::D))) {
-            PhysicsSystem::instance().moveObject(
-                ecs, entity, player->speed * right, event_queue);
-          }
-
-          if (pressed.map.test(static_cast<size_t>(Key::A))) {
-            PhysicsSystem::instance().moveObject(
-                ecs, entity, player->speed * -right, event_queue);
-          }
-        }));
+    ecs.forEach(std::function([&](Entity entity, Player *player,
+                                  Transform *transform,
+                                  MovementIntent *intent) {
+      glm::vec3 forward =
+          glm::rotate(transform->rotation, glm::vec3(0, 0, -1));
+      glm::vec3 right =
+          glm::rotate(transform->rotation, glm::vec3(1, 0, 0));
+
+      glm::vec3 velocity(0.0f);
+      if (pressed.map.test(static_cast<size_t>(Key::W))) {
+        velocity += player->speed * forward;
+      }
+
+      if (pressed.map.test(static_cast<size_t>(Key::S))) {
+        velocity += player->speed * -forward;
+      }
+
+      if (pressed.map.test(static_cast<size_t>(Key::D))) {
+        velocity += player->speed * right;
+      }
+
+      if (pressed.map.test(static_cast<size_t>(Key::A))) {
+        velocity += player->speed * -right;
+      }
+      intent->velocity = velocity;
+    }));
 
     event_queue.subscribe(std::function([&](MouseMoved const &moved) {
       ecs.forEach(std::function(
@@ -58,6 +59,12 @@ FreeController::FreeController(ECS &ecs, EventQueue &event_queue) {
             transform->rotation =
                 rotation_yaw * rotation_pitch * transform->rotation;
             transform->rotation = glm::normalize(transform->rotation);
+            // Looking around isn't simulated; keep it out of the render
+            // blend so the view turns this frame rather than a step late.
+            if (transform->previous) {
+              transform->previous->rotation = transform->rotation;
+            }
+            transform->dirty = true;
           }));
     }));
   }));
@@ -66,37 +73,38 @@ FreeController::FreeController(ECS &ecs, EventQueue &event_queue) {
 void FreeController::update(ECS &ecs) {}
 
 PlayerController::PlayerController(ECS &ecs, EventQueue &event_queue) {
+  // Each frame's key state sets the walking velocity, which the physics
+  // steps move the player by, however many run per frame.
   event_queue.subscribe(std::function([&](KeyPressed const &pressed) {
-    ecs.forEach(std::function(
-        [&](Entity entity, Player *player, Transform *transform) {
-          glm::vec3 forward =
-              glm::rotate(transform->rotation, glm::vec3(0, 0, -1));
-          glm::vec3 right =
-              glm::rotate(transform->rotation, glm::vec3(1, 0, 0));
-
-          forward.y = 0.0;
-          right.y = 0.0;
-
-          if (pressed.map.test(static_cast<size_t>(Key::W))) {
-            PhysicsSystem::instance().moveObject(
-                ecs, entity, player->speed * forward, event_queue);
-          }
-
-          if (pressed.map.test(static_cast<size_t>(Key::S))) {
-            PhysicsSystem::instance().moveObject(
-                ecs, entity, player->speed * -forward, event_queue);
-          }
-
-          if (pressed.map.test(static_cast<size_t>(Key::D))) {
-            PhysicsSystem::instance().moveObject(
-                ecs, entity, player->speed * right, event_queue);
-          }
-
-          if (pressed.map.test(static_cast<size_t>(Key::A))) {
-            PhysicsSystem::instance().moveObject(
-                ecs, entity, player->speed * -right, event_queue);
-          }
-        }));
+    ecs.forEach(std::function([&](Entity entity, Player *player,
+                                  Transform *transform,
+                                  MovementIntent *intent) {
+      glm::vec3 forward =
+          glm::rotate(transform->rotation, glm::vec3(0, 0, -1));
+      glm::vec3 right =
+          glm::rotate(transform->rotation, glm::vec3(1, 0, 0));
+
+      forward.y = 0.0;
+      right.y = 0.0;
+
+      glm::vec3 velocity(0.0f);
+      if (pressed.map.test(static_cast<size_t>(Key::W))) {
+        velocity += player->speed * forward;
+      }
+
+      if (pressed.map.test(static_cast<size_t>(Key::S))) {
+        velocity += player->speed * -forward;
+      }
+
+      if (pressed.map.test(static_cast<size_t>(Key::D))) {
+        velocity += player->speed * right;
+      }
+
+      if (pressed.map.test(static_cast<size_t>(Key::A))) {
+        velocity += player->speed * -right;
+      }
+      intent->velocity = velocity;
+    }));
 
     event_queue.subscribe(std::function([&](MouseMoved const &moved) {
       ecs.forEach(std::function(
@@ -119,6 +127,12 @@ PlayerController::PlayerController(ECS &ecs, EventQueue &event_queue) {
             transform->rotation =
                 rotation_yaw * rotation_pitch * transform->rotation;
             transform->rotation = glm::normalize(transform->rotation);
+            // Looking around isn't simulated; keep it out of the render
+            // blend so the view turns this frame rather than a step late.
+            if (transform->previous) {
+              transform->previous->rotation = transform->rotation;
+            }
+            transform->dirty = true;
           }));
     }));
   }));
@@ -1,26 +1,196 @@
+#include <bit>
+
 #include "sunset/event_queue.h"
 
-void EventQueue::process() {
-  absl::Time now = absl::Now();
+void LatencyHistogram::record(absl::Duration duration) {
+  int64_t us = absl::ToInt64Microseconds(duration);
+  size_t bucket =
+      us <= 0 ? 0 : static_cast<size_t>(std::bit_width(
+                        static_cast<uint64_t>(us)));
+  buckets[std::min(bucket, kBuckets - 1)]++;
+  count++;
+  total += duration;
+  max = std::max(max, duration);
+}
+
+absl::Duration LatencyHistogram::mean() const {
+  return count == 0 ? absl::ZeroDuration() : total / count;
+}
+
+absl::Duration LatencyHistogram::percentile(double fraction) const {
+  uint64_t target = static_cast<uint64_t>(fraction * count);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBuckets; i++) {
+    seen += buckets[i];
+    if (seen > target) {
+      return i == kBuckets - 1 ? max : absl::Microseconds(1ll << i);
+    }
+  }
+  return max;
+}
+
+EventPhase EventQueue::routeOf(std::type_index type) const {
+  auto it = routes_.find(type);
+  return it == routes_.end() ? EventPhase::EndOfFrame : it->second;
+}
+
+size_t EventQueue::depth() const {
+  size_t total = 0;
+  for (const Channel &channel : channels_) {
+    total += channel.events.size();
+  }
+  return total;
+}
+
+bool EventQueue::push(QueuedEvent event) {
+  Channel &target = channel(routeOf(event.type));
+
+  auto coalescer = coalescers_.find(event.type);
+  if (coalescer != coalescers_.end()) {
+    auto [pending, inserted] = pending_.try_emplace(
+        event.type, target.head_seq + target.events.size());
+    if (!inserted) {
+      coalescer->second(
+          target.events[pending->second - target.head_seq].data,
+          event.data);
+      return true;
+    }
+  }
+
+  target.events.push_back(std::move(event));
+  return false;
+}
 
+EventQueue::QueuedEvent EventQueue::pop(Channel &channel) {
+  QueuedEvent event = std::move(channel.events.front());
+  channel.events.pop_front();
+
+  auto pending = pending_.find(event.type);
+  if (pending != pending_.end() && pending->second == channel.head_seq) {
+    pending_.erase(pending);
+  }
+  channel.head_seq++;
+
+  return event;
+}
+
+void EventQueue::flushDelayed(absl::Time now) {
   for (auto it = delayed_.begin(); it != delayed_.end();) {
     if (it->first <= now) {
-      queue_.push(it->second);
+      bool coalesced = push(it->second);
+#ifdef SUNSET_EVENT_STATS
+      EventTypeStats &stats =
+          stats_.types[stats_index_.at(it->second.type)];
+      stats.sent++;
+      stats.total_sent++;
+      if (coalesced) stats.coalesced++;
+      stats_.peak_depth = std::max(stats_.peak_depth, depth());
+#else
+      unused(coalesced);
+#endif
       it = delayed_.erase(it);
     } else {
       break;
     }
   }
+}
 
-  while (!queue_.empty()) {
-    auto [type, data] = queue_.front();
-    queue_.pop();
+void EventQueue::dispatch(Channel &channel,
+                          std::unique_lock<std::mutex> &lock) {
+  while (!channel.events.empty()) {
+    auto [type, data] = pop(channel);
+    lock.unlock();
 
     auto it = handlers.find(type);
+#ifdef SUNSET_EVENT_STATS
+    lock.lock();
+    EventTypeStats *stats = &stats_.types[stats_index_.at(type)];
+    stats->delivered++;
+    stats->total_delivered++;
+    lock.unlock();
+
+    if (it != handlers.end()) {
+      std::vector<Handler> &type_handlers = it->second;
+      for (size_t i = 0; i < type_handlers.size(); i++) {
+        absl::Time start = absl::Now();
+        type_handlers[i](data);
+        absl::Duration elapsed = absl::Now() - start;
+
+        lock.lock();
+        // Handlers may have registered new types, which can move the
+        // stats storage.
+        stats = &stats_.types[stats_index_.at(type)];
+        stats->handler_time[i].record(elapsed);
+        lock.unlock();
+      }
+    }
+#else
     if (it != handlers.end()) {
       for (auto &handler : it->second) {
         handler(data);
       }
     }
+#endif
+
+    lock.lock();
+  }
+}
+
+void EventQueue::process(EventPhase phase) {
+  absl::Time now = absl::Now();
+
+  std::unique_lock lock(mutex_);
+  flushDelayed(now);
+  dispatch(channel(phase), lock);
+}
+
+void EventQueue::process() {
+  absl::Time now = absl::Now();
+
+  std::unique_lock lock(mutex_);
+  flushDelayed(now);
+
+  // Late handlers may send events to earlier phases; deliver those too
+  // rather than letting them sit until the next frame.
+  while (depth() > 0) {
+    for (Channel &channel : channels_) {
+      dispatch(channel, lock);
+    }
+  }
+
+#ifdef SUNSET_EVENT_STATS
+  endFrameStats();
+#endif
+}
+
+#ifdef SUNSET_EVENT_STATS
+
+void EventQueue::endFrameStats() {
+  for (EventTypeStats &stats : stats_.types) {
+    stats.last_sent = stats.sent;
+    stats.last_delivered = stats.delivered;
+    stats.last_coalesced = stats.coalesced;
+    stats.sent = 0;
+    stats.delivered = 0;
+    stats.coalesced = 0;
   }
+  stats_.last_peak_depth = stats_.peak_depth;
+  stats_.peak_depth = depth();
+  stats_.frames++;
+}
+
+EventQueueStats EventQueue::stats() const {
+  std::lock_guard guard(mutex_);
+  EventQueueStats snapshot = stats_;
+  snapshot.depth = depth();
+  snapshot.delayed_size = delayed_.size();
+  return snapshot;
 }
+
+#else
+
+EventQueueStats EventQueue::stats() const {
+  return {};
+}
+
+#endif
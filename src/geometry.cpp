@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cassert>
 
 #include <glm/ext/matrix_transform.hpp>
@@ -10,13 +11,15 @@
 
 #include "sunset/geometry.h"
 
-glm::mat4 calculateModelMatrix(ECS const &ecs, Entity entity) {
+glm::mat4 calculateModelMatrix(ECS const &ecs, Entity entity,
+                               float alpha) {
   glm::mat4 model_matrix = glm::mat4(1.0f);
   Entity current = entity;
   while (true) {
     const Transform *t = ecs.getComponent<Transform>(current);
-    glm::mat4 local = glm::translate(glm::mat4(1.0f), t->position);
-    local *= glm::toMat4(t->rotation);
+    glm::mat4 local =
+        glm::translate(glm::mat4(1.0f), t->interpolatedPosition(alpha));
+    local *= glm::toMat4(t->interpolatedRotation(alpha));
     local = glm::scale(local, glm::vec3(t->scale));
     model_matrix = local * model_matrix; // PRE-multiply
     if (!t->parent.has_value()) break;
@@ -87,6 +90,25 @@ bool AABB::contains(const glm::vec3 &point) const {
          point.y <= max.y && point.z >= min.z && point.z <= max.z;
 }
 
+bool AABB::contains(const AABB &other) const {
+  return other.min.x >= min.x && other.max.x <= max.x &&
+         other.min.y >= min.y && other.max.y <= max.y &&
+         other.min.z >= min.z && other.max.z <= max.z;
+}
+
+AABB AABB::merge(const AABB &other) const {
+  return {glm::min(min, other.min), glm::max(max, other.max)};
+}
+
+AABB AABB::expand(float margin) const {
+  return {min - glm::vec3(margin), max + glm::vec3(margin)};
+}
+
+float AABB::getSurfaceArea() const {
+  glm::vec3 d = max - min;
+  return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
 float AABB::getRadius() const {
   return glm::length((max - min) * (sqrtf(2) / 2));
 }
@@ -129,6 +151,67 @@ std::ostream &operator<<(std::ostream &os, const AABB &aabb) {
   return os;
 }
 
+std::optional<float> Ray::intersect(const AABB &aabb,
+                                   float max_distance) const {
+  float t_enter = 0.0f;
+  float t_exit = max_distance;
+
+  for (int axis = 0; axis < 3; axis++) {
+    if (direction[axis] == 0.0f) {
+      if (origin[axis] < aabb.min[axis] || origin[axis] > aabb.max[axis]) {
+        return std::nullopt;
+      }
+      continue;
+    }
+
+    float inv = 1.0f / direction[axis];
+    float t0 = (aabb.min[axis] - origin[axis]) * inv;
+    float t1 = (aabb.max[axis] - origin[axis]) * inv;
+    if (t0 > t1) std::swap(t0, t1);
+
+    t_enter = std::max(t_enter, t0);
+    t_exit = std::min(t_exit, t1);
+    if (t_enter > t_exit) {
+      return std::nullopt;
+    }
+  }
+
+  return t_enter;
+}
+
+Frustum Frustum::fromViewProjection(const glm::mat4 &m) {
+  auto row = [&m](int i) {
+    return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+  };
+
+  Frustum frustum{{
+      row(3) + row(0),
+      row(3) - row(0),
+      row(3) + row(1),
+      row(3) - row(1),
+      row(3) + row(2),
+      row(3) - row(2),
+  }};
+
+  for (glm::vec4 &plane : frustum.planes) {
+    plane /= glm::length(glm::vec3(plane));
+  }
+  return frustum;
+}
+
+bool Frustum::intersects(const AABB &aabb) const {
+  for (const glm::vec4 &plane : planes) {
+    // Corner furthest along the plane normal.
+    glm::vec3 corner{plane.x > 0.0f ? aabb.max.x : aabb.min.x,
+                     plane.y > 0.0f ? aabb.max.y : aabb.min.y,
+                     plane.z > 0.0f ? aabb.max.z : aabb.min.z};
+    if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) {
+      return false;
+    }
+  }
+  return true;
+}
+
 void rotateEntity(ECS &ecs, Entity e) {
   ecs.getComponent<PhysicsComponent>(e);
 }
@@ -0,0 +1,312 @@
+#include <algorithm>
+#include <cassert>
+#include <mutex>
+#include <utility>
+
+#include "sunset/thread_pool.h"
+
+#include "sunset/hash_grid.h"
+
+namespace {
+
+// Cell coordinates are packed in 21 bits each; clamping keeps far away
+// bodies in the border cells instead of aliasing them.
+constexpr int32_t kCellLimit = (1 << 20) - 1;
+
+constexpr size_t kGrain = 1024;
+
+// Above this many cells a query scans the bodies instead.
+constexpr int64_t kMaxQueryCells = 4096;
+
+glm::ivec3 unpackCell(uint64_t key) {
+  auto axis = [key](int shift) {
+    return static_cast<int32_t>((key >> shift) & 0x1FFFFF) - kCellLimit;
+  };
+  return {axis(42), axis(21), axis(0)};
+}
+
+template <typename T, typename Less>
+void parallelSort(std::vector<T> &items, Less less) {
+  ThreadPool &pool = ThreadPool::instance();
+  size_t chunks = std::min(pool.concurrency(), items.size() / kGrain + 1);
+  if (chunks <= 1) {
+    std::sort(items.begin(), items.end(), less);
+    return;
+  }
+
+  size_t chunk = (items.size() + chunks - 1) / chunks;
+  pool.parallelFor(chunks, 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      auto first = items.begin() + std::min(i * chunk, items.size());
+      auto last = items.begin() + std::min((i + 1) * chunk, items.size());
+      std::sort(first, last, less);
+    }
+  });
+
+  for (size_t width = chunk; width < items.size(); width *= 2) {
+    for (size_t i = 0; i + width < items.size(); i += 2 * width) {
+      auto middle = items.begin() + i + width;
+      auto last = items.begin() + std::min(i + 2 * width, items.size());
+      std::inplace_merge(items.begin() + i, middle, last, less);
+    }
+  }
+}
+
+} // namespace
+
+int64_t HashGrid::CellBox::count() const {
+  glm::ivec3 size = max - min + glm::ivec3(1);
+  return static_cast<int64_t>(size.x) * size.y * size.z;
+}
+
+HashGrid::HashGrid(float cell_size, float margin)
+    : cell_size_(cell_size),
+      inv_cell_size_(1.0f / cell_size),
+      margin_(margin) {
+  assert(cell_size > 0.0f);
+}
+
+HashGrid::CellBox HashGrid::cellsOf(const AABB &aabb) const {
+  glm::vec3 limit(static_cast<float>(kCellLimit));
+  auto cell = [&](const glm::vec3 &point) {
+    return glm::ivec3(
+        glm::clamp(glm::floor(point * inv_cell_size_), -limit, limit));
+  };
+  return {cell(aabb.min), cell(aabb.max)};
+}
+
+uint64_t HashGrid::cellKey(const glm::ivec3 &cell) {
+  auto axis = [](int32_t value) {
+    return static_cast<uint64_t>(value + kCellLimit) & 0x1FFFFF;
+  };
+  return (axis(cell.x) << 42) | (axis(cell.y) << 21) | axis(cell.z);
+}
+
+void HashGrid::insert(Entity entity, const AABB &aabb) {
+  assert(!index_.contains(entity));
+
+  uint32_t body = static_cast<uint32_t>(bodies_.size());
+  bodies_.push_back({aabb, aabb.expand(margin_), entity, true, false});
+  index_[entity] = body;
+  moveToSide(body);
+}
+
+void HashGrid::remove(Entity entity) {
+  uint32_t *body = index_.find(entity);
+  if (!body) {
+    return;
+  }
+
+  bodies_[*body].live = false;
+  index_.erase(entity);
+}
+
+void HashGrid::update(Entity entity, const AABB &aabb) {
+  uint32_t *found = index_.find(entity);
+  if (!found) {
+    insert(entity, aabb);
+    return;
+  }
+
+  uint32_t body = *found;
+  bodies_[body].aabb = aabb;
+  if (!bodies_[body].fat.contains(aabb)) {
+    moveToSide(body);
+  }
+}
+
+void HashGrid::moveToSide(uint32_t body) {
+  if (!bodies_[body].side) {
+    bodies_[body].side = true;
+    side_.push_back(body);
+  }
+}
+
+void HashGrid::entities(std::vector<Entity> &out) const {
+  out.reserve(out.size() + index_.size());
+  for (const Body &body : bodies_) {
+    if (body.live) out.push_back(body.entity);
+  }
+}
+
+void HashGrid::sync(std::span<const BroadphaseProxy> proxies) {
+  bodies_.clear();
+  bodies_.reserve(proxies.size());
+  index_.clear();
+  index_.reserve(proxies.size());
+
+  for (const BroadphaseProxy &proxy : proxies) {
+    index_[proxy.entity] = static_cast<uint32_t>(bodies_.size());
+    bodies_.push_back({proxy.aabb, proxy.aabb.expand(margin_), proxy.entity,
+                       true, false});
+  }
+
+  rebuild();
+}
+
+void HashGrid::rebuild() {
+  ThreadPool &pool = ThreadPool::instance();
+
+  // Count the cells of each body, then give each body its slice of the
+  // entry array.
+  std::vector<uint32_t> offsets(bodies_.size() + 1, 0);
+  pool.parallelFor(bodies_.size(), kGrain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      int64_t count = cellsOf(bodies_[i].fat).count();
+      if (count > kMaxCellsPerBody) {
+        bodies_[i].side = true;
+      } else {
+        offsets[i + 1] = static_cast<uint32_t>(count);
+      }
+    }
+  });
+
+  for (size_t i = 0; i < bodies_.size(); i++) {
+    offsets[i + 1] += offsets[i];
+  }
+
+  std::vector<std::pair<uint64_t, uint32_t>> entries(offsets.back());
+  pool.parallelFor(bodies_.size(), kGrain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      if (bodies_[i].side) continue;
+
+      CellBox box = cellsOf(bodies_[i].fat);
+      uint32_t out = offsets[i];
+      for (int x = box.min.x; x <= box.max.x; x++) {
+        for (int y = box.min.y; y <= box.max.y; y++) {
+          for (int z = box.min.z; z <= box.max.z; z++) {
+            entries[out++] = {cellKey({x, y, z}),
+                              static_cast<uint32_t>(i)};
+          }
+        }
+      }
+    }
+  });
+
+  parallelSort(entries, std::less<>());
+
+  cell_bodies_.resize(entries.size());
+  cells_.clear();
+  cells_.reserve(bodies_.size());
+  CellRange *range = nullptr;
+  for (size_t i = 0; i < entries.size(); i++) {
+    cell_bodies_[i] = entries[i].second;
+    if (i == 0 || entries[i].first != entries[i - 1].first) {
+      range = &cells_[entries[i].first];
+      *range = {static_cast<uint32_t>(i), 0};
+    }
+    range->count++;
+  }
+
+  side_.clear();
+  for (uint32_t i = 0; i < bodies_.size(); i++) {
+    if (bodies_[i].side) side_.push_back(i);
+  }
+}
+
+template <typename F>
+void HashGrid::forEachCandidate(const AABB &aabb, F &&fn) const {
+  CellBox query = cellsOf(aabb);
+
+  if (query.count() > kMaxQueryCells) {
+    for (uint32_t i = 0; i < bodies_.size(); i++) {
+      if (bodies_[i].live && !bodies_[i].side) fn(i);
+    }
+  } else {
+    for (int x = query.min.x; x <= query.max.x; x++) {
+      for (int y = query.min.y; y <= query.max.y; y++) {
+        for (int z = query.min.z; z <= query.max.z; z++) {
+          glm::ivec3 cell{x, y, z};
+          const CellRange *range = cells_.find(cellKey(cell));
+          if (!range) continue;
+
+          for (uint32_t k = 0; k < range->count; k++) {
+            uint32_t i = cell_bodies_[range->begin + k];
+            const Body &body = bodies_[i];
+            if (!body.live || body.side) continue;
+            // A body spanning several query cells is reported from the
+            // first cell both cover.
+            if (glm::max(cellsOf(body.fat).min, query.min) != cell) {
+              continue;
+            }
+            fn(i);
+          }
+        }
+      }
+    }
+  }
+
+  for (uint32_t i : side_) {
+    if (bodies_[i].live) fn(i);
+  }
+}
+
+void HashGrid::query(const AABB &aabb, std::vector<Entity> &out) const {
+  forEachCandidate(aabb, [&](uint32_t i) {
+    if (bodies_[i].aabb.intersects(aabb)) {
+      out.push_back(bodies_[i].entity);
+    }
+  });
+}
+
+void HashGrid::queryPairs(
+    std::vector<std::pair<Entity, Entity>> &out) const {
+  std::vector<std::pair<uint64_t, CellRange>> cells;
+  cells.reserve(cells_.size());
+  cells_.forEach([&](uint64_t key, const CellRange &range) {
+    if (range.count > 1) cells.emplace_back(key, range);
+  });
+  std::sort(cells.begin(), cells.end(),
+            [](const auto &a, const auto &b) { return a.first < b.first; });
+
+  // Chunks append in any order; sorting by chunk start keeps the output
+  // deterministic.
+  std::mutex mutex;
+  std::vector<std::pair<size_t, std::vector<std::pair<Entity, Entity>>>>
+      chunks;
+
+  ThreadPool::instance().parallelFor(
+      cells.size(), 64, [&](size_t begin, size_t end) {
+        std::vector<std::pair<Entity, Entity>> pairs;
+        for (size_t c = begin; c < end; c++) {
+          glm::ivec3 cell = unpackCell(cells[c].first);
+          const CellRange &range = cells[c].second;
+
+          for (uint32_t i = 0; i < range.count; i++) {
+            const Body &a = bodies_[cell_bodies_[range.begin + i]];
+            if (!a.live || a.side) continue;
+            glm::ivec3 a_min = cellsOf(a.fat).min;
+
+            for (uint32_t j = i + 1; j < range.count; j++) {
+              const Body &b = bodies_[cell_bodies_[range.begin + j]];
+              if (!b.live || b.side) continue;
+              if (glm::max(a_min, cellsOf(b.fat).min) != cell) continue;
+              if (!a.aabb.intersects(b.aabb)) continue;
+              pairs.push_back(std::minmax(a.entity, b.entity));
+            }
+          }
+        }
+
+        std::lock_guard guard(mutex);
+        chunks.emplace_back(begin, std::move(pairs));
+      });
+
+  std::sort(chunks.begin(), chunks.end(),
+            [](const auto &a, const auto &b) { return a.first < b.first; });
+  for (const auto &[begin, pairs] : chunks) {
+    out.insert(out.end(), pairs.begin(), pairs.end());
+  }
+
+  for (uint32_t s : side_) {
+    const Body &side = bodies_[s];
+    if (!side.live) continue;
+
+    forEachCandidate(side.aabb, [&](uint32_t i) {
+      const Body &other = bodies_[i];
+      if (i == s || !other.aabb.intersects(side.aabb)) return;
+      // Pairs of two side bodies are found from both; keep one.
+      if (other.side && other.entity < side.entity) return;
+      out.push_back(std::minmax(side.entity, other.entity));
+    });
+  }
+}
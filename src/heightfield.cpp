@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+#include <absl/strings/str_format.h>
+
+#include "sunset/heightfield.h"
+
+namespace {
+
+constexpr float kInfinity = std::numeric_limits<float>::infinity();
+
+// Calls `f` with `lo`, every grid line strictly between `lo` and `hi`,
+// and `hi`.
+template <typename F>
+void forEachLine(float lo, float hi, F &&f) {
+  f(lo);
+  for (float line = std::floor(lo) + 1.0f; line < hi; line++) {
+    f(line);
+  }
+  if (hi > lo) f(hi);
+}
+
+} // namespace
+
+Heightfield::Heightfield(glm::vec3 origin, float cell_size,
+                         int32_t columns, std::vector<float> heights)
+    : origin_(origin),
+      cell_size_(cell_size),
+      columns_(columns),
+      rows_(static_cast<int32_t>(heights.size() / columns)),
+      heights_(std::move(heights)) {
+  assert(columns_ >= 2 && rows_ >= 2 && cell_size_ > 0.0f);
+  assert(heights_.size() == static_cast<size_t>(columns_) * rows_);
+
+  auto [low, high] = std::minmax_element(heights_.begin(), heights_.end());
+  bounds_ = {{origin_.x, origin_.y + *low, origin_.z},
+             {origin_.x + (columns_ - 1) * cell_size_, origin_.y + *high,
+              origin_.z + (rows_ - 1) * cell_size_}};
+}
+
+float Heightfield::heightAtGrid(float gx, float gz) const {
+  int32_t x = std::min(static_cast<int32_t>(gx), columns_ - 2);
+  int32_t z = std::min(static_cast<int32_t>(gz), rows_ - 2);
+  float u = gx - x;
+  float v = gz - z;
+  float h00 = sample(x, z);
+  float h10 = sample(x + 1, z);
+  float h01 = sample(x, z + 1);
+  float h11 = sample(x + 1, z + 1);
+  return h00 + (h10 - h00) * u + (h01 - h00) * v +
+         (h00 - h10 - h01 + h11) * u * v;
+}
+
+std::optional<float> Heightfield::heightAt(float x, float z) const {
+  if (empty()) return std::nullopt;
+  float gx = (x - origin_.x) / cell_size_;
+  float gz = (z - origin_.z) / cell_size_;
+  if (!(gx >= 0.0f && gx <= columns_ - 1 && gz >= 0.0f &&
+        gz <= rows_ - 1)) {
+    return std::nullopt;
+  }
+  return heightAtGrid(gx, gz);
+}
+
+std::optional<float> Heightfield::maxHeight(const AABB &aabb) const {
+  if (empty()) return std::nullopt;
+  float x0 = (aabb.min.x - origin_.x) / cell_size_;
+  float x1 = (aabb.max.x - origin_.x) / cell_size_;
+  float z0 = (aabb.min.z - origin_.z) / cell_size_;
+  float z1 = (aabb.max.z - origin_.z) / cell_size_;
+  if (x1 < 0.0f || x0 > columns_ - 1 || z1 < 0.0f || z0 > rows_ - 1) {
+    return std::nullopt;
+  }
+  x0 = std::max(x0, 0.0f);
+  x1 = std::min<float>(x1, columns_ - 1);
+  z0 = std::max(z0, 0.0f);
+  z1 = std::min<float>(z1, rows_ - 1);
+
+  // Along a grid line the surface is linear and within a cell it has no
+  // peak, so the highest point is at a crossing of the footprint's edges
+  // and the grid lines, or at a sample inside it.
+  float highest = -kInfinity;
+  forEachLine(x0, x1, [&](float gx) {
+    forEachLine(z0, z1, [&](float gz) {
+      highest = std::max(highest, heightAtGrid(gx, gz));
+    });
+  });
+  return highest;
+}
+
+glm::vec3 Heightfield::normalAt(float x, float z) const {
+  if (empty()) return {0.0f, 1.0f, 0.0f};
+  float gx = std::clamp((x - origin_.x) / cell_size_, 0.0f,
+                        static_cast<float>(columns_ - 1));
+  float gz = std::clamp((z - origin_.z) / cell_size_, 0.0f,
+                        static_cast<float>(rows_ - 1));
+  int32_t cx = std::min(static_cast<int32_t>(gx), columns_ - 2);
+  int32_t cz = std::min(static_cast<int32_t>(gz), rows_ - 2);
+  float u = gx - cx;
+  float v = gz - cz;
+
+  float h00 = sample(cx, cz);
+  float h10 = sample(cx + 1, cz);
+  float h01 = sample(cx, cz + 1);
+  float h11 = sample(cx + 1, cz + 1);
+  float twist = h00 - h10 - h01 + h11;
+  float slope_x = (h10 - h00 + twist * v) / cell_size_;
+  float slope_z = (h01 - h00 + twist * u) / cell_size_;
+  return glm::normalize(glm::vec3(-slope_x, 1.0f, -slope_z));
+}
+
+std::optional<float> Heightfield::raycast(const Ray &ray,
+                                          float max_distance) const {
+  if (empty()) return std::nullopt;
+  // The solid part reaches all the way down.
+  AABB solid{{bounds_.min.x, -kInfinity, bounds_.min.z}, bounds_.max};
+  std::optional<float> enter = ray.intersect(solid, max_distance);
+  if (!enter) return std::nullopt;
+
+  float exit = max_distance;
+  for (int axis = 0; axis < 3; axis++) {
+    if (ray.direction[axis] == 0.0f) continue;
+    float t0 = (solid.min[axis] - ray.origin[axis]) / ray.direction[axis];
+    float t1 = (solid.max[axis] - ray.origin[axis]) / ray.direction[axis];
+    exit = std::min(exit, std::max(t0, t1));
+  }
+
+  // Walk the cells under the ray in grid coordinates, solving the
+  // bilinear patch of each for the first point below the surface.
+  glm::vec3 entry = ray.at(*enter);
+  glm::vec2 start{(entry.x - origin_.x) / cell_size_,
+                  (entry.z - origin_.z) / cell_size_};
+  glm::vec2 step{ray.direction.x / cell_size_,
+                 ray.direction.z / cell_size_};
+  int32_t x = std::clamp(static_cast<int32_t>(std::floor(start.x)), 0,
+                         columns_ - 2);
+  int32_t z = std::clamp(static_cast<int32_t>(std::floor(start.y)), 0,
+                         rows_ - 2);
+
+  auto crossing = [&](float from, float delta, int32_t cell) {
+    if (delta == 0.0f) return kInfinity;
+    float line = delta > 0.0f ? cell + 1.0f : static_cast<float>(cell);
+    return *enter + (line - from) / delta;
+  };
+  float next_x = crossing(start.x, step.x, x);
+  float next_z = crossing(start.y, step.y, z);
+
+  float t = *enter;
+  while (true) {
+    float end = std::min({next_x, next_z, exit});
+
+    glm::vec3 from = ray.at(t);
+    float u = (from.x - origin_.x) / cell_size_ - x;
+    float v = (from.z - origin_.z) / cell_size_ - z;
+    float h00 = sample(x, z);
+    float h10 = sample(x + 1, z);
+    float h01 = sample(x, z + 1);
+    float h11 = sample(x + 1, z + 1);
+    float twist = h00 - h10 - h01 + h11;
+
+    // Height above the surface after travelling s further, as
+    // c0 + c1 * s + c2 * s^2.
+    float c0 = from.y - (h00 + (h10 - h00) * u + (h01 - h00) * v +
+                         twist * u * v);
+    float c1 = ray.direction.y -
+               ((h10 - h00) * step.x + (h01 - h00) * step.y +
+                twist * (u * step.y + v * step.x));
+    float c2 = -twist * step.x * step.y;
+    if (c0 <= 0.0f) return t;
+
+    float length = end - t;
+    float s = kInfinity;
+    if (c2 == 0.0f) {
+      if (c1 < 0.0f) s = -c0 / c1;
+    } else {
+      float discriminant = c1 * c1 - 4.0f * c2 * c0;
+      if (discriminant >= 0.0f) {
+        // Cancellation-free form; the patches are often nearly flat.
+        float q = -0.5f * (c1 + std::copysign(std::sqrt(discriminant), c1));
+        float a = q / c2;
+        float b = q != 0.0f ? c0 / q : kInfinity;
+        if (a > b) std::swap(a, b);
+        s = a >= 0.0f ? a : b >= 0.0f ? b : kInfinity;
+      }
+    }
+    if (s <= length) return t + s;
+
+    if (end >= exit) return std::nullopt;
+    if (next_x < next_z) {
+      x += step.x > 0.0f ? 1 : -1;
+      t = next_x;
+      next_x += 1.0f / std::abs(step.x);
+    } else {
+      z += step.y > 0.0f ? 1 : -1;
+      t = next_z;
+      next_z += 1.0f / std::abs(step.y);
+    }
+    if (x < 0 || x > columns_ - 2 || z < 0 || z > rows_ - 2) {
+      return std::nullopt;
+    }
+  }
+}
+
+std::optional<PropertyTree> Heightfield::serialize() const {
+  return PropertyTree{"Heightfield",
+                      {std::vector<float>{origin_.x, origin_.y, origin_.z},
+                       cell_size_, columns_, heights_}};
+}
+
+absl::StatusOr<Heightfield> Heightfield::deserialize(
+    PropertyTree const &tree) {
+  if (tree.properties.size() < 4) {
+    return absl::InvalidArgumentError("Invalid heightfield");
+  }
+  auto origin =
+      TRY(extractProperty<std::vector<float>>(tree.properties[0]));
+  float cell_size = TRY(extractProperty<float>(tree.properties[1]));
+  // tools/ptasm.py writes small integers as int16.
+  int32_t columns;
+  if (auto narrow = extractProperty<int16_t>(tree.properties[2]);
+      narrow.ok()) {
+    columns = *narrow;
+  } else {
+    columns = TRY(extractProperty<int32_t>(tree.properties[2]));
+  }
+  auto heights =
+      TRY(extractProperty<std::vector<float>>(tree.properties[3]));
+
+  if (origin.size() != 3 || !(cell_size > 0.0f)) {
+    return absl::InvalidArgumentError("Invalid heightfield origin or cell");
+  }
+  if (columns < 2 || heights.size() % columns != 0 ||
+      heights.size() / columns < 2) {
+    return absl::InvalidArgumentError(absl::StrFormat(
+        "Heightfield needs a grid of at least 2x2, got %d heights in %d "
+        "columns",
+        heights.size(), columns));
+  }
+  return Heightfield({origin[0], origin[1], origin[2]}, cell_size, columns,
+                     std::move(heights));
+}
@@ -1,4 +1,5 @@
 #include <cassert>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 
@@ -6,6 +7,8 @@
 #include <absl/log/initialize.h>
 #include <absl/log/log_entry.h>
 #include <absl/log/globals.h>
+#include <absl/time/clock.h>
+#include <absl/time/time.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
@@ -18,11 +21,18 @@
 #include "sunset/drm.h"
 #include "sunset/globals.h"
 #include "sunset/physics.h"
+#include "sunset/projectiles.h"
 #include "sunset/property_tree.h"
 #include "sunset/utils.h"
 #include "sunset/rendering.h"
+#include "sunset/timestep.h"
 #include "sunset/opengl_backend.h"
 #include "sunset/glfw_provider.h"
+#include "sunset/replay_provider.h"
+#include "sunset/state_hash.h"
+
+// Bullets in flight at once; more are dropped.
+constexpr size_t kMaxProjectiles = 1 << 16;
 
 struct Tick {
   size_t seq;
@@ -91,22 +101,6 @@ Mesh createExampleMesh() {
   return mesh;
 }
 
-struct DamageComponent {
-  float amount;
-  bool used;
-
-  std::optional<PropertyTree> serialize() const {
-    // TODO:
-    PropertyTree tree = {"DamageComponent"};
-    return tree;
-  }
-
-  static absl::StatusOr<DamageComponent> deserialize(
-      PropertyTree const & /* tree */) {
-    return absl::InternalError("TODO");
-  }
-};
-
 struct Health {
   float amount;
   float damage_mult = 1.0;
@@ -139,12 +133,47 @@ class ScoreSystem {
 int main(int argc, char **argv) {
   kCurrentExec::set(argv[0]);
 
+  // --record <file> logs the input of this session, --replay <file> runs a
+  // logged session headless (no window, no rendering). --fps <n> caps the
+  // frame rate (0, the default, leaves it uncapped). --bake-static <file>
+  // writes the scene with its static collider BVH baked in and exits.
+  // --record-hashes <file> logs a hash of the physics state after every
+  // step; --verify-hashes <file> checks a run, normally a replay of the
+  // same input, against such a log and stops at the first divergence.
+  std::optional<std::string> record_path;
+  std::optional<std::string> replay_path;
+  std::optional<std::string> bake_path;
+  std::optional<std::string> record_hashes_path;
+  std::optional<std::string> verify_hashes_path;
+  int max_fps = 0;
+  for (int i = 1; i + 1 < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg == "--record") {
+      record_path = argv[++i];
+    } else if (arg == "--replay") {
+      replay_path = argv[++i];
+    } else if (arg == "--fps") {
+      max_fps = std::max(std::atoi(argv[++i]), 0);
+    } else if (arg == "--bake-static") {
+      bake_path = argv[++i];
+    } else if (arg == "--record-hashes") {
+      record_hashes_path = argv[++i];
+    } else if (arg == "--verify-hashes") {
+      verify_hashes_path = argv[++i];
+    }
+  }
+  bool headless = replay_path.has_value() || bake_path.has_value();
+  // Logs are replayed one frame per poll, so recorded and replayed
+  // sessions step the simulation once per frame instead of by wall time.
+  bool lockstep = record_path.has_value() || replay_path.has_value();
+
   absl::InitializeLog();
   absl::SetStderrThreshold(absl::LogSeverityAtLeast::kInfo);
 
   // HACK:
   ComponentRegistry::instance().registerType<MeshRef>();
   ComponentRegistry::instance().registerType<TextureRef>();
+  ComponentRegistry::instance().registerType<TerrainComponent>();
 
   std::ifstream file("world.pt", std::ios::binary);
   absl::StatusOr<PropertyTree> tree = readPropertyTree(file);
@@ -152,10 +181,30 @@ int main(int argc, char **argv) {
   assert(scene.ok());
 
   EventQueue eq;
+  // When a frame stalls, only the latest key state and the summed mouse
+  // motion are worth dispatching.
+  eq.setCoalescing<KeyPressed, CoalescePolicy::KeepLatest>();
+  eq.setCoalescing<MouseMoved, CoalescePolicy::Sum>();
+  eq.setCoalescing<MouseScrolled, CoalescePolicy::Sum>();
+  // Collision reactions run right after the physics step that raised
+  // them instead of a frame late.
+  eq.route<Collision>(EventPhase::PostPhysics);
+  eq.route<EnterCollider>(EventPhase::PostPhysics);
+  eq.route<ExitCollider>(EventPhase::PostPhysics);
 
   ECS ecs;
 
-  std::unique_ptr<IOProvider> io_provider = std::make_unique<GLFWIO>(eq);
+  std::unique_ptr<IOProvider> io_provider;
+  if (replay_path.has_value()) {
+    io_provider = std::make_unique<ReplayIO>(*replay_path);
+  } else {
+    io_provider = std::make_unique<GLFWIO>(eq);
+  }
+
+  if (record_path.has_value()) {
+    io_provider = std::make_unique<RecordingIO>(std::move(io_provider), eq,
+                                                *record_path);
+  }
   assert(io_provider->valid());
 
   OpenGLBackend backend;
@@ -186,9 +235,13 @@ int main(int argc, char **argv) {
   //             << event.entity_b;
   // }));
 
-  RenderingSystem rendering(backend);
+  std::optional<RenderingSystem> rendering;
+  if (!headless) {
+    rendering.emplace(backend);
+    rendering->debugOverlay().showEventStats(&eq);
+  }
 
-  PhysicsSystem physics = PhysicsSystem::instance();
+  PhysicsSystem &physics = PhysicsSystem::instance();
   // physics.moveObject(ecs, entity, {0.0, 0.0, -1.0}, eq);
 
   Entity camera_entity = ecs.createEntity();
@@ -206,43 +259,88 @@ int main(int argc, char **argv) {
               {0.0, 1.0, 0.0}),
           .collision_source = camera_entity,
       },
-      Player{.speed = 0.01, .sensitivity = 0.005}));
+      Player{.speed = 0.01, .sensitivity = 0.005}, MovementIntent{}));
 
   PlayerController controller(ecs, eq);
 
-  eq.subscribe(std::function([&](const MouseDown &event) {
-    Entity bullet = ecs.createEntity();
+  // Bullets live in the projectile pool rather than the ECS.
+  ProjectileSystem projectiles(kMaxProjectiles);
+  eq.route<ProjectileHit>(EventPhase::PostPhysics);
 
+  eq.subscribe(std::function([&](const MouseDown &event) {
     Transform *camera_transform =
         ecs.getComponent<Transform>(camera_entity);
 
     glm::vec3 forward = glm::normalize(
         glm::vec3(camera_transform->rotation * glm::vec4(0, 0, -1, 0.0f)));
 
-    Transform bullet_transform{
-        .position = camera_transform->position + forward,
-        .rotation = camera_transform->rotation, .scale = 2.0};
-
-    unused(ecs.addComponents(
-        bullet, bullet_transform,
-        PhysicsComponent{
+    if (!projectiles.spawn(Projectile{
+            .position = camera_transform->position + forward,
             .velocity = forward * 0.5f,
             .acceleration = {0.0, -0.003, 0.0},
-            .type = PhysicsComponent::Type::Regular,
-            .material = {},
-            .collider =
-                AABB{{-0.05f, -0.05f, -0.05f},
-                     {0.05f, 0.05f, 0.05f}}
-                    .translate(camera_transform->position + forward),
-        },
-        MeshRef(RRef("Global", 3)), TextureRef(RRef("Global", 4)),
-        DamageComponent{4.0}));
-
-    LOG(INFO) << "Bullet spawned!";
+            .damage = 4.0f,
+        })) {
+      LOG(WARNING) << "Too many projectiles, bullet dropped";
+    }
+  }));
+
+  eq.subscribe(std::function([&](const ProjectileHit &hit) {
+    if (Health *health = ecs.getComponent<Health>(hit.entity)) {
+      health->amount -= hit.damage * health->damage_mult;
+    }
   }));
 
   loadSceneToECS(ecs, *scene, backend);
 
+  if (rendering) {
+    TextureRef bullet_texture(RRef("Global", 4));
+    absl::StatusOr<MeshRenderable> bullet_mesh = compileMeshRef(
+        backend, MeshRef(RRef("Global", 3)), &bullet_texture);
+    if (bullet_mesh.ok()) {
+      rendering->showProjectiles(backend, projectiles, *bullet_mesh, 2.0f);
+    } else {
+      LOG(WARNING) << "Bullets won't be drawn: " << bullet_mesh.status();
+    }
+  }
+
+  if (const PropertyTree *settings_tree =
+          tree->getNodeByName("PhysicsSettings")) {
+    absl::StatusOr<PhysicsSettings> settings =
+        deserializeTree<PhysicsSettings>(*settings_tree);
+    if (settings.ok()) {
+      physics.configure(*settings);
+    } else {
+      LOG(WARNING) << "Invalid physics settings: " << settings.status();
+    }
+  }
+
+  if (const PropertyTree *bvh_tree = tree->getNodeByName("StaticBVH")) {
+    absl::StatusOr<StaticBVH> bvh = StaticBVH::deserialize(*bvh_tree);
+    if (bvh.ok()) {
+      physics.setStaticBVH(*std::move(bvh));
+    } else {
+      LOG(WARNING) << "Invalid static BVH, rebuilding: " << bvh.status();
+    }
+  }
+
+  if (bake_path.has_value()) {
+    physics.bakeStatic(ecs);
+    std::erase_if(tree->children, [](const PropertyTree &child) {
+      return child.name == "StaticBVH";
+    });
+    tree->children.push_back(*physics.staticBVH().serialize());
+
+    std::ofstream out(*bake_path, std::ios::binary);
+    absl::Status written = writePropertyTree(out, *tree);
+    if (!written.ok()) {
+      LOG(ERROR) << "Failed to write " << *bake_path << ": " << written;
+      return 1;
+    }
+    LOG(INFO) << "Baked " << physics.staticBVH().size()
+              << " static colliders into " << *bake_path;
+    return 0;
+  }
+
   ScoreSystem score_system(ecs, eq);
 
   // absl::Status drm = validateLicense("LICENSE");
@@ -251,16 +349,77 @@ int main(int argc, char **argv) {
   //   return 1;
   // }
 
+  std::optional<StateHashRecorder> hash_recorder;
+  if (record_hashes_path.has_value()) {
+    hash_recorder.emplace(*record_hashes_path);
+    if (!hash_recorder->valid()) {
+      LOG(ERROR) << "Failed to open " << *record_hashes_path;
+      return 1;
+    }
+  }
+  std::optional<StateHashVerifier> hash_verifier;
+  if (verify_hashes_path.has_value()) {
+    hash_verifier.emplace(*verify_hashes_path);
+    if (!hash_verifier->valid()) return 1;
+  }
+
+  FixedTimestep timestep(physics.step(), physics.maxSubsteps());
+  absl::Duration frame_budget =
+      max_fps > 0 ? absl::Seconds(1) / max_fps : absl::ZeroDuration();
+  absl::Time last_frame = absl::Now();
+
   bool running = true;
   while (running) {
-    compileScene(ecs, backend);
-    rendering.update(ecs, commands, true);
-    backend.interpret(commands);
-    commands.clear();
-    physics.update(ecs, eq, 0.166);
+    absl::Time frame_start = absl::Now();
+    float elapsed = static_cast<float>(
+        absl::ToDoubleSeconds(frame_start - last_frame));
+    last_frame = frame_start;
+    int steps = lockstep ? 1 : timestep.advance(elapsed);
+
+    for (int i = 0; i < steps; i++) {
+      physics.update(ecs, eq, timestep.step());
+      projectiles.update(ecs, physics, eq, timestep.step());
+      eq.process(EventPhase::PostPhysics);
+
+      if (hash_recorder || hash_verifier) {
+        StateHash state = hashPhysicsState(ecs);
+        if (hash_recorder) hash_recorder->record(state);
+        if (hash_verifier) {
+          if (std::optional<Divergence> divergence =
+                  hash_verifier->verify(state)) {
+            LOG(ERROR) << "Physics state diverged at tick "
+                       << divergence->tick << ", entity "
+                       << (divergence->entity
+                               ? std::to_string(*divergence->entity)
+                               : "unknown");
+            return 1;
+          }
+        }
+      }
+    }
+
+    if (!headless) {
+      compileScene(ecs, backend);
+      eq.process(EventPhase::PreRender);
+      rendering->setInterpolation(lockstep ? 1.0f : timestep.alpha());
+      rendering->update(ecs, commands, true);
+      backend.interpret(commands);
+      commands.clear();
+    }
     running = io_provider->poll(eq);
 
     eq.process();
+
+    if (frame_budget > absl::ZeroDuration()) {
+      absl::SleepFor(frame_budget - (absl::Now() - frame_start));
+    }
+  }
+
+  if (hash_verifier) {
+    if (!hash_verifier->valid()) return 1;
+    LOG(INFO) << "Physics state matched for " << hash_verifier->ticks()
+              << " ticks"
+              << (hash_verifier->exhausted() ? "" : ", log not finished");
   }
 
   return 0;
@@ -0,0 +1,359 @@
+#include <algorithm>
+#include <cassert>
+
+#include "sunset/octree.h"
+
+namespace {
+
+size_t childIndex(const glm::ivec3 &coords) {
+  return (coords.x & 1) | ((coords.y & 1) << 1) | ((coords.z & 1) << 2);
+}
+
+} // namespace
+
+OcTree<LooseEntities>::OcTree(const AABB &bounds, size_t max_depth)
+    : max_depth_(std::min(max_depth, kMaxDepthLimit)) {
+  glm::vec3 size = bounds.max - bounds.min;
+  edge_ = std::max({size.x, size.y, size.z});
+  assert(edge_ > 0.0f);
+  bounds_ = {bounds.min, bounds.min + glm::vec3(edge_)};
+  for (size_t depth = 0; depth < edges_.size(); depth++) {
+    edges_[depth] = edge_ / static_cast<float>(1u << depth);
+  }
+
+  Node root{.cell = bounds_, .coords = glm::ivec3(0), .depth = 0};
+  root.children.fill(kNull);
+  nodes_.push_back(std::move(root));
+  node_lookup_[nodeKey(0, glm::ivec3(0))] = 0;
+}
+
+uint64_t OcTree<LooseEntities>::nodeKey(uint32_t depth,
+                                        const glm::ivec3 &coords) {
+  return (static_cast<uint64_t>(depth) << 48) |
+         (static_cast<uint64_t>(coords.x) << 32) |
+         (static_cast<uint64_t>(coords.y) << 16) |
+         static_cast<uint64_t>(coords.z);
+}
+
+AABB OcTree<LooseEntities>::looseBounds(const Node &node) const {
+  return node.cell.expand(edges_[node.depth] * 0.5f);
+}
+
+OcTree<LooseEntities>::Placement OcTree<LooseEntities>::place(
+    const AABB &aabb) const {
+  glm::vec3 center = aabb.getCenter();
+  if (!bounds_.contains(center)) {
+    return {0, glm::ivec3(0)};
+  }
+
+  // Deepest level whose cells are at least as large as the box, so the
+  // box fits in the loose bounds of the cell holding its center.
+  glm::vec3 size = aabb.max - aabb.min;
+  float extent = std::max({size.x, size.y, size.z});
+  uint32_t depth = 0;
+  float edge = edge_;
+  while (depth < max_depth_ && edge * 0.5f >= extent) {
+    edge *= 0.5f;
+    depth++;
+  }
+
+  int32_t last = static_cast<int32_t>((1u << depth) - 1);
+  glm::ivec3 coords(glm::floor((center - bounds_.min) / edge));
+  coords = glm::clamp(coords, glm::ivec3(0), glm::ivec3(last));
+  return {depth, coords};
+}
+
+int32_t OcTree<LooseEntities>::findOrCreateNode(
+    const Placement &placement) {
+  uint64_t key = nodeKey(placement.depth, placement.coords);
+  if (const int32_t *found = node_lookup_.find(key)) {
+    return *found;
+  }
+
+  // Depth 0 always exists, so this stops at the root.
+  int32_t parent = findOrCreateNode(
+      {placement.depth - 1,
+       glm::ivec3(placement.coords.x >> 1, placement.coords.y >> 1,
+                  placement.coords.z >> 1)});
+
+  int32_t index;
+  if (free_nodes_.empty()) {
+    index = static_cast<int32_t>(nodes_.size());
+    nodes_.emplace_back();
+  } else {
+    index = free_nodes_.back();
+    free_nodes_.pop_back();
+  }
+
+  float edge = edges_[placement.depth];
+  glm::vec3 min = bounds_.min + glm::vec3(placement.coords) * edge;
+
+  Node &node = nodes_[index];
+  node.cell = {min, min + glm::vec3(edge)};
+  node.coords = placement.coords;
+  node.depth = placement.depth;
+  node.parent = parent;
+  node.children.fill(kNull);
+  node.items.clear();
+  node.count = 0;
+
+  nodes_[parent].children[childIndex(placement.coords)] = index;
+  node_lookup_[key] = index;
+  return index;
+}
+
+void OcTree<LooseEntities>::attach(uint32_t item, int32_t node) {
+  items_[item].node = node;
+  items_[item].slot = static_cast<uint32_t>(nodes_[node].items.size());
+  nodes_[node].items.push_back(item);
+  level_items_[nodes_[node].depth]++;
+
+  for (int32_t n = node; n != kNull; n = nodes_[n].parent) {
+    nodes_[n].count++;
+  }
+}
+
+void OcTree<LooseEntities>::detach(uint32_t item) {
+  int32_t node = items_[item].node;
+  std::vector<uint32_t> &items = nodes_[node].items;
+
+  uint32_t slot = items_[item].slot;
+  items[slot] = items.back();
+  items_[items[slot]].slot = slot;
+  items.pop_back();
+  items_[item].node = kNull;
+  level_items_[nodes_[node].depth]--;
+
+  // A node reaching zero has no live children left, as each was freed
+  // when it emptied.
+  for (int32_t n = node; n != kNull;) {
+    Node &current = nodes_[n];
+    int32_t parent = current.parent;
+    if (--current.count == 0 && n != 0) {
+      nodes_[parent].children[childIndex(current.coords)] = kNull;
+      node_lookup_.erase(nodeKey(current.depth, current.coords));
+      free_nodes_.push_back(n);
+    }
+    n = parent;
+  }
+}
+
+void OcTree<LooseEntities>::insert(Entity entity, const AABB &aabb) {
+  assert(!lookup_.contains(entity));
+
+  uint32_t item;
+  if (free_items_.empty()) {
+    item = static_cast<uint32_t>(items_.size());
+    items_.emplace_back();
+  } else {
+    item = free_items_.back();
+    free_items_.pop_back();
+  }
+
+  items_[item] = {aabb, entity, kNull, 0};
+  lookup_[entity] = item;
+  attach(item, findOrCreateNode(place(aabb)));
+}
+
+void OcTree<LooseEntities>::remove(Entity entity) {
+  const uint32_t *found = lookup_.find(entity);
+  if (!found) {
+    return;
+  }
+
+  uint32_t item = *found;
+  detach(item);
+  free_items_.push_back(item);
+  lookup_.erase(entity);
+}
+
+void OcTree<LooseEntities>::update(Entity entity, const AABB &aabb) {
+  move(entity, aabb);
+}
+
+void OcTree<LooseEntities>::move(Entity entity, const AABB &aabb) {
+  const uint32_t *found = lookup_.find(entity);
+  if (!found) {
+    insert(entity, aabb);
+    return;
+  }
+
+  uint32_t item = *found;
+  items_[item].aabb = aabb;
+
+  Placement placement = place(aabb);
+  const Node &node = nodes_[items_[item].node];
+  if (node.depth == placement.depth && node.coords == placement.coords) {
+    return;
+  }
+
+  detach(item);
+  attach(item, findOrCreateNode(placement));
+}
+
+void OcTree<LooseEntities>::entities(std::vector<Entity> &out) const {
+  out.reserve(out.size() + lookup_.size());
+  lookup_.forEach(
+      [&](Entity entity, uint32_t /* item */) { out.push_back(entity); });
+}
+
+template <typename Accept, typename Visit>
+void OcTree<LooseEntities>::traverse(std::span<const int32_t> roots,
+                                     Accept &&accept,
+                                     Visit &&visit) const {
+  std::array<int32_t, 32 + 8 * kMaxDepthLimit> stack;
+  assert(roots.size() <= 32);
+  size_t top = 0;
+  for (int32_t root : roots) {
+    stack[top++] = root;
+  }
+
+  while (top > 0) {
+    const Node &node = nodes_[stack[--top]];
+    visit(node);
+
+    for (int32_t child : node.children) {
+      if (child != kNull && accept(looseBounds(nodes_[child]))) {
+        stack[top++] = child;
+      }
+    }
+  }
+}
+
+void OcTree<LooseEntities>::query(const AABB &aabb,
+                                  std::vector<Entity> &out) const {
+  auto visit = [&](const Node &node) {
+    for (uint32_t item : node.items) {
+      if (items_[item].aabb.intersects(aabb)) {
+        out.push_back(items_[item].entity);
+      }
+    }
+  };
+
+  // The root also holds the boxes outside the bounds; always visit it.
+  visit(nodes_[0]);
+
+  // Down to the depth the query box itself would be stored at, it overlaps
+  // at most 3x3x3 loose cells per level, so those are looked up directly
+  // and the tree is only walked below that depth.
+  uint32_t direct_depth = std::max<uint32_t>(place(aabb).depth, 1);
+  std::array<int32_t, 27> found;
+  size_t found_count = 0;
+
+  for (uint32_t depth = 1; depth <= direct_depth; depth++) {
+    // Levels without boxes only matter as the roots of the walk below.
+    bool last_level = depth == direct_depth;
+    if (level_items_[depth] == 0) {
+      if (!last_level) continue;
+      if (depth == max_depth_) return;
+    }
+
+    float edge = edges_[depth];
+    int32_t last = static_cast<int32_t>((1u << depth) - 1);
+    auto cell = [&](const glm::vec3 &point) {
+      glm::ivec3 coords(glm::floor((point - bounds_.min) / edge));
+      return glm::clamp(coords, glm::ivec3(0), glm::ivec3(last));
+    };
+    glm::ivec3 min = cell(aabb.min - glm::vec3(edge * 0.5f));
+    glm::ivec3 max = cell(aabb.max + glm::vec3(edge * 0.5f));
+
+    found_count = 0;
+    for (int x = min.x; x <= max.x; x++) {
+      for (int y = min.y; y <= max.y; y++) {
+        for (int z = min.z; z <= max.z; z++) {
+          const int32_t *node =
+              node_lookup_.find(nodeKey(depth, {x, y, z}));
+          if (!node || !looseBounds(nodes_[*node]).intersects(aabb)) {
+            continue;
+          }
+          assert(found_count < found.size());
+          found[found_count++] = *node;
+        }
+      }
+    }
+
+    // Deeper nodes lie inside the loose bounds of their parents.
+    if (found_count == 0) {
+      return;
+    }
+    if (!last_level) {
+      for (size_t i = 0; i < found_count; i++) {
+        visit(nodes_[found[i]]);
+      }
+    }
+  }
+
+  traverse(std::span<const int32_t>(found.data(), found_count),
+           [&](const AABB &loose) { return loose.intersects(aabb); },
+           visit);
+}
+
+void OcTree<LooseEntities>::queryPairs(
+    std::vector<std::pair<Entity, Entity>> &out) const {
+  std::vector<Entity> candidates;
+  for (const Node &node : nodes_) {
+    for (uint32_t item : node.items) {
+      const Item &a = items_[item];
+      candidates.clear();
+      query(a.aabb, candidates);
+      for (Entity other : candidates) {
+        if (a.entity < other) out.emplace_back(a.entity, other);
+      }
+    }
+  }
+}
+
+void OcTree<LooseEntities>::queryFrustum(const Frustum &frustum,
+                                         std::vector<Entity> &out) const {
+  const int32_t root = 0;
+  traverse(
+      std::span(&root, 1),
+      [&](const AABB &loose) { return frustum.intersects(loose); },
+      [&](const Node &node) {
+        for (uint32_t item : node.items) {
+          if (frustum.intersects(items_[item].aabb)) {
+            out.push_back(items_[item].entity);
+          }
+        }
+      });
+}
+
+void OcTree<LooseEntities>::queryRay(const Ray &ray, float max_distance,
+                                     std::vector<Entity> &out) const {
+  const int32_t root = 0;
+  traverse(
+      std::span(&root, 1),
+      [&](const AABB &loose) {
+        return ray.intersect(loose, max_distance).has_value();
+      },
+      [&](const Node &node) {
+        for (uint32_t item : node.items) {
+          if (ray.intersect(items_[item].aabb, max_distance)) {
+            out.push_back(items_[item].entity);
+          }
+        }
+      });
+}
+
+void OcTree<LooseEntities>::raycast(const Ray &ray, float max_distance,
+                                    std::vector<RayHit> &out) const {
+  size_t first = out.size();
+  const int32_t root = 0;
+  traverse(
+      std::span(&root, 1),
+      [&](const AABB &loose) {
+        return ray.intersect(loose, max_distance).has_value();
+      },
+      [&](const Node &node) {
+        for (uint32_t item : node.items) {
+          std::optional<float> t =
+              ray.intersect(items_[item].aabb, max_distance);
+          if (t) out.push_back({items_[item].entity, *t});
+        }
+      });
+
+  std::sort(out.begin() + first, out.end(),
+            [](const RayHit &a, const RayHit &b) {
+              return a.distance < b.distance;
+            });
+}
@@ -176,6 +176,7 @@ void OpenGLBackend::handleCommand(const BindVertexBuffer &cmd) {
     glVertexAttribPointer(attr.location, attr.size / sizeof(float),
                           GL_FLOAT, GL_FALSE, attr.stride,
                           reinterpret_cast<void *>(intptr_t(attr.offset)));
+    glVertexAttribDivisor(attr.location, attr.divisor);
     glEnableVertexAttribArray(attr.location);
   };
 
@@ -257,8 +258,13 @@ void OpenGLBackend::handleCommand(const SetUniform &cmd) {
 }
 
 void OpenGLBackend::handleCommand(const Draw &cmd) {
-  glDrawArrays(primitiveToSys(cmd.primitive), cmd.first_vertex,
-               cmd.vertex_count);
+  GLenum primitive = primitiveToSys(cmd.primitive);
+  if (cmd.instance_count > 1) {
+    glDrawArraysInstanced(primitive, cmd.first_vertex, cmd.vertex_count,
+                          cmd.instance_count);
+  } else {
+    glDrawArrays(primitive, cmd.first_vertex, cmd.vertex_count);
+  }
 }
 
 void OpenGLBackend::handleCommand(const SetViewport &cmd) {
@@ -1,10 +1,19 @@
+#include <cassert>
+#include <cmath>
+#include <mutex>
 #include <glm/ext/scalar_constants.hpp>
 #include <glm/glm.hpp>
 #include <glm/gtx/projection.hpp>
+#include <limits>
 #include <utility>
 #include <absl/log/log.h>
 
+#include "sunset/aabb_tree.h"
+#include "sunset/hash_grid.h"
+#include "sunset/octree.h"
+#include "sunset/sweep_and_prune.h"
 #include "sunset/geometry.h"
+#include "sunset/thread_pool.h"
 
 #include "sunset/physics.h"
 
@@ -12,22 +21,20 @@ constexpr const float kVelocityEpsilon = 0.00310345;
 
 namespace {
 
-void moveHierarchialAABB(ECS &ecs, Entity e, glm::vec3 direction) {
-  PhysicsComponent *physics = ecs.getComponent<PhysicsComponent>(e);
-  Transform *transform = ecs.getComponent<Transform>(e);
-
-  physics->collider = physics->collider.translate(direction);
-
-  for (Entity e : transform->children) {
-    moveHierarchialAABB(ecs, e, direction);
-  }
-}
-
 PhysicsMaterial combineMaterials(const PhysicsMaterial &a,
                                  const PhysicsMaterial &b) noexcept {
   return {a.friction * b.friction, a.restitution * b.restitution};
 }
 
+// Velocity of a body bouncing off something that doesn't move.
+glm::vec3 bounceOffFixed(glm::vec3 velocity, glm::vec3 normal,
+                         const PhysicsMaterial &material) noexcept {
+  glm::vec3 v_normal = glm::proj(velocity, normal);
+  glm::vec3 v_tangent = velocity - v_normal;
+  return normal * glm::length(v_normal) * material.restitution +
+         v_tangent * material.friction;
+}
+
 glm::vec3 calculateMTV(const AABB &a, const AABB &b) noexcept {
   glm::vec3 overlap_min = glm::max(a.min, b.min);
   glm::vec3 overlap_max = glm::min(a.max, b.max);
@@ -47,31 +54,6 @@ glm::vec3 calculateMTV(const AABB &a, const AABB &b) noexcept {
   return mtv;
 }
 
-std::optional<glm::vec3> findIntersection(float ray_radius,
-                                          glm::vec3 origin,
-                                          glm::vec3 direction,
-                                          AABB const &aabb) {
-  AABB expanded = aabb;
-  expanded.min -= glm::vec3(ray_radius);
-  expanded.max += glm::vec3(ray_radius);
-
-  glm::vec3 inv_dir = 1.0f / (direction + glm::epsilon<float>());
-  glm::vec3 t1 = (expanded.min - origin) * inv_dir;
-  glm::vec3 t2 = (expanded.max - origin) * inv_dir;
-
-  glm::vec3 tmin = glm::min(t1, t2);
-  glm::vec3 tmax = glm::max(t1, t2);
-
-  float t_enter = std::max(std::max(tmin.x, tmin.y), tmin.z);
-  float t_exit = std::min(std::min(tmax.x, tmax.y), tmax.z);
-
-  if (t_exit < 0 || t_enter > t_exit) {
-    return std::nullopt;
-  }
-
-  return origin + direction * t_enter;
-}
-
 glm::vec3 computeAABBCollisionNormal(AABB const &aabb, glm::vec3 origin,
                                      glm::vec3 direction) {
   glm::vec3 inv_dir = 1.0f / direction;
@@ -98,8 +80,61 @@ glm::vec3 computeAABBCollisionNormal(AABB const &aabb, glm::vec3 origin,
   return normal;
 }
 
+// Outward normal of the face of `box` nearest `point`, which is inside.
+glm::vec3 contactNormal(const AABB &box, glm::vec3 point) {
+  glm::vec3 below = point - box.min;
+  glm::vec3 above = box.max - point;
+  glm::vec3 depth = glm::min(below, above);
+
+  int axis = 0;
+  if (depth.y < depth[axis]) axis = 1;
+  if (depth.z < depth[axis]) axis = 2;
+
+  glm::vec3 normal(0.0f);
+  normal[axis] = below[axis] < above[axis] ? -1.0f : 1.0f;
+  return normal;
+}
+
+// Outward normal of the face of `box` that `point`, on its surface, was
+// reached through when moving along `direction`.
+glm::vec3 entryNormal(const AABB &box, glm::vec3 point,
+                      glm::vec3 direction) {
+  glm::vec3 normal(0.0f);
+  float nearest = std::numeric_limits<float>::infinity();
+  for (int axis = 0; axis < 3; axis++) {
+    if (direction[axis] == 0.0f) continue;
+    float face = direction[axis] > 0.0f ? box.min[axis] : box.max[axis];
+    float distance = std::abs(point[axis] - face);
+    if (distance < nearest) {
+      nearest = distance;
+      normal = glm::vec3(0.0f);
+      normal[axis] = direction[axis] > 0.0f ? -1.0f : 1.0f;
+    }
+  }
+  return normal;
+}
+
 } // namespace
 
+std::unique_ptr<Broadphase> makeBroadphase(
+    const PhysicsSettings &settings) {
+  switch (settings.broadphase) {
+    case BroadphaseType::SweepAndPrune:
+      return std::make_unique<SweepAndPrune>(
+          std::clamp<int>(settings.sweep_axis, 0, 2));
+    case BroadphaseType::HashGrid:
+      return std::make_unique<HashGrid>(settings.cell_size);
+    case BroadphaseType::LooseOcTree:
+      return std::make_unique<LooseOcTree>(settings.bounds);
+    case BroadphaseType::AABBTree:
+    default:
+      return std::make_unique<DynamicAABBTree>();
+  }
+}
+
+PhysicsSystem::PhysicsSystem()
+    : broadphase_(std::make_unique<DynamicAABBTree>()) {}
+
 PhysicsSystem &PhysicsSystem::instance() {
   static PhysicsSystem instance{};
   return instance;
@@ -107,31 +142,377 @@ PhysicsSystem &PhysicsSystem::instance() {
 
 bool PhysicsSystem::moveObject(ECS &ecs, Entity entity, glm::vec3 direction,
                                EventQueue &event_queue) {
-  return moveObjectWithCollisions(ecs, entity, std::move(direction),
-                                  1.0 / 60.0,
-                                  event_queue); // the dt is weird
+  wake(ecs, entity);
+  bool collided = moveObjectWithCollisions(ecs, entity, direction, step(),
+                                           serial_context_);
+  flushMoves(serial_context_, event_queue);
+  return collided;
+}
+
+ThreadPool &PhysicsSystem::threadPool() const {
+  return thread_pool_ ? *thread_pool_ : ThreadPool::instance();
+}
+
+void PhysicsSystem::setBroadphase(std::unique_ptr<Broadphase> broadphase) {
+  assert(broadphase != nullptr);
+  broadphase_ = std::move(broadphase);
+}
+
+void PhysicsSystem::configure(const PhysicsSettings &settings) {
+  setBroadphase(makeBroadphase(settings));
+  if (settings.tick_rate > 0.0f) {
+    tick_rate_ = settings.tick_rate;
+  }
+  max_substeps_ = std::max<int>(settings.max_substeps, 1);
 }
 
 void PhysicsSystem::update(ECS &ecs, EventQueue &event_queue, float dt) {
-  applyConstraintForces(ecs, dt);
+  // Number of reference steps `dt` stands for.
+  float ticks = dt * kReferenceTickRate;
+
+  tested_pairs_ = 0;
+  bodies_.gather(ecs);
+  solveConstraints(ecs);
+  syncBroadphase();
+
+  terrains_.clear();
+  ecs.forEach(std::function([&](Entity entity, TerrainComponent *terrain) {
+    if (!terrain->heightfield.empty()) terrains_.push_back(entity);
+  }));
+
+  intents_.clear();
+  ecs.forEach(std::function([&](Entity entity, MovementIntent *intent) {
+    glm::vec3 motion = intent->displacement + intent->velocity * ticks;
+    intent->displacement = glm::vec3(0.0);
+    if (motion == glm::vec3(0.0)) return;
+    intents_[entity] = motion;
+  }));
+
+  // Velocity is zeroed on sleep, so any now is an outside push.
+  for (uint32_t body = 0; body < bodies_.size(); body++) {
+    if (bodies_.sleeping(body) && !bodies_.isStatic(body) &&
+        (bodies_.velocity(body) != glm::vec3(0.0) ||
+         intents_.contains(bodies_.entity(body)))) {
+      wake(ecs, bodies_.entity(body));
+    }
+  }
+  bodies_.integrate(ticks);
+
+  movers_.clear();
+  for (uint32_t body = 0; body < bodies_.size(); body++) {
+    if (bodies_.isStatic(body) || bodies_.sleeping(body)) continue;
+    const glm::vec3 *intent =
+        intents_.empty() ? nullptr : intents_.find(bodies_.entity(body));
+    glm::vec3 velocity = bodies_.velocity(body);
+    if (velocity == glm::vec3(0.0) && !intent) continue;
+
+    glm::vec3 direction = velocity * kMotionScale * ticks;
+    if (intent) direction += *intent;
+    movers_.push_back({bodies_.entity(body), direction});
+  }
+  bodies_.scatter(ecs);
+
+  buildIslands(ecs, kMotionScale);
+  solveIslands(ecs, event_queue, kMotionScale);
+  updateSleep(ecs, dt);
+  generateColliderEvents(event_queue);
+}
 
-  ecs.forEach(std::function([&](Entity entity, PhysicsComponent *physics,
-                                Transform *transform) {
-    if (physics->type == PhysicsComponent::Type::Static) {
-      return;
+void PhysicsSystem::wake(ECS &ecs, Entity entity) {
+  std::vector<Entity> stack{entity};
+  std::vector<Entity> touching;
+  while (!stack.empty()) {
+    Entity current = stack.back();
+    stack.pop_back();
+    PhysicsComponent *physics = ecs.getComponent<PhysicsComponent>(current);
+    // The broadphase can still hold bodies destroyed since it was synced.
+    if (!physics || !physics->sleeping) continue;
+
+    physics->sleeping = false;
+    physics->rest_time = 0.0f;
+    if (const uint32_t *body = bodies_.find(current)) {
+      bodies_.setSleeping(*body, false);
     }
 
-    physics->velocity += physics->acceleration;
-    glm::vec3 velocity_scaled = physics->velocity * dt;
+    // Boxes resting on each other touch without overlapping, so look a
+    // little beyond the collider.
+    touching.clear();
+    broadphase_->query(physics->collider.expand(kSleepMargin), touching);
+    for (Entity other : touching) {
+      const PhysicsComponent *other_physics =
+          ecs.getComponent<PhysicsComponent>(other);
+      if (other_physics && other_physics->sleeping) {
+        stack.push_back(other);
+      }
+    }
+  }
+}
 
-    if (physics->velocity == glm::vec3(0.0)) {
-      return;
+void PhysicsSystem::syncBroadphase() {
+  proxies_.clear();
+  static_proxies_.clear();
+  bool static_changed = false;
+  AABBBatch::View colliders = bodies_.colliders().view();
+  for (uint32_t body = 0; body < bodies_.size(); body++) {
+    BroadphaseProxy proxy{bodies_.entity(body), colliders.get(body)};
+    if (!bodies_.isStatic(body)) {
+      proxies_.push_back(proxy);
+      continue;
     }
+    static_proxies_.push_back(proxy);
+    const AABB *baked = static_bvh_.find(proxy.entity);
+    static_changed = static_changed || !baked ||
+                     baked->min != proxy.aabb.min ||
+                     baked->max != proxy.aabb.max;
+  }
 
-    moveObjectWithCollisions(ecs, entity, velocity_scaled, dt, event_queue);
-  }));
+  // Rebake on any change to the static set, e.g. a level streamed in or a
+  // baked tree that doesn't match the scene.
+  if (static_changed || static_proxies_.size() != static_bvh_.size()) {
+    static_bvh_ = StaticBVH(static_proxies_);
+  }
+  broadphase_->sync(proxies_);
+}
 
-  generateColliderEvents(event_queue);
+void PhysicsSystem::bakeStatic(ECS &ecs) {
+  bodies_.gather(ecs);
+  syncBroadphase();
+}
+
+void PhysicsSystem::queryColliders(const AABB &aabb,
+                                   std::vector<Entity> &out) const {
+  broadphase_->query(aabb, out);
+  static_bvh_.query(aabb, out);
+}
+
+void PhysicsSystem::buildIslands(ECS &ecs, float dt) {
+  auto pushable = [&](Entity entity) {
+    return ecs.getComponent<PhysicsComponent>(entity)->type ==
+           PhysicsComponent::Type::Regular;
+  };
+
+  // Union-find over the bodies a move may change. Movers come first and
+  // the root of a set is its smallest node, so every root is a mover.
+  FlatHashMap<Entity, uint32_t> nodes;
+  std::vector<Entity> node_entities;
+  std::vector<uint32_t> parents;
+  auto node = [&](Entity entity) {
+    auto [found, inserted] = nodes.tryEmplace(entity);
+    if (inserted) {
+      *found = static_cast<uint32_t>(parents.size());
+      parents.push_back(*found);
+      node_entities.push_back(entity);
+    }
+    return *found;
+  };
+  auto find = [&](uint32_t n) {
+    while (parents[n] != n) {
+      parents[n] = parents[parents[n]];
+      n = parents[n];
+    }
+    return n;
+  };
+  auto unite = [&](uint32_t a, uint32_t b) {
+    a = find(a);
+    b = find(b);
+    if (a != b) parents[std::max(a, b)] = std::min(a, b);
+  };
+
+  for (const Mover &mover : movers_) {
+    node(mover.entity);
+  }
+
+  // Swept boxes are queried in parallel; the contacts come back in mover
+  // order whatever the chunking.
+  std::mutex mutex;
+  std::vector<std::pair<size_t, std::vector<Contact>>> chunks;
+  threadPool().parallelFor(
+      movers_.size(), 64, [&](size_t begin, size_t end) {
+        std::vector<Contact> contacts;
+        std::vector<Entity> candidates;
+        for (size_t i = begin; i < end; i++) {
+          const Mover &mover = movers_[i];
+          Transform *transform = ecs.getComponent<Transform>(mover.entity);
+          AABB path_box = pathBox(
+              *ecs.getComponent<PhysicsComponent>(mover.entity),
+              *transform, mover.direction, dt);
+
+          candidates.clear();
+          broadphase_->query(path_box, candidates);
+          std::sort(candidates.begin(), candidates.end());
+          for (Entity other : candidates) {
+            if (other == mover.entity) continue;
+            if (!nodes.contains(other) && !pushable(other)) continue;
+            contacts.push_back({static_cast<uint32_t>(i), other});
+          }
+        }
+
+        std::lock_guard guard(mutex);
+        chunks.emplace_back(begin, std::move(contacts));
+      });
+  std::sort(chunks.begin(), chunks.end(),
+            [](const auto &a, const auto &b) { return a.first < b.first; });
+
+  contacts_.clear();
+  for (const auto &[begin, contacts] : chunks) {
+    contacts_.insert(contacts_.end(), contacts.begin(), contacts.end());
+  }
+  for (const Contact &contact : contacts_) {
+    unite(contact.mover, node(contact.other));
+    // Only pushed this step; it moves on its own from the next one.
+    wake(ecs, contact.other);
+  }
+
+  // A move also carries the colliders of the mover's children.
+  std::vector<Entity> stack;
+  for (uint32_t i = 0; i < movers_.size(); i++) {
+    stack.assign(1, movers_[i].entity);
+    while (!stack.empty()) {
+      Transform *transform = ecs.getComponent<Transform>(stack.back());
+      stack.pop_back();
+      for (Entity child : transform->children) {
+        unite(i, node(child));
+        stack.push_back(child);
+      }
+    }
+  }
+
+  // Number islands by their first mover and group the movers, keeping
+  // their original order inside each island.
+  std::vector<uint32_t> island_of_root(movers_.size(), UINT32_MAX);
+  std::vector<uint32_t> mover_islands(movers_.size());
+  island_offsets_.assign(1, 0);
+  for (uint32_t i = 0; i < movers_.size(); i++) {
+    uint32_t root = find(i);
+    if (island_of_root[root] == UINT32_MAX) {
+      island_of_root[root] = static_cast<uint32_t>(island_offsets_.size());
+      island_offsets_.push_back(0);
+    }
+    mover_islands[i] = island_of_root[root] - 1;
+    island_offsets_[island_of_root[root]]++;
+  }
+  for (size_t i = 1; i < island_offsets_.size(); i++) {
+    island_offsets_[i] += island_offsets_[i - 1];
+  }
+
+  island_movers_.resize(movers_.size());
+  std::vector<uint32_t> fill(island_offsets_.begin(),
+                             island_offsets_.end() - 1);
+  for (uint32_t i = 0; i < movers_.size(); i++) {
+    island_movers_[fill[mover_islands[i]]++] = i;
+  }
+
+  island_of_.clear();
+  island_of_.reserve(node_entities.size());
+  for (uint32_t n = 0; n < node_entities.size(); n++) {
+    island_of_[node_entities[n]] = mover_islands[find(n)];
+  }
+}
+
+void PhysicsSystem::solveIslands(ECS &ecs, EventQueue &event_queue,
+                                 float dt) {
+  size_t island_count = island_offsets_.size() - 1;
+
+  std::mutex mutex;
+  std::vector<std::pair<size_t, MoveContext>> results;
+  threadPool().parallelFor(
+      island_count, 16, [&](size_t begin, size_t end) {
+        MoveContext context;
+        for (size_t island = begin; island < end; island++) {
+          context.island = static_cast<uint32_t>(island);
+          context.island_moved = context.moved.size();
+          for (uint32_t k = island_offsets_[island];
+               k < island_offsets_[island + 1]; k++) {
+            const Mover &mover = movers_[island_movers_[k]];
+            moveObjectWithCollisions(ecs, mover.entity, mover.direction, dt,
+                                     context);
+          }
+        }
+
+        std::lock_guard guard(mutex);
+        results.emplace_back(begin, std::move(context));
+      });
+
+  // Chunks cover consecutive islands, so applying them by their first
+  // island gives the same order for any thread count.
+  std::sort(results.begin(), results.end(),
+            [](const auto &a, const auto &b) { return a.first < b.first; });
+  for (auto &[begin, context] : results) {
+    flushMoves(context, event_queue);
+  }
+}
+
+void PhysicsSystem::updateSleep(ECS &ecs, float dt) {
+  // Bodies overlapping a Collider stay awake to keep reporting it, or
+  // they would get a spurious ExitCollider.
+  FlatHashMap<Entity, bool> in_collider;
+  for (const CollisionPair &pair : new_collisions_) {
+    in_collider[pair.entity_a] = true;
+    in_collider[pair.entity_b] = true;
+  }
+
+  for (size_t island = 0; island + 1 < island_offsets_.size(); island++) {
+    bool rested = true;
+    for (uint32_t k = island_offsets_[island];
+         k < island_offsets_[island + 1]; k++) {
+      Entity entity = movers_[island_movers_[k]].entity;
+      auto *physics = ecs.getComponent<PhysicsComponent>(entity);
+      auto *transform = ecs.getComponent<Transform>(entity);
+
+      float speed =
+          glm::length(transform->position - transform->previous->position) /
+          dt;
+      if (speed < kSleepSpeed && !in_collider.contains(entity)) {
+        physics->rest_time += dt;
+      } else {
+        physics->rest_time = 0.0f;
+      }
+      rested = rested && physics->rest_time >= kSleepTime;
+    }
+
+    if (!rested) continue;
+    for (uint32_t k = island_offsets_[island];
+         k < island_offsets_[island + 1]; k++) {
+      PhysicsComponent *physics = ecs.getComponent<PhysicsComponent>(
+          movers_[island_movers_[k]].entity);
+      physics->sleeping = true;
+      physics->velocity = glm::vec3(0.0f);
+    }
+  }
+}
+
+void PhysicsSystem::flushMoves(MoveContext &context,
+                               EventQueue &event_queue) {
+  for (const BroadphaseProxy &proxy : context.moved) {
+    broadphase_->update(proxy.entity, proxy.aabb);
+  }
+  for (const Collision &collision : context.collisions) {
+    event_queue.send(collision);
+  }
+  new_collisions_.insert(new_collisions_.end(),
+                         context.collider_pairs.begin(),
+                         context.collider_pairs.end());
+  tested_pairs_ += context.tested_pairs;
+
+  context.moved.clear();
+  context.island_moved = 0;
+  context.collisions.clear();
+  context.collider_pairs.clear();
+  context.tested_pairs = 0;
+}
+
+void PhysicsSystem::moveHierarchialAABB(ECS &ecs, Entity e,
+                                        glm::vec3 direction,
+                                        MoveContext &context) {
+  PhysicsComponent *physics = ecs.getComponent<PhysicsComponent>(e);
+  Transform *transform = ecs.getComponent<Transform>(e);
+
+  physics->collider = physics->collider.translate(direction);
+  context.moved.push_back({e, physics->collider});
+
+  for (Entity e : transform->children) {
+    moveHierarchialAABB(ecs, e, direction, context);
+  }
 }
 
 std::optional<glm::vec3> PhysicsSystem::computeCollisionNormal(
@@ -153,42 +534,80 @@ std::optional<glm::vec3> PhysicsSystem::computeCollisionNormal(
   return glm::normalize(normal);
 }
 
-void PhysicsSystem::applyConstraintForces(ECS &ecs, float dt) noexcept {
-  ecs.forEach(std::function([&](Entity entity, Constraint *constraint,
-                                PhysicsComponent *physics,
-                                Transform *transform) {
-    Transform *b_transform = ecs.getComponent<Transform>(constraint->other);
-    PhysicsComponent *b_physics =
-        ecs.getComponent<PhysicsComponent>(constraint->other);
+void PhysicsSystem::solveConstraints(ECS &ecs) {
+  constraint_solver_.clear();
+  constraint_bodies_.clear();
+  constraint_entities_.clear();
 
-    glm::vec3 direction = b_transform->position - transform->position;
-    float current_distance = glm::length(direction);
-    float diff = current_distance - constraint->distance;
+  auto isFixed = [](const PhysicsComponent &physics) {
+    return physics.type == PhysicsComponent::Type::Static ||
+           physics.type == PhysicsComponent::Type::Infinite;
+  };
+  // A massless body made in code holds still rather than get an
+  // infinite inverse mass; scenes can't load one.
+  auto inverseMass = [&](const PhysicsComponent &physics) {
+    if (isFixed(physics) || !(physics.mass > 0.0f)) return 0.0f;
+    return 1.0f / physics.mass;
+  };
 
-    if (std::abs(diff) < glm::epsilon<float>()) return;
+  auto body = [&](Entity entity, uint32_t stored,
+                  const PhysicsComponent &physics) {
+    if (const uint32_t *index = constraint_bodies_.find(entity)) {
+      return *index;
+    }
+    uint32_t index = constraint_solver_.addBody(
+        bodies_.position(stored), bodies_.velocity(stored),
+        inverseMass(physics));
+    constraint_bodies_[entity] = index;
+    constraint_entities_.push_back(entity);
+    return index;
+  };
 
-    float correction = diff * 0.5f;
-    glm::vec3 correction_vector = glm::normalize(direction) * correction;
+  ecs.forEach(std::function([&](Entity entity, Constraint *constraint,
+                                PhysicsComponent *physics) {
+    const uint32_t *a_stored = bodies_.find(entity);
+    const uint32_t *b_stored = bodies_.find(constraint->other);
+    if (!a_stored || !b_stored) return;
+    auto *b_physics = ecs.getComponent<PhysicsComponent>(constraint->other);
+
+    auto resting = [&](const PhysicsComponent &physics) {
+      return physics.sleeping || isFixed(physics);
+    };
+    if (resting(*physics) && resting(*b_physics)) return;
+
+    uint32_t a = body(entity, *a_stored, *physics);
+    uint32_t b = body(constraint->other, *b_stored, *b_physics);
+    constraint_solver_.addConstraint(
+        (static_cast<uint64_t>(entity) << 32) | constraint->other, a, b,
+        constraint->distance);
+  }));
 
-    transform->position += correction_vector;
-    b_transform->position -= correction_vector;
+  if (constraint_solver_.constraints() == 0) return;
+  constraint_solver_.solve(kConstraintIterations);
 
-    glm::vec3 velocity_diff = b_physics->velocity - physics->velocity;
-    float velocity_correction = glm::length(velocity_diff) * 0.5f;
-    glm::vec3 velocity_correction_vector =
-        glm::normalize(velocity_diff) * velocity_correction * dt;
+  for (uint32_t i = 0; i < constraint_entities_.size(); i++) {
+    Entity entity = constraint_entities_[i];
+    auto *physics = ecs.getComponent<PhysicsComponent>(entity);
+    auto *transform = ecs.getComponent<Transform>(entity);
 
-    physics->velocity += velocity_correction_vector;
-    b_physics->velocity -= velocity_correction_vector;
+    glm::vec3 moved = constraint_solver_.position(i) - transform->position;
+    bodies_.setVelocity(*bodies_.find(entity),
+                        constraint_solver_.velocity(i));
+    if (moved == glm::vec3(0.0f)) continue;
 
-    glm::vec3 accel_diff = b_physics->acceleration - physics->acceleration;
-    float accel_correction = glm::length(accel_diff) * 0.5f;
-    glm::vec3 accel_correction_vector =
-        glm::normalize(accel_diff) * accel_correction * dt;
+    transform->position += moved;
+    transform->dirty = true;
+    moveHierarchialAABB(ecs, entity, moved, serial_context_);
+    if (physics->sleeping) wake(ecs, entity);
+  }
 
-    physics->acceleration += accel_correction_vector;
-    b_physics->acceleration -= accel_correction_vector;
-  }));
+  // The broadphase is synced from the stored colliders right after.
+  for (const BroadphaseProxy &proxy : serial_context_.moved) {
+    if (const uint32_t *stored = bodies_.find(proxy.entity)) {
+      bodies_.setCollider(*stored, proxy.aabb);
+    }
+  }
+  serial_context_.moved.clear();
 }
 
 void PhysicsSystem::applyCollisionImpulse(PhysicsComponent *a_physics,
@@ -217,22 +636,16 @@ void PhysicsSystem::applyCollisionImpulse(PhysicsComponent *a_physics,
   }
 
   if (a_physics->type == PhysicsComponent::Type::Regular) {
-    glm::vec3 v1_normal = glm::proj(a_physics->velocity, normal);
-    glm::vec3 v1_tangent = a_physics->velocity - v1_normal;
     a_physics->velocity =
-        normal * glm::length(v1_normal) * material.restitution +
-        v1_tangent * material.friction;
+        bounceOffFixed(a_physics->velocity, normal, material);
   } else if (b_physics->type == PhysicsComponent::Type::Regular) {
-    glm::vec3 v2_normal = glm::proj(b_physics->velocity, normal);
-    glm::vec3 v2_tangent = b_physics->velocity - v2_normal;
     b_physics->velocity =
-        normal * glm::length(v2_normal) * material.restitution +
-        v2_tangent * material.friction;
+        bounceOffFixed(b_physics->velocity, normal, material);
   }
 }
 
-void PhysicsSystem::resolveObjectOverlap(ECS &ecs, Entity a,
-                                         Entity b) const {
+void PhysicsSystem::resolveObjectOverlap(ECS &ecs, Entity a, Entity b,
+                                         MoveContext &context) {
   auto *a_physics = ecs.getComponent<PhysicsComponent>(a);
   auto *a_transform = ecs.getComponent<Transform>(a);
   auto *b_physics = ecs.getComponent<PhysicsComponent>(b);
@@ -248,17 +661,21 @@ void PhysicsSystem::resolveObjectOverlap(ECS &ecs, Entity a,
 
   if (a_physics->type == PhysicsComponent::Type::Regular) {
     a_transform->position += scaled_mtv;
+    a_transform->dirty = true;
     a_physics->collider = a_physics->collider.translate(scaled_mtv);
+    context.moved.push_back({a, a_physics->collider});
   }
   if (b_physics->type == PhysicsComponent::Type::Regular) {
     b_transform->position -= scaled_mtv;
+    b_transform->dirty = true;
     b_physics->collider = b_physics->collider.translate(-scaled_mtv);
+    context.moved.push_back({b, b_physics->collider});
   }
 }
 
 bool PhysicsSystem::moveObjectWithCollisions(ECS &ecs, Entity entity,
                                              glm::vec3 direction, float dt,
-                                             EventQueue &event_queue) {
+                                             MoveContext &context) {
   bool found_collision = false;
 
   Transform *transform = ecs.getComponent<Transform>(entity);
@@ -267,8 +684,7 @@ bool PhysicsSystem::moveObjectWithCollisions(ECS &ecs, Entity entity,
   glm::vec3 old_velocity = physics->velocity;
   // physics->velocity = direction * dt;
 
-  glm::vec3 moved = transform->position + direction * dt;
-  AABB path_box = physics->collider.extendTo(moved);
+  AABB path_box = pathBox(*physics, *transform, direction, dt);
   AABB aabb = physics->collider;
 
   glm::vec3 new_direction = direction;
@@ -281,100 +697,444 @@ bool PhysicsSystem::moveObjectWithCollisions(ECS &ecs, Entity entity,
     return t == PhysicsComponent::Type::Infinite;
   };
 
-  // TODO: use octree
-  ecs.forEach(std::function(
-      [&](Entity other, PhysicsComponent *other_physics, Transform *t) {
-        if (new_direction == glm::vec3(0.0)) {
-          return;
-        }
+  std::vector<Entity> &candidates = context.candidates;
+  candidates.clear();
+  queryColliders(path_box, candidates);
+  // Between updates the index can hold bodies destroyed or changed since
+  // it was synced.
+  std::erase_if(candidates, [&](Entity other) {
+    return !ecs.getComponent<PhysicsComponent>(other);
+  });
+  // Earlier moves in this island aren't in the broadphase yet.
+  for (size_t i = context.island_moved; i < context.moved.size(); i++) {
+    if (context.moved[i].aabb.intersects(path_box)) {
+      candidates.push_back(context.moved[i].entity);
+    }
+  }
+  if (context.island) {
+    // Pushable bodies outside this island belong to another worker.
+    std::erase_if(candidates, [&](Entity other) {
+      const uint32_t *island = island_of_.find(other);
+      if (island) return *island != *context.island;
+      return ecs.getComponent<PhysicsComponent>(other)->type ==
+             PhysicsComponent::Type::Regular;
+    });
+  }
+  // Visit in a fixed order so results don't depend on the index layout.
+  std::sort(candidates.begin(), candidates.end());
+  candidates.erase(std::unique(candidates.begin(), candidates.end()),
+                   candidates.end());
+  context.tested_pairs +=
+      candidates.size() -
+      std::binary_search(candidates.begin(), candidates.end(), entity);
+
+  // Test the swept box against all candidates at once. Resolving one
+  // overlap only moves this body and that candidate, so the boxes of the
+  // ones still to visit stay valid.
+  context.candidate_boxes.clear();
+  for (Entity other : candidates) {
+    context.candidate_boxes.push(
+        ecs.getComponent<PhysicsComponent>(other)->collider);
+  }
+  context.candidate_mask.resize(maskWords(candidates.size()));
 
-        if (entity == other) return;
-
-        // if (auto intersection = findIntersection(
-        //         aabb.getRadius(), aabb.getCenter(), direction,
-        //         other_aabb);
-        //     intersection.has_value()) {
-        //   transform->bounding_box = transform->bounding_box.translate(
-        //       *intersection - transform->position);
-        //   new_direction -= *intersection - transform->position;
-        //   transform->position = *intersection;
-        // }
-
-        AABB other_aabb = other_physics->collider;
-        if (!path_box.intersects(other_aabb)) {
-          return;
-        }
+  bool sweep = physics->continuous && !isCollider(physics->type);
+  if (sweep) {
+    found_collision = sweepContinuous(ecs, entity, new_direction, context);
+    // Only the colliders the clamped move passes through are entered.
+    path_box = aabb.merge(aabb.translate(new_direction));
+  }
+  overlapMask(path_box, context.candidate_boxes.view(),
+              context.candidate_mask);
 
-        bool is_collider =
-            isCollider(physics->type) || isCollider(other_physics->type);
+  for (size_t k = 0; k < candidates.size(); k++) {
+    Entity other = candidates[k];
+    if (entity == other) continue;
+    if (!(context.candidate_mask[k / 64] >> (k % 64) & 1)) continue;
 
-        if (is_collider) {
-          Entity collider = isCollider(physics->type) ? entity : other;
-          Entity collided = (collider == entity) ? other : entity;
+    PhysicsComponent *other_physics =
+        ecs.getComponent<PhysicsComponent>(other);
 
-          new_collisions_.insert({collided, collider});
-          found_collision = true;
-          return;
-        }
+    AABB other_aabb = other_physics->collider;
 
-        std::optional<glm::vec3> normal = computeCollisionNormal(
-            *physics, aabb, *other_physics, other_aabb, direction);
+    bool is_collider =
+        isCollider(physics->type) || isCollider(other_physics->type);
 
-        if (!normal) {
-          resolveObjectOverlap(ecs, entity, other);
-          return;
-        }
+    if (is_collider) {
+      Entity collider = isCollider(physics->type) ? entity : other;
+      Entity collided = (collider == entity) ? other : entity;
 
-        if (!(isInfinite(physics->type) &&
-              isInfinite(other_physics->type))) {
-          applyCollisionImpulse(physics, other_physics, *normal);
-        }
+      context.collider_pairs.push_back({collided, collider});
+      found_collision = true;
+      continue;
+    }
 
-        event_queue.send(Collision{entity, other, physics->velocity,
-                                   other_physics->velocity});
+    // Solid bodies were already handled by the sweep. Once the move is
+    // stopped only the colliders it is in are left to report.
+    if (sweep || new_direction == glm::vec3(0.0)) continue;
 
-        if (other_physics->type == PhysicsComponent::Type::Infinite) {
-          glm::vec3 normal_direction = glm::proj(direction, *normal);
-          new_direction -= normal_direction;
-        }
+    std::optional<glm::vec3> normal = computeCollisionNormal(
+        *physics, aabb, *other_physics, other_aabb, direction);
 
-        if (physics->collider.intersects(other_physics->collider)) {
-          resolveObjectOverlap(ecs, entity, other);
-          new_direction = glm::vec3(0.0);
-        }
+    if (!normal) {
+      resolveObjectOverlap(ecs, entity, other, context);
+      continue;
+    }
 
-        found_collision = true;
-      }));
+    if (!(isInfinite(physics->type) && isInfinite(other_physics->type))) {
+      applyCollisionImpulse(physics, other_physics, *normal);
+    }
+
+    context.collisions.push_back(Collision{
+        entity, other, physics->velocity, other_physics->velocity});
+
+    if (other_physics->type == PhysicsComponent::Type::Infinite) {
+      glm::vec3 normal_direction = glm::proj(direction, *normal);
+      new_direction -= normal_direction;
+    }
+
+    if (physics->collider.intersects(other_physics->collider)) {
+      resolveObjectOverlap(ecs, entity, other, context);
+      new_direction = glm::vec3(0.0);
+    }
+
+    found_collision = true;
+  }
 
   if (glm::length(physics->velocity) < kVelocityEpsilon) {
     physics->velocity = glm::vec3(0.0);
   }
 
   transform->position += new_direction;
-  moveHierarchialAABB(ecs, entity, new_direction);
+  transform->dirty = true;
+  moveHierarchialAABB(ecs, entity, new_direction, context);
+
+  if (!isCollider(physics->type) && !terrains_.empty()) {
+    bool touched = resolveTerrain(ecs, entity, context);
+    found_collision = found_collision || touched;
+  }
 
   return found_collision;
 }
 
-void PhysicsSystem::generateColliderEvents(EventQueue &event_queue) {
-  std::vector<CollisionPair> entered;
-  std::vector<CollisionPair> exited;
+bool PhysicsSystem::resolveTerrain(ECS &ecs, Entity entity,
+                                   MoveContext &context) {
+  Transform *transform = ecs.getComponent<Transform>(entity);
+  PhysicsComponent *physics = ecs.getComponent<PhysicsComponent>(entity);
 
-  std::set_difference(new_collisions_.begin(), new_collisions_.end(),
-                      collision_pairs_.begin(), collision_pairs_.end(),
-                      std::back_inserter(entered));
-  std::set_difference(collision_pairs_.begin(), collision_pairs_.end(),
-                      new_collisions_.begin(), new_collisions_.end(),
-                      std::back_inserter(exited));
+  bool touched = false;
+  for (Entity terrain_entity : terrains_) {
+    const TerrainComponent *terrain =
+        ecs.getComponent<TerrainComponent>(terrain_entity);
+    if (!terrain) continue;
+    AABB aabb = physics->collider;
+    std::optional<float> ground = terrain->heightfield.maxHeight(aabb);
+    if (!ground || *ground <= aabb.min.y) continue;
+
+    glm::vec3 lift{0.0f, *ground - aabb.min.y, 0.0f};
+    transform->position += lift;
+    transform->dirty = true;
+    moveHierarchialAABB(ecs, entity, lift, context);
+
+    glm::vec3 center = aabb.getCenter();
+    glm::vec3 normal = terrain->heightfield.normalAt(center.x, center.z);
+    if (physics->type == PhysicsComponent::Type::Regular &&
+        glm::dot(physics->velocity, normal) < 0.0f) {
+      physics->velocity = bounceOffFixed(
+          physics->velocity, normal,
+          combineMaterials(physics->material, terrain->material));
+    }
+    context.collisions.push_back(Collision{
+        entity, terrain_entity, physics->velocity, glm::vec3(0.0f)});
+    touched = true;
+  }
+  return touched;
+}
+
+AABB PhysicsSystem::pathBox(const PhysicsComponent &physics,
+                            const Transform &transform,
+                            glm::vec3 direction, float dt) const noexcept {
+  AABB path_box = physics.collider.extendTo(transform.position +
+                                            direction * dt);
+  if (physics.continuous) {
+    path_box = path_box.merge(physics.collider.translate(direction));
+  }
+  return path_box;
+}
+
+bool PhysicsSystem::sweepContinuous(ECS &ecs, Entity entity,
+                                    glm::vec3 &motion,
+                                    MoveContext &context) {
+  PhysicsComponent *physics = ecs.getComponent<PhysicsComponent>(entity);
+  glm::vec3 half_extents =
+      (physics->collider.max - physics->collider.min) * 0.5f;
+
+  // Grown by this body's half extents, the candidates can be swept with a
+  // ray from its center.
+  context.sweep_boxes.clear();
+  context.sweep_entities.clear();
+  for (size_t k = 0; k < context.candidates.size(); k++) {
+    Entity other = context.candidates[k];
+    if (other == entity ||
+        ecs.getComponent<PhysicsComponent>(other)->type ==
+            PhysicsComponent::Type::Collider) {
+      continue;
+    }
+    AABB box = context.candidate_boxes.get(k);
+    context.sweep_boxes.push({box.min - half_extents,
+                              box.max + half_extents});
+    context.sweep_entities.push_back(other);
+  }
+  context.sweep_hits.resize(context.sweep_boxes.size());
+
+  bool found_collision = false;
+  glm::vec3 origin = physics->collider.getCenter();
+  glm::vec3 displacement(0.0f);
+  for (int i = 0; i < kMaxSweeps && motion != glm::vec3(0.0f); i++) {
+    raySlabs(Ray{origin + displacement, motion}, 1.0f,
+             context.sweep_boxes.view(), context.sweep_hits);
+
+    // First face the motion runs into; ties go to the lowest entity.
+    // Faces it starts on only count when it moves into them.
+    size_t hit = context.sweep_hits.size();
+    float time = 1.0f;
+    glm::vec3 normal(0.0f);
+    for (size_t k = 0; k < context.sweep_hits.size(); k++) {
+      float t = context.sweep_hits[k];
+      if (t > time || (t == time && hit != context.sweep_hits.size())) {
+        continue;
+      }
+      AABB box = context.sweep_boxes.get(k);
+      glm::vec3 at = origin + displacement + motion * t;
+      glm::vec3 face = t > 0.0f ? entryNormal(box, at, motion)
+                                : contactNormal(box, at);
+      if (glm::dot(face, motion) >= 0.0f) continue;
+      hit = k;
+      time = t;
+      normal = face;
+    }
+
+    if (hit == context.sweep_hits.size()) {
+      displacement += motion;
+      motion = glm::vec3(0.0f);
+      break;
+    }
+
+    Entity other = context.sweep_entities[hit];
+    PhysicsComponent *other_physics =
+        ecs.getComponent<PhysicsComponent>(other);
+    if (physics->type != PhysicsComponent::Type::Infinite ||
+        other_physics->type != PhysicsComponent::Type::Infinite) {
+      applyCollisionImpulse(physics, other_physics, normal);
+    }
+    context.collisions.push_back(Collision{
+        entity, other, physics->velocity, other_physics->velocity});
+    found_collision = true;
+
+    // Stop just short of the face and slide the rest along it.
+    float reached =
+        std::max(time - kContactSkin / glm::length(motion), 0.0f);
+    displacement += motion * reached;
+    glm::vec3 rest = motion * (1.0f - reached);
+    motion = rest - normal * glm::dot(rest, normal);
+  }
+
+  motion = displacement;
+  return found_collision;
+}
+
+std::optional<RayHit> PhysicsSystem::raycast(
+    ECS &ecs, const Ray &ray, float max_distance,
+    const QueryFilter &filter) const {
+  QueryScratch scratch;
+  return castBox(ecs, ray, max_distance, glm::vec3(0.0f), filter,
+                 scratch);
+}
+
+void PhysicsSystem::raycast(ECS &ecs, std::span<const Ray> rays,
+                            float max_distance,
+                            std::span<std::optional<RayHit>> hits,
+                            const QueryFilter &filter) const {
+  assert(hits.size() == rays.size());
+  threadPool().parallelFor(
+      rays.size(), kQueryGrain, [&](size_t begin, size_t end) {
+        QueryScratch scratch;
+        for (size_t i = begin; i < end; i++) {
+          hits[i] = castBox(ecs, rays[i], max_distance, glm::vec3(0.0f),
+                            filter, scratch);
+        }
+      });
+}
+
+std::optional<RayHit> PhysicsSystem::sweepAABB(
+    ECS &ecs, const AABB &box, glm::vec3 motion,
+    const QueryFilter &filter) const {
+  QueryScratch scratch;
+  return castBox(ecs, Ray{box.getCenter(), motion}, 1.0f,
+                 (box.max - box.min) * 0.5f, filter, scratch);
+}
+
+void PhysicsSystem::sweepAABB(ECS &ecs, std::span<const AABB> boxes,
+                              std::span<const glm::vec3> motions,
+                              std::span<std::optional<RayHit>> hits,
+                              const QueryFilter &filter) const {
+  assert(motions.size() == boxes.size() && hits.size() == boxes.size());
+  threadPool().parallelFor(
+      boxes.size(), kQueryGrain, [&](size_t begin, size_t end) {
+        QueryScratch scratch;
+        for (size_t i = begin; i < end; i++) {
+          hits[i] = castBox(ecs, Ray{boxes[i].getCenter(), motions[i]},
+                            1.0f, (boxes[i].max - boxes[i].min) * 0.5f,
+                            filter, scratch);
+        }
+      });
+}
+
+void PhysicsSystem::overlapAABB(ECS &ecs, const AABB &aabb,
+                                std::vector<Entity> &out,
+                                const QueryFilter &filter) const {
+  QueryScratch scratch;
+  queryColliders(aabb, scratch.candidates);
+  filterCandidates(ecs, filter, glm::vec3(0.0f), scratch);
+
+  scratch.mask.resize(maskWords(scratch.candidates.size()));
+  overlapMask(aabb, scratch.boxes.view(), scratch.mask);
+  size_t first = out.size();
+  forEachSetBit(scratch.mask, scratch.candidates.size(),
+                [&](size_t i) { out.push_back(scratch.candidates[i]); });
+
+  for (Entity terrain_entity : terrains_) {
+    const TerrainComponent *terrain =
+        ecs.getComponent<TerrainComponent>(terrain_entity);
+    if (!terrain || filter.ignore == terrain_entity) continue;
+    std::optional<float> ground = terrain->heightfield.maxHeight(aabb);
+    if (ground && *ground >= aabb.min.y) out.push_back(terrain_entity);
+  }
+  std::sort(out.begin() + first, out.end());
+}
 
-  for (const auto &pair : entered) {
-    event_queue.send(EnterCollider{pair.entity_a, pair.entity_b});
+void PhysicsSystem::overlapSphere(ECS &ecs, glm::vec3 center,
+                                  float radius, std::vector<Entity> &out,
+                                  const QueryFilter &filter) const {
+  QueryScratch scratch;
+  queryColliders(AABB{center - radius, center + radius},
+                 scratch.candidates);
+  filterCandidates(ecs, filter, glm::vec3(0.0f), scratch);
+
+  for (size_t i = 0; i < scratch.candidates.size(); i++) {
+    AABB box = scratch.boxes.get(i);
+    glm::vec3 offset = glm::clamp(center, box.min, box.max) - center;
+    if (glm::dot(offset, offset) <= radius * radius) {
+      out.push_back(scratch.candidates[i]);
+    }
   }
+}
 
-  for (const auto &pair : exited) {
-    event_queue.send(ExitCollider{pair.entity_a, pair.entity_b});
+void PhysicsSystem::filterCandidates(ECS &ecs, const QueryFilter &filter,
+                                     glm::vec3 margin,
+                                     QueryScratch &scratch) const {
+  std::vector<Entity> &candidates = scratch.candidates;
+  std::sort(candidates.begin(), candidates.end());
+
+  scratch.boxes.clear();
+  size_t kept = 0;
+  for (Entity other : candidates) {
+    if (filter.ignore == other) continue;
+    // Entities destroyed since the last update are still indexed.
+    const PhysicsComponent *physics =
+        ecs.getComponent<PhysicsComponent>(other);
+    if (!physics) continue;
+    if (!filter.colliders &&
+        physics->type == PhysicsComponent::Type::Collider) {
+      continue;
+    }
+    candidates[kept++] = other;
+    scratch.boxes.push(
+        {physics->collider.min - margin, physics->collider.max + margin});
+  }
+  candidates.resize(kept);
+}
+
+std::optional<RayHit> PhysicsSystem::castBox(
+    ECS &ecs, const Ray &ray, float max_distance, glm::vec3 half_extents,
+    const QueryFilter &filter, QueryScratch &scratch) const {
+  scratch.candidates.clear();
+  if (half_extents == glm::vec3(0.0f)) {
+    broadphase_->queryRay(ray, max_distance, scratch.candidates);
+    static_bvh_.queryRay(ray, max_distance, scratch.candidates);
+  } else {
+    AABB start{ray.origin - half_extents, ray.origin + half_extents};
+    queryColliders(
+        start.merge(start.translate(ray.direction * max_distance)),
+        scratch.candidates);
+  }
+  filterCandidates(ecs, filter, half_extents, scratch);
+
+  scratch.distances.resize(scratch.candidates.size());
+  raySlabs(ray, max_distance, scratch.boxes.view(), scratch.distances);
+
+  std::optional<RayHit> nearest;
+  for (size_t i = 0; i < scratch.candidates.size(); i++) {
+    float distance = scratch.distances[i];
+    if (distance <= max_distance &&
+        (!nearest || distance < nearest->distance)) {
+      nearest = RayHit{scratch.candidates[i], distance};
+    }
+  }
+
+  if (half_extents != glm::vec3(0.0f)) return nearest;
+  for (Entity terrain_entity : terrains_) {
+    const TerrainComponent *terrain =
+        ecs.getComponent<TerrainComponent>(terrain_entity);
+    if (!terrain || filter.ignore == terrain_entity) continue;
+    std::optional<float> distance =
+        terrain->heightfield.raycast(ray, max_distance);
+    if (!distance) continue;
+    if (!nearest || *distance < nearest->distance ||
+        (*distance == nearest->distance &&
+         terrain_entity < nearest->entity)) {
+      nearest = RayHit{terrain_entity, *distance};
+    }
+  }
+  return nearest;
+}
+
+void PhysicsSystem::generateColliderEvents(EventQueue &event_queue) {
+  auto by_key = [](const CollisionPair &a, const CollisionPair &b) {
+    return a.key() < b.key();
+  };
+  // Stable, so a pair reported in both orders keeps the first.
+  std::stable_sort(new_collisions_.begin(), new_collisions_.end(), by_key);
+  new_collisions_.erase(
+      std::unique(new_collisions_.begin(), new_collisions_.end(),
+                  [](const CollisionPair &a, const CollisionPair &b) {
+                    return a.key() == b.key();
+                  }),
+      new_collisions_.end());
+
+  // One merge of the two sorted lists yields both the entered and the
+  // exited pairs.
+  auto current = new_collisions_.begin();
+  auto last = collision_pairs_.begin();
+  while (current != new_collisions_.end() ||
+         last != collision_pairs_.end()) {
+    bool entered = last == collision_pairs_.end() ||
+                   (current != new_collisions_.end() &&
+                    current->key() < last->key());
+    bool exited = !entered && (current == new_collisions_.end() ||
+                               last->key() < current->key());
+    if (entered) {
+      event_queue.send(EnterCollider{current->entity_a, current->entity_b});
+      ++current;
+    } else if (exited) {
+      event_queue.send(ExitCollider{last->entity_a, last->entity_b});
+      ++last;
+    } else {
+      ++current;
+      ++last;
+    }
   }
 
-  collision_pairs_ = new_collisions_;
+  std::swap(collision_pairs_, new_collisions_);
   new_collisions_.clear();
 }
@@ -0,0 +1,170 @@
+#include <cassert>
+
+#include "sunset/aabb_batch.h"
+
+#include "sunset/projectiles.h"
+
+namespace {
+
+// One axis of a step: velocity += acceleration * ticks, then position +=
+// velocity * scale, remembering the old position.
+void integrateScalar(float *position, float *previous, float *velocity,
+                     const float *acceleration, float ticks, float scale,
+                     size_t begin, size_t count) {
+  for (size_t i = begin; i < count; i++) {
+    velocity[i] += acceleration[i] * ticks;
+    previous[i] = position[i];
+    position[i] += velocity[i] * scale;
+  }
+}
+
+#ifdef SUNSET_X86_SIMD
+
+void integrateSSE(float *position, float *previous, float *velocity,
+                  const float *acceleration, float ticks, float scale,
+                  size_t count) {
+  const __m128 ticks4 = _mm_set1_ps(ticks);
+  const __m128 scale4 = _mm_set1_ps(scale);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128 v = _mm_add_ps(
+        _mm_loadu_ps(velocity + i),
+        _mm_mul_ps(_mm_loadu_ps(acceleration + i), ticks4));
+    __m128 p = _mm_loadu_ps(position + i);
+    _mm_storeu_ps(velocity + i, v);
+    _mm_storeu_ps(previous + i, p);
+    _mm_storeu_ps(position + i, _mm_add_ps(p, _mm_mul_ps(v, scale4)));
+  }
+  integrateScalar(position, previous, velocity, acceleration, ticks, scale,
+                  i, count);
+}
+
+__attribute__((target("avx2"))) void integrateAVX2(
+    float *position, float *previous, float *velocity,
+    const float *acceleration, float ticks, float scale, size_t count) {
+  const __m256 ticks8 = _mm256_set1_ps(ticks);
+  const __m256 scale8 = _mm256_set1_ps(scale);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256 v = _mm256_add_ps(
+        _mm256_loadu_ps(velocity + i),
+        _mm256_mul_ps(_mm256_loadu_ps(acceleration + i), ticks8));
+    __m256 p = _mm256_loadu_ps(position + i);
+    _mm256_storeu_ps(velocity + i, v);
+    _mm256_storeu_ps(previous + i, p);
+    _mm256_storeu_ps(position + i,
+                     _mm256_add_ps(p, _mm256_mul_ps(v, scale8)));
+  }
+  integrateScalar(position, previous, velocity, acceleration, ticks, scale,
+                  i, count);
+}
+
+#endif
+
+void integrate(float *position, float *previous, float *velocity,
+               const float *acceleration, float ticks, float scale,
+               size_t count) {
+  switch (simdLevel()) {
+#ifdef SUNSET_X86_SIMD
+    case SimdLevel::AVX2:
+      integrateAVX2(position, previous, velocity, acceleration, ticks,
+                    scale, count);
+      return;
+    case SimdLevel::SSE:
+      integrateSSE(position, previous, velocity, acceleration, ticks,
+                   scale, count);
+      return;
+#endif
+    default:
+      integrateScalar(position, previous, velocity, acceleration, ticks,
+                      scale, 0, count);
+  }
+}
+
+} // namespace
+
+ProjectileSystem::ProjectileSystem(size_t capacity) : capacity_(capacity) {
+  for (Columns *columns :
+       {&positions_, &previous_, &velocities_, &accelerations_}) {
+    for (std::vector<float> &column : *columns) {
+      column.resize(capacity);
+    }
+  }
+  lifetimes_.resize(capacity);
+  damages_.resize(capacity);
+  collides_.resize(capacity);
+  rays_.reserve(capacity);
+  ray_owners_.reserve(capacity);
+  hits_.reserve(capacity);
+}
+
+bool ProjectileSystem::spawn(const Projectile &projectile) {
+  if (size_ == capacity_) return false;
+  set(size_++, projectile);
+  return true;
+}
+
+void ProjectileSystem::update(ECS &ecs, const PhysicsSystem &physics,
+                              EventQueue &event_queue, float dt) {
+  float ticks = dt * PhysicsSystem::kReferenceTickRate;
+  for (int axis = 0; axis < 3; axis++) {
+    integrate(positions_[axis].data(), previous_[axis].data(),
+              velocities_[axis].data(), accelerations_[axis].data(), ticks,
+              PhysicsSystem::kMotionScale * ticks, size_);
+  }
+  for (size_t i = 0; i < size_; i++) {
+    lifetimes_[i] -= dt;
+  }
+
+  rays_.clear();
+  ray_owners_.clear();
+  for (uint32_t i = 0; i < size_; i++) {
+    if (!collides_[i]) continue;
+    glm::vec3 from = previousPosition(i);
+    rays_.push_back(Ray{from, position(i) - from});
+    ray_owners_.push_back(i);
+  }
+  hits_.resize(rays_.size());
+  physics.raycast(ecs, rays_, 1.0f, hits_);
+
+  for (size_t k = 0; k < hits_.size(); k++) {
+    if (!hits_[k]) continue;
+    uint32_t i = ray_owners_[k];
+    event_queue.send(ProjectileHit{hits_[k]->entity,
+                                   rays_[k].at(hits_[k]->distance),
+                                   damages_[i]});
+    lifetimes_[i] = 0.0f;
+  }
+
+  // From the back, so the projectile moved into slot i has already been
+  // looked at.
+  for (size_t i = size_; i-- > 0;) {
+    if (lifetimes_[i] <= 0.0f) swapRemove(i);
+  }
+}
+
+void ProjectileSystem::set(size_t i, const Projectile &projectile) {
+  for (int axis = 0; axis < 3; axis++) {
+    positions_[axis][i] = projectile.position[axis];
+    previous_[axis][i] = projectile.position[axis];
+    velocities_[axis][i] = projectile.velocity[axis];
+    accelerations_[axis][i] = projectile.acceleration[axis];
+  }
+  lifetimes_[i] = projectile.lifetime;
+  damages_[i] = projectile.damage;
+  collides_[i] = projectile.collides;
+}
+
+void ProjectileSystem::swapRemove(size_t i) {
+  assert(i < size_);
+  size_t last = --size_;
+  for (Columns *columns :
+       {&positions_, &previous_, &velocities_, &accelerations_}) {
+    for (std::vector<float> &column : *columns) {
+      column[i] = column[last];
+    }
+  }
+  lifetimes_[i] = lifetimes_[last];
+  damages_[i] = damages_[last];
+  collides_[i] = collides_[last];
+}
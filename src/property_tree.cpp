@@ -1,5 +1,6 @@
 #include <bit>
 #include <istream>
+#include <ostream>
 #include <string>
 #include <utility>
 #include <vector>
@@ -24,6 +25,79 @@ T readValue(std::istream &input) {
   return value;
 }
 
+template <typename T>
+void appendValue(std::string &out, const T &value) {
+  out.append(std::bit_cast<const char *>(&value), sizeof(T));
+}
+
+absl::Status appendProperty(std::string &out, const Property &prop) {
+  return std::visit(
+      [&out](const auto &value) -> absl::Status {
+        using T = std::decay_t<decltype(value)>;
+        if constexpr (std::is_same_v<T, std::vector<int16_t>>) {
+          return absl::UnimplementedError(
+              "int16 arrays can't be read back");
+        } else if constexpr (is_vector_v<T>) {
+          using V = typename T::value_type;
+          constexpr char kCodes[] = {'c', 'i', 'l', 'f', 'd'};
+          constexpr int kIndex = std::is_same_v<V, uint8_t>   ? 0
+                                 : std::is_same_v<V, int32_t> ? 1
+                                 : std::is_same_v<V, int64_t> ? 2
+                                 : std::is_same_v<V, float>   ? 3
+                                                              : 4;
+          out.push_back(kCodes[kIndex]);
+          appendValue<uint32_t>(out, value.size());
+          appendValue<uint32_t>(out, 0);  // encoding: raw
+          appendValue<uint32_t>(out, value.size() * sizeof(V));
+          out.append(std::bit_cast<const char *>(value.data()),
+                     value.size() * sizeof(V));
+        } else if constexpr (std::is_same_v<T, std::string>) {
+          out.push_back('S');
+          appendValue<uint32_t>(out, value.size());
+          out.append(value);
+        } else {
+          constexpr char kCodes[] = {'C', 'Y', 'I', 'L', 'F', 'D'};
+          constexpr int kIndex = std::is_same_v<T, uint8_t>   ? 0
+                                 : std::is_same_v<T, int16_t> ? 1
+                                 : std::is_same_v<T, int32_t> ? 2
+                                 : std::is_same_v<T, int64_t> ? 3
+                                 : std::is_same_v<T, float>   ? 4
+                                                              : 5;
+          out.push_back(kCodes[kIndex]);
+          appendValue(out, value);
+        }
+        return absl::OkStatus();
+      },
+      prop);
+}
+
+absl::Status appendPropertyTree(std::string &out,
+                                const PropertyTree &tree) {
+  if (tree.name.size() > 255) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("Node name '%s' is too long", tree.name));
+  }
+
+  // Everything after the 13 byte header: name, properties, children.
+  std::string body = tree.name;
+  for (const Property &prop : tree.properties) {
+    absl::Status status = appendProperty(body, prop);
+    if (!status.ok()) return status;
+  }
+  uint32_t property_list_len = body.size() - tree.name.size();
+  for (const PropertyTree &child : tree.children) {
+    absl::Status status = appendPropertyTree(body, child);
+    if (!status.ok()) return status;
+  }
+
+  appendValue<uint32_t>(out, body.size());
+  appendValue<uint32_t>(out, tree.properties.size());
+  appendValue<uint32_t>(out, property_list_len);
+  appendValue<uint8_t>(out, tree.name.size());
+  out.append(body);
+  return absl::OkStatus();
+}
+
 absl::StatusOr<std::vector<uint8_t>> decompressData(
     const std::vector<uint8_t> &compressed_data,
     uint32_t uncompressed_size) {
@@ -245,3 +319,14 @@ absl::StatusOr<PropertyTree> readPropertyTree(std::istream &input) {
   input.seekg(start + end_offset, std::ios::beg);
   return node;
 }
+
+absl::Status writePropertyTree(std::ostream &output,
+                               const PropertyTree &tree) {
+  std::string data;
+  absl::Status status = appendPropertyTree(data, tree);
+  if (!status.ok()) return status;
+
+  output.write(data.data(), data.size());
+  if (!output) return absl::DataLossError("Failed to write property tree");
+  return absl::OkStatus();
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cassert>
 #include <glm/gtc/type_ptr.hpp>
 #include <optional>
@@ -37,6 +38,36 @@ void main() {
   FragColor = vec4(intensity);
 })";
 
+// Each instance is a copy of the mesh moved to aInstance.xyz and scaled
+// by aInstance.w.
+const static std::string kProjectileVertexShader = R"(
+#version 330 core
+layout(location = 0) in vec3 aPosition;
+layout(location = 2) in vec2 aUV;
+layout(location = 3) in vec4 aInstance;
+uniform mat4 uView;
+uniform mat4 uProjection;
+out vec2 fragUV;
+void main() {
+  vec3 position = aInstance.xyz + aPosition * aInstance.w;
+  gl_Position = uProjection * uView * vec4(position, 1.0);
+  fragUV = aUV;
+}
+)";
+
+const static std::string kProjectileFragmentShader = R"(
+#version 330 core
+in vec2 fragUV;
+out vec4 FragColor;
+uniform sampler2D uTexture;
+void main() {
+  FragColor = texture(uTexture, fragUV);
+}
+)";
+
+// Index of aInstance in the projectile pipeline's attributes.
+constexpr uint32_t kProjectileInstanceAttr = 2;
+
 const static std::string kAABBDebugVertexShader = R"(
 #version 330 core
 layout(location = 0) in vec3 aPosition;
@@ -256,19 +287,86 @@ void DebugOverlay::update(ECS &ecs, std::vector<Command> &commands) {
                  std::string(absl::StrFormat(
                      "fps: %lu", absl::Seconds(1) / frame_time)),
                  -0.9f, -0.9f, 2.0f);
+
+  if (event_queue_) {
+    drawEventStats(commands);
+  }
+}
+
+void DebugOverlay::drawEventStats(std::vector<Command> &commands) {
+  constexpr size_t kMaxRows = 8;
+  constexpr float kLineHeight = 0.05f;
+
+  EventQueueStats stats = event_queue_->stats();
+  float y = -0.8f;
+
+  if (!stats.enabled) {
+    text_pipeline_(commands, std::string("events: stats compiled out"),
+                   -0.9f, y, 1.0f);
+    return;
+  }
+
+  text_pipeline_(commands,
+                 std::string(absl::StrFormat(
+                     "events: peak %lu delayed %lu",
+                     stats.last_peak_depth, stats.delayed_size)),
+                 -0.9f, y, 1.0f);
+
+  std::sort(stats.types.begin(), stats.types.end(),
+            [](const EventTypeStats &a, const EventTypeStats &b) {
+              return a.last_sent > b.last_sent;
+            });
+
+  for (size_t i = 0; i < std::min(stats.types.size(), kMaxRows); i++) {
+    const EventTypeStats &type = stats.types[i];
+
+    // Report the slowest handler, which is the one worth looking at when
+    // a frame spikes.
+    absl::Duration p99 = absl::ZeroDuration();
+    absl::Duration max = absl::ZeroDuration();
+    for (const LatencyHistogram &histogram : type.handler_time) {
+      p99 = std::max(p99, histogram.percentile(0.99));
+      max = std::max(max, histogram.max);
+    }
+
+    y += kLineHeight;
+    text_pipeline_(
+        commands,
+        std::string(absl::StrFormat(
+            "%s %lu/%lu p99 %ldus max %ldus", type.name, type.last_sent,
+            type.last_delivered, absl::ToInt64Microseconds(p99),
+            absl::ToInt64Microseconds(max))),
+        -0.9f, y, 1.0f);
+  }
 }
 
 RenderingSystem::RenderingSystem(Backend &backend)
     : debug_overlay_(backend) {
   initializePipeline(backend);
+  initializeProjectilePipeline(backend);
+}
+
+void RenderingSystem::showProjectiles(Backend &backend,
+                                      const ProjectileSystem &projectiles,
+                                      MeshRenderable mesh, float scale) {
+  Handle instance_buffer =
+      backend.allocDynamic(projectiles.capacity() * sizeof(glm::vec4));
+  projectile_batch_ = ProjectileBatch{&projectiles, std::move(mesh), scale,
+                                      instance_buffer};
+  projectile_instances_.reserve(projectiles.capacity());
 }
 
 void RenderingSystem::update(ECS &ecs, std::vector<Command> &commands,
                              bool debug) {
+  transforms_.update(ecs, interpolation_);
+
   ecs.forEach(std::function([&](Entity entity, Camera *camera,
                                 Transform *transform) {
-    glm::mat4 view = calculateViewMatrix(camera, transform);
-    glm::mat4 projection = calculateProjectionMatrix(camera, transform);
+    Transform eye{
+        .position = transform->interpolatedPosition(interpolation_),
+        .rotation = transform->interpolatedRotation(interpolation_)};
+    glm::mat4 view = calculateViewMatrix(camera, &eye);
+    glm::mat4 projection = calculateProjectionMatrix(camera, &eye);
 
     // commands.push_back(SetViewport{camera->viewport.x,
     // camera->viewport.y,
@@ -287,9 +385,7 @@ void RenderingSystem::update(ECS &ecs, std::vector<Command> &commands,
 
     ecs.forEach(std::function([&](Entity entity, Transform *transform,
                                   MeshRenderable *mesh) {
-      glm::mat4 model = calculateModelMatrix(ecs, entity);
-
-      transform->cached_model = model;
+      const glm::mat4 &model = transform->cached_model;
 
       commands.push_back(Use{pipeline_handle_});
       commands.push_back(BindVertexBuffer{.handle = mesh->vertex_buffer});
@@ -327,6 +423,8 @@ void RenderingSystem::update(ECS &ecs, std::vector<Command> &commands,
             .vertex_count = static_cast<uint32_t>(mesh->vertex_count)});
       }
     }));
+
+    if (projectile_batch_) drawProjectiles(view, projection, commands);
   }));
 
   if (debug) {
@@ -334,6 +432,58 @@ void RenderingSystem::update(ECS &ecs, std::vector<Command> &commands,
   }
 }
 
+void RenderingSystem::drawProjectiles(const glm::mat4 &view,
+                                      const glm::mat4 &projection,
+                                      std::vector<Command> &commands) {
+  const ProjectileSystem &projectiles = *projectile_batch_->projectiles;
+  const MeshRenderable &mesh = projectile_batch_->mesh;
+  if (projectiles.size() == 0) return;
+
+  projectile_instances_.clear();
+  for (size_t i = 0; i < projectiles.size(); i++) {
+    glm::vec3 position =
+        glm::mix(projectiles.previousPosition(i), projectiles.position(i),
+                 interpolation_);
+    projectile_instances_.emplace_back(position, projectile_batch_->scale);
+  }
+
+  commands.push_back(Use{projectile_pipeline_handle_});
+  commands.push_back(
+      UpdateBuffer{projectile_batch_->instance_buffer,
+                   to_bytes(projectile_instances_)});
+  commands.push_back(
+      SetUniform{.arg_index = 0,
+                 .value = to_bytes(std::vector<float>(
+                     glm::value_ptr(view), glm::value_ptr(view) + 16))});
+  commands.push_back(SetUniform{
+      .arg_index = 1,
+      .value = to_bytes(std::vector<float>(
+          glm::value_ptr(projection), glm::value_ptr(projection) + 16))});
+
+  commands.push_back(BindVertexBuffer{.handle = mesh.vertex_buffer});
+  commands.push_back(
+      BindVertexBuffer{.attr_idx = kProjectileInstanceAttr,
+                       .handle = projectile_batch_->instance_buffer});
+  if (mesh.texture.has_value()) {
+    commands.push_back(SetUniform{2, to_bytes(0)});
+    commands.push_back(BindTexture{mesh.texture.value()});
+  } else {
+    commands.push_back(BindTexture{0});
+  }
+
+  uint32_t instances = static_cast<uint32_t>(projectiles.size());
+  if (mesh.index_buffer) {
+    commands.push_back(BindIndexBuffer{.handle = mesh.index_buffer});
+    commands.push_back(
+        DrawIndexed{.index_count = static_cast<uint32_t>(mesh.index_count),
+                    .instance_count = instances});
+  } else {
+    commands.push_back(
+        Draw{.vertex_count = static_cast<uint32_t>(mesh.vertex_count),
+             .instance_count = instances});
+  }
+}
+
 void RenderingSystem::initializePipeline(Backend &backend) {
   std::vector<VertexAttribute> attributes = {
       VertexAttribute{.name = "aPosition",
@@ -414,3 +564,42 @@ void RenderingSystem::initializePipeline(Backend &backend) {
   PipelineLayout layout = {.attributes = attributes, .uniforms = uniforms};
   pipeline_handle_ = backend.compilePipeline(layout, shaders);
 }
+
+void RenderingSystem::initializeProjectilePipeline(Backend &backend) {
+  std::vector<VertexAttribute> attributes = {
+      VertexAttribute{.name = "aPosition",
+                      .size = 3 * sizeof(float),
+                      .location = 0,
+                      .binding = 0,
+                      .offset = offsetof(Vertex, position),
+                      .stride = sizeof(Vertex)},
+      VertexAttribute{.name = "aUV",
+                      .size = 2 * sizeof(float),
+                      .location = 2,
+                      .binding = 0,
+                      .offset = offsetof(Vertex, uv),
+                      .stride = sizeof(Vertex)},
+      VertexAttribute{.name = "aInstance",
+                      .size = sizeof(glm::vec4),
+                      .location = 3,
+                      .binding = 1,
+                      .offset = 0,
+                      .stride = sizeof(glm::vec4),
+                      .divisor = 1},
+  };
+
+  std::vector<Uniform> uniforms = {
+      Uniform{.name = "uView", .binding = 0, .size = 16 * sizeof(float)},
+      Uniform{
+          .name = "uProjection", .binding = 1, .size = 16 * sizeof(float)},
+      Uniform{.name = "uTexture", .binding = 2, .size = sizeof(int)},
+  };
+
+  std::vector<Shader> shaders = {
+      Shader{ShaderType::Vertex, kProjectileVertexShader, "glsl"},
+      Shader{ShaderType::Fragment, kProjectileFragmentShader, "glsl"},
+  };
+
+  PipelineLayout layout = {.attributes = attributes, .uniforms = uniforms};
+  projectile_pipeline_handle_ = backend.compilePipeline(layout, shaders);
+}
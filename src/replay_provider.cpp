@@ -0,0 +1,259 @@
+#include <array>
+#include <bit>
+#include <cstring>
+
+#include <absl/log/log.h>
+
+#include "sunset/replay_provider.h"
+
+namespace {
+
+constexpr std::array<char, 4> kMagic = {'S', 'R', 'P', 'L'};
+constexpr uint16_t kVersion = 2;
+
+constexpr size_t kKeyMapBytes = (static_cast<size_t>(Key::COUNT) + 7) / 8;
+
+enum RecordKind : uint8_t {
+  kKeyDown = 0,
+  kKeyUp,
+  kKeyPressed,
+  kMouseDown,
+  kMouseUp,
+  kMouseMoved,
+  kMouseScrolled,
+  // Last record of a finished session, tagged with the frame whose poll
+  // ended it.
+  kEnd,
+};
+
+template <typename T>
+void writeValue(std::ostream &output, const T &value) {
+  output.write(std::bit_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T>
+T readValue(std::istream &input) {
+  T value{};
+  input.read(std::bit_cast<char *>(&value), sizeof(T));
+  return value;
+}
+
+void writePayload(std::ostream &output, const KeyDown &event) {
+  writeValue(output, static_cast<uint8_t>(event.key));
+  writeValue(output, static_cast<uint8_t>(event.mods));
+}
+
+void writePayload(std::ostream &output, const KeyUp &event) {
+  writeValue(output, static_cast<uint8_t>(event.key));
+  writeValue(output, static_cast<uint8_t>(event.mods));
+}
+
+void writePayload(std::ostream &output, const KeyPressed &event) {
+  std::array<uint8_t, kKeyMapBytes> bytes{};
+  for (size_t i = 0; i < event.map.size(); i++) {
+    if (event.map.test(i)) bytes[i / 8] |= 1 << (i % 8);
+  }
+  output.write(std::bit_cast<const char *>(bytes.data()), bytes.size());
+}
+
+void writePayload(std::ostream &output, const MouseDown &event) {
+  writeValue(output, static_cast<int32_t>(event.button));
+  writeValue(output, static_cast<int32_t>(event.mods));
+}
+
+void writePayload(std::ostream &output, const MouseUp &event) {
+  writeValue(output, static_cast<int32_t>(event.button));
+  writeValue(output, static_cast<int32_t>(event.mods));
+}
+
+void writePayload(std::ostream &output, const MouseMoved &event) {
+  writeValue(output, event.x);
+  writeValue(output, event.y);
+  writeValue(output, event.dx);
+  writeValue(output, event.dy);
+}
+
+void writePayload(std::ostream &output, const MouseScrolled &event) {
+  writeValue(output, event.dx);
+  writeValue(output, event.dy);
+}
+
+template <typename T>
+constexpr RecordKind kindOf() {
+  if constexpr (std::is_same_v<T, KeyDown>) return kKeyDown;
+  if constexpr (std::is_same_v<T, KeyUp>) return kKeyUp;
+  if constexpr (std::is_same_v<T, KeyPressed>) return kKeyPressed;
+  if constexpr (std::is_same_v<T, MouseDown>) return kMouseDown;
+  if constexpr (std::is_same_v<T, MouseUp>) return kMouseUp;
+  if constexpr (std::is_same_v<T, MouseMoved>) return kMouseMoved;
+  if constexpr (std::is_same_v<T, MouseScrolled>) return kMouseScrolled;
+}
+
+} // namespace
+
+RecordingIO::RecordingIO(std::unique_ptr<IOProvider> inner,
+                         EventQueue &event_queue,
+                         const std::filesystem::path &path)
+    : inner_(std::move(inner)), out_(path, std::ios::binary) {
+  out_.write(kMagic.data(), kMagic.size());
+  writeValue(out_, kVersion);
+
+  event_queue.subscribe(
+      std::function([this](const KeyDown &event) { record(event); }));
+  event_queue.subscribe(
+      std::function([this](const KeyUp &event) { record(event); }));
+  event_queue.subscribe(
+      std::function([this](const KeyPressed &event) { record(event); }));
+  event_queue.subscribe(
+      std::function([this](const MouseDown &event) { record(event); }));
+  event_queue.subscribe(
+      std::function([this](const MouseUp &event) { record(event); }));
+  event_queue.subscribe(
+      std::function([this](const MouseMoved &event) { record(event); }));
+  event_queue.subscribe(std::function(
+      [this](const MouseScrolled &event) { record(event); }));
+}
+
+RecordingIO::~RecordingIO() {
+  // Written last, after the events of the final frame have been
+  // dispatched, so a replay runs exactly as many frames.
+  writeValue(out_, frame_);
+  writeValue(out_, static_cast<uint8_t>(kEnd));
+}
+
+bool RecordingIO::poll(EventQueue &event_queue) {
+  // Events sent during this poll are dispatched (and recorded) before the
+  // next one, so they all land in this frame.
+  frame_++;
+  bool running = inner_->poll(event_queue);
+  if (!running) {
+    out_.flush();
+  }
+  return running;
+}
+
+template <typename T>
+void RecordingIO::record(const T &event) {
+  writeValue(out_, frame_);
+  writeValue(out_, static_cast<uint8_t>(kindOf<T>()));
+  writePayload(out_, event);
+}
+
+ReplayIO::ReplayIO(const std::filesystem::path &path)
+    : in_(path, std::ios::binary) {
+  readHeader();
+}
+
+void ReplayIO::readHeader() {
+  std::array<char, 4> magic{};
+  in_.read(magic.data(), magic.size());
+  uint16_t version = readValue<uint16_t>(in_);
+
+  if (!in_ || magic != kMagic) {
+    LOG(ERROR) << "Not an input recording";
+    return;
+  }
+
+  if (version != kVersion) {
+    LOG(ERROR) << "Unsupported input recording version " << version;
+    return;
+  }
+
+  valid_ = true;
+}
+
+bool ReplayIO::poll(EventQueue &event_queue) {
+  if (!valid_ || exhausted_) {
+    return false;
+  }
+
+  frame_++;
+
+  while (true) {
+    if (!next_) {
+      Record record{readValue<uint32_t>(in_), readValue<uint8_t>(in_)};
+      if (!in_) {
+        // A log cut short has no end record. Let the events of the last
+        // recorded frame be processed before reporting the end.
+        exhausted_ = true;
+        return true;
+      }
+      next_ = record;
+    }
+
+    if (next_->kind == kEnd) {
+      // Frames after the last input event still ran in the recorded
+      // session, so keep going until the one that ended it.
+      exhausted_ = frame_ >= next_->frame;
+      return !exhausted_;
+    }
+
+    if (next_->frame > frame_) {
+      return true;
+    }
+
+    if (!dispatch(next_->kind, event_queue)) {
+      LOG(ERROR) << "Corrupt input recording at frame " << next_->frame;
+      valid_ = false;
+      return false;
+    }
+    next_.reset();
+  }
+}
+
+bool ReplayIO::dispatch(uint8_t kind, EventQueue &event_queue) {
+  switch (kind) {
+    case kKeyDown:
+    case kKeyUp: {
+      Key key = static_cast<Key>(readValue<uint8_t>(in_));
+      Modifier mods = static_cast<Modifier>(readValue<uint8_t>(in_));
+      if (kind == kKeyDown) {
+        event_queue.send(KeyDown{key, mods});
+      } else {
+        event_queue.send(KeyUp{key, mods});
+      }
+      break;
+    }
+    case kKeyPressed: {
+      std::array<uint8_t, kKeyMapBytes> bytes{};
+      in_.read(std::bit_cast<char *>(bytes.data()), bytes.size());
+      KeyPressed pressed;
+      for (size_t i = 0; i < pressed.map.size(); i++) {
+        pressed.map.set(i, bytes[i / 8] & (1 << (i % 8)));
+      }
+      event_queue.send(pressed);
+      break;
+    }
+    case kMouseDown:
+    case kMouseUp: {
+      int button = readValue<int32_t>(in_);
+      int mods = readValue<int32_t>(in_);
+      if (kind == kMouseDown) {
+        event_queue.send(MouseDown{button, mods});
+      } else {
+        event_queue.send(MouseUp{button, mods});
+      }
+      break;
+    }
+    case kMouseMoved: {
+      MouseMoved moved;
+      moved.x = readValue<double>(in_);
+      moved.y = readValue<double>(in_);
+      moved.dx = readValue<double>(in_);
+      moved.dy = readValue<double>(in_);
+      event_queue.send(moved);
+      break;
+    }
+    case kMouseScrolled: {
+      MouseScrolled scrolled;
+      scrolled.dx = readValue<double>(in_);
+      scrolled.dy = readValue<double>(in_);
+      event_queue.send(scrolled);
+      break;
+    }
+    default:
+      return false;
+  }
+
+  return static_cast<bool>(in_);
+}
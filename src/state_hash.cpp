@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+
+#include <absl/log/log.h>
+
+#include "sunset/physics.h"
+
+#include "sunset/state_hash.h"
+
+namespace {
+
+constexpr std::array<char, 4> kMagic = {'S', 'H', 'S', 'H'};
+constexpr uint16_t kVersion = 1;
+
+constexpr uint64_t kFnvOffset = 0xcbf29ce484222325;
+constexpr uint64_t kFnvPrime = 0x100000001b3;
+
+// FNV-1a over 32-bit words.
+void mix(uint64_t &hash, uint32_t word) {
+  hash ^= word;
+  hash *= kFnvPrime;
+}
+
+void mix(uint64_t &hash, glm::vec3 v) {
+  mix(hash, std::bit_cast<uint32_t>(v.x));
+  mix(hash, std::bit_cast<uint32_t>(v.y));
+  mix(hash, std::bit_cast<uint32_t>(v.z));
+}
+
+void mix(uint64_t &hash, uint64_t value) {
+  mix(hash, static_cast<uint32_t>(value));
+  mix(hash, static_cast<uint32_t>(value >> 32));
+}
+
+template <typename T>
+void writeValue(std::ostream &output, const T &value) {
+  output.write(std::bit_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T>
+T readValue(std::istream &input) {
+  T value{};
+  input.read(std::bit_cast<char *>(&value), sizeof(T));
+  return value;
+}
+
+} // namespace
+
+StateHash hashPhysicsState(ECS &ecs) {
+  StateHash state{kFnvOffset, {}};
+  ecs.forEach(std::function([&](Entity entity, PhysicsComponent *physics,
+                                Transform *transform) {
+    uint64_t hash = kFnvOffset;
+    mix(hash, static_cast<uint32_t>(entity));
+    mix(hash, transform->position);
+    mix(hash, physics->velocity);
+    state.bodies.push_back({entity, hash});
+  }));
+
+  std::sort(
+      state.bodies.begin(), state.bodies.end(),
+      [](const auto &a, const auto &b) { return a.entity < b.entity; });
+  for (const StateHash::Body &body : state.bodies) {
+    mix(state.hash, body.hash);
+  }
+  return state;
+}
+
+StateHashRecorder::StateHashRecorder(const std::filesystem::path &path)
+    : out_(path, std::ios::binary) {
+  out_.write(kMagic.data(), kMagic.size());
+  writeValue(out_, kVersion);
+}
+
+void StateHashRecorder::record(const StateHash &state) {
+  writeValue(out_, tick_++);
+  writeValue(out_, state.hash);
+  writeValue(out_, static_cast<uint32_t>(state.bodies.size()));
+  for (const StateHash::Body &body : state.bodies) {
+    writeValue(out_, static_cast<uint32_t>(body.entity));
+    writeValue(out_, body.hash);
+  }
+}
+
+StateHashVerifier::StateHashVerifier(const std::filesystem::path &path)
+    : in_(path, std::ios::binary) {
+  std::array<char, 4> magic{};
+  in_.read(magic.data(), magic.size());
+  uint16_t version = readValue<uint16_t>(in_);
+  std::streampos start = in_.tellg();
+  in_.seekg(0, std::ios::end);
+  size_ = in_.tellg();
+  in_.seekg(start);
+
+  if (!in_ || magic != kMagic) {
+    LOG(ERROR) << "Not a state hash log";
+    return;
+  }
+  if (version != kVersion) {
+    LOG(ERROR) << "Unsupported state hash log version " << version;
+    return;
+  }
+  valid_ = true;
+}
+
+std::optional<Divergence> StateHashVerifier::verify(
+    const StateHash &state) {
+  if (!valid_ || exhausted_) {
+    return std::nullopt;
+  }
+
+  uint32_t tick = readValue<uint32_t>(in_);
+  uint64_t hash = readValue<uint64_t>(in_);
+  uint32_t count = readValue<uint32_t>(in_);
+  if (!in_) {
+    exhausted_ = true;
+    return std::nullopt;
+  }
+  constexpr std::streamoff kBodySize = sizeof(uint32_t) + sizeof(uint64_t);
+  if (count >
+      (size_ - static_cast<std::streamoff>(in_.tellg())) / kBodySize) {
+    LOG(ERROR) << "Corrupt state hash log at tick " << tick_;
+    valid_ = false;
+    return std::nullopt;
+  }
+  recorded_.resize(count);
+  for (StateHash::Body &body : recorded_) {
+    body.entity = readValue<uint32_t>(in_);
+    body.hash = readValue<uint64_t>(in_);
+  }
+  if (!in_ || tick != tick_) {
+    LOG(ERROR) << "Corrupt state hash log at tick " << tick_;
+    valid_ = false;
+    return std::nullopt;
+  }
+  tick_++;
+
+  if (hash == state.hash) {
+    return std::nullopt;
+  }
+
+  // Both lists are sorted by entity; the first difference is the lowest
+  // entity that diverged.
+  auto recorded = recorded_.begin();
+  auto current = state.bodies.begin();
+  while (recorded != recorded_.end() && current != state.bodies.end() &&
+         *recorded == *current) {
+    ++recorded;
+    ++current;
+  }
+  if (recorded == recorded_.end() && current == state.bodies.end()) {
+    return Divergence{tick, std::nullopt};
+  }
+  if (recorded == recorded_.end()) return Divergence{tick, current->entity};
+  if (current == state.bodies.end()) {
+    return Divergence{tick, recorded->entity};
+  }
+  return Divergence{tick, std::min(recorded->entity, current->entity)};
+}
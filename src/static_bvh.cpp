@@ -0,0 +1,282 @@
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <limits>
+#include <numeric>
+
+#include <absl/strings/str_format.h>
+
+#include "sunset/static_bvh.h"
+
+namespace {
+
+// Below this depth, splits fall back to the median so the traversal
+// stack stays bounded whatever the input. traverse() holds at most one
+// entry per level plus one, so trees no deeper than kMaxDepth fit in its
+// stack; built trees stay well under it, loaded ones are checked.
+constexpr int kMaxSahDepth = 48;
+constexpr size_t kStackSize = 128;
+constexpr size_t kMaxDepth = kStackSize - 1;
+
+void appendBox(std::vector<float> &out, const AABB &aabb) {
+  out.insert(out.end(), {aabb.min.x, aabb.min.y, aabb.min.z, aabb.max.x,
+                         aabb.max.y, aabb.max.z});
+}
+
+AABB boxAt(const std::vector<float> &in, size_t i) {
+  const float *v = &in[i * 6];
+  return {{v[0], v[1], v[2]}, {v[3], v[4], v[5]}};
+}
+
+} // namespace
+
+StaticBVH::StaticBVH(std::span<const BroadphaseProxy> proxies) {
+  if (proxies.empty()) return;
+
+  std::vector<uint32_t> items(proxies.size());
+  std::iota(items.begin(), items.end(), 0);
+  nodes_.reserve(2 * proxies.size());
+  entities_.reserve(proxies.size());
+  boxes_.reserve(proxies.size());
+  build(items, proxies, 0);
+  buildIndex();
+}
+
+void StaticBVH::build(std::span<uint32_t> items,
+                      std::span<const BroadphaseProxy> proxies, int depth) {
+  uint32_t index = static_cast<uint32_t>(nodes_.size());
+  nodes_.emplace_back();
+
+  AABB bounds = proxies[items[0]].aabb;
+  glm::vec3 center = bounds.getCenter();
+  AABB centroids{center, center};
+  for (uint32_t item : items) {
+    bounds = bounds.merge(proxies[item].aabb);
+    centroids = centroids.extendTo(proxies[item].aabb.getCenter());
+  }
+
+  if (items.size() <= kMaxLeafSize) {
+    nodes_[index] = {bounds, static_cast<uint32_t>(entities_.size()),
+                     static_cast<uint32_t>(items.size())};
+    for (uint32_t item : items) {
+      entities_.push_back(proxies[item].entity);
+      boxes_.push_back(proxies[item].aabb);
+    }
+    return;
+  }
+
+  // Bin the centroids along each axis and take the boundary with the
+  // lowest area-weighted count on both sides.
+  glm::vec3 extent = centroids.max - centroids.min;
+  auto binOf = [&](uint32_t item, int axis) {
+    float offset = proxies[item].aabb.getCenter()[axis] -
+                   centroids.min[axis];
+    int bin = static_cast<int>(offset * (kBins / extent[axis]));
+    return std::clamp(bin, 0, kBins - 1);
+  };
+
+  int best_axis = -1;
+  int best_split = 0;
+  float best_cost = std::numeric_limits<float>::infinity();
+  for (int axis = 0; depth < kMaxSahDepth && axis < 3; axis++) {
+    if (extent[axis] <= 0.0f) continue;
+
+    std::array<AABB, kBins> bin_boxes;
+    std::array<uint32_t, kBins> bin_counts{};
+    for (uint32_t item : items) {
+      int bin = binOf(item, axis);
+      const AABB &aabb = proxies[item].aabb;
+      bin_boxes[bin] =
+          bin_counts[bin] ? bin_boxes[bin].merge(aabb) : aabb;
+      bin_counts[bin]++;
+    }
+
+    // Cost of everything from bin i up, for each split i.
+    std::array<float, kBins> right_costs{};
+    AABB right;
+    uint32_t right_count = 0;
+    for (int bin = kBins - 1; bin > 0; bin--) {
+      if (bin_counts[bin] > 0) {
+        right = right_count ? right.merge(bin_boxes[bin]) : bin_boxes[bin];
+        right_count += bin_counts[bin];
+      }
+      right_costs[bin] =
+          right_count ? right.getSurfaceArea() * right_count : 0.0f;
+    }
+
+    AABB left;
+    uint32_t left_count = 0;
+    for (int split = 1; split < kBins; split++) {
+      if (bin_counts[split - 1] > 0) {
+        left = left_count ? left.merge(bin_boxes[split - 1])
+                          : bin_boxes[split - 1];
+        left_count += bin_counts[split - 1];
+      }
+      if (left_count == 0 || left_count == items.size()) continue;
+
+      float cost = left.getSurfaceArea() * left_count + right_costs[split];
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_axis = axis;
+        best_split = split;
+      }
+    }
+  }
+
+  size_t middle = items.size() / 2;
+  if (best_axis >= 0) {
+    auto right_begin = std::partition(
+        items.begin(), items.end(),
+        [&](uint32_t item) { return binOf(item, best_axis) < best_split; });
+    middle = right_begin - items.begin();
+  } else {
+    // Centroids all coincide or the tree is too deep; any halves do.
+    int axis = 0;
+    if (extent.y > extent[axis]) axis = 1;
+    if (extent.z > extent[axis]) axis = 2;
+    std::nth_element(items.begin(), items.begin() + middle, items.end(),
+                     [&](uint32_t a, uint32_t b) {
+                       return proxies[a].aabb.getCenter()[axis] <
+                              proxies[b].aabb.getCenter()[axis];
+                     });
+  }
+
+  build(items.first(middle), proxies, depth + 1);
+  nodes_[index] = {bounds, static_cast<uint32_t>(nodes_.size()), 0};
+  build(items.subspan(middle), proxies, depth + 1);
+}
+
+void StaticBVH::buildIndex() {
+  index_.clear();
+  index_.reserve(entities_.size());
+  for (uint32_t i = 0; i < entities_.size(); i++) {
+    index_[entities_[i]] = i;
+  }
+}
+
+const AABB *StaticBVH::find(Entity entity) const {
+  const uint32_t *i = index_.find(entity);
+  return i ? &boxes_[*i] : nullptr;
+}
+
+template <typename Accept, typename Visit>
+void StaticBVH::traverse(Accept &&accept, Visit &&visit) const {
+  if (nodes_.empty()) {
+    return;
+  }
+
+  uint32_t stack[kStackSize];
+  size_t top = 0;
+  stack[top++] = 0;
+
+  while (top > 0) {
+    uint32_t index = stack[--top];
+    const Node &node = nodes_[index];
+    if (!accept(node.aabb)) {
+      continue;
+    }
+
+    if (node.count > 0) {
+      for (uint32_t i = node.first; i < node.first + node.count; i++) {
+        if (accept(boxes_[i])) visit(entities_[i]);
+      }
+    } else {
+      assert(top + 2 <= std::size(stack));
+      stack[top++] = node.first;
+      stack[top++] = index + 1;
+    }
+  }
+}
+
+void StaticBVH::query(const AABB &aabb, std::vector<Entity> &out) const {
+  traverse([&](const AABB &box) { return box.intersects(aabb); },
+           [&](Entity entity) { out.push_back(entity); });
+}
+
+void StaticBVH::queryRay(const Ray &ray, float max_distance,
+                         std::vector<Entity> &out) const {
+  traverse(
+      [&](const AABB &box) {
+        return ray.intersect(box, max_distance).has_value();
+      },
+      [&](Entity entity) { out.push_back(entity); });
+}
+
+std::optional<PropertyTree> StaticBVH::serialize() const {
+  std::vector<float> node_boxes;
+  std::vector<int32_t> node_links;
+  node_boxes.reserve(nodes_.size() * 6);
+  node_links.reserve(nodes_.size() * 2);
+  for (const Node &node : nodes_) {
+    appendBox(node_boxes, node.aabb);
+    node_links.push_back(static_cast<int32_t>(node.first));
+    node_links.push_back(static_cast<int32_t>(node.count));
+  }
+
+  std::vector<int32_t> entities(entities_.begin(), entities_.end());
+  std::vector<float> boxes;
+  boxes.reserve(boxes_.size() * 6);
+  for (const AABB &aabb : boxes_) {
+    appendBox(boxes, aabb);
+  }
+
+  return PropertyTree{"StaticBVH",
+                      {std::move(node_boxes), std::move(node_links),
+                       std::move(entities), std::move(boxes)}};
+}
+
+absl::StatusOr<StaticBVH> StaticBVH::deserialize(
+    PropertyTree const &tree) {
+  if (tree.properties.size() < 4) {
+    return absl::InvalidArgumentError("Invalid static BVH");
+  }
+  auto node_boxes =
+      TRY(extractProperty<std::vector<float>>(tree.properties[0]));
+  auto node_links =
+      TRY(extractProperty<std::vector<int32_t>>(tree.properties[1]));
+  auto entities =
+      TRY(extractProperty<std::vector<int32_t>>(tree.properties[2]));
+  auto boxes = TRY(extractProperty<std::vector<float>>(tree.properties[3]));
+
+  size_t node_count = node_links.size() / 2;
+  if (node_boxes.size() != node_count * 6 ||
+      node_links.size() != node_count * 2 ||
+      boxes.size() != entities.size() * 6 ||
+      (node_count == 0) != entities.empty()) {
+    return absl::InvalidArgumentError("Static BVH arrays don't match");
+  }
+
+  StaticBVH bvh;
+  for (size_t i = 0; i < node_count; i++) {
+    Node node{boxAt(node_boxes, i),
+              static_cast<uint32_t>(node_links[i * 2]),
+              static_cast<uint32_t>(node_links[i * 2 + 1])};
+    bool valid = node.count > 0
+                     ? node.first + uint64_t{node.count} <= entities.size()
+                     : node.first > i + 1 && node.first < node_count;
+    if (!valid) {
+      return absl::InvalidArgumentError(
+          absl::StrFormat("Static BVH node %d is out of range", i));
+    }
+    bvh.nodes_.push_back(node);
+  }
+
+  // Children come after their parents, so depths can be filled in from
+  // the back.
+  std::vector<uint32_t> depths(node_count, 0);
+  for (size_t i = node_count; i-- > 0;) {
+    const Node &node = bvh.nodes_[i];
+    if (node.count > 0) continue;
+    depths[i] = 1 + std::max(depths[i + 1], depths[node.first]);
+    if (depths[i] > kMaxDepth) {
+      return absl::InvalidArgumentError(absl::StrFormat(
+          "Static BVH is deeper than %d levels", kMaxDepth));
+    }
+  }
+  for (size_t i = 0; i < entities.size(); i++) {
+    bvh.entities_.push_back(static_cast<Entity>(entities[i]));
+    bvh.boxes_.push_back(boxAt(boxes, i));
+  }
+  bvh.buildIndex();
+  return bvh;
+}
@@ -0,0 +1,304 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <limits>
+#include <utility>
+
+#include "sunset/sweep_and_prune.h"
+
+namespace {
+
+constexpr float kInfinity = std::numeric_limits<float>::infinity();
+
+template <typename T>
+void rotateColumn(std::vector<T> &column, size_t from, size_t to) {
+  if (from < to) {
+    std::rotate(column.begin() + from, column.begin() + from + 1,
+                column.begin() + to + 1);
+  } else {
+    std::rotate(column.begin() + to, column.begin() + from,
+                column.begin() + from + 1);
+  }
+}
+
+} // namespace
+
+SweepAndPrune::SweepAndPrune(int axis) : axis_(axis) {
+  assert(axis >= 0 && axis < 3);
+}
+
+void SweepAndPrune::insert(Entity entity, const AABB &aabb) {
+  assert(!slots_.contains(entity));
+
+  uint32_t slot = allocateSlot();
+  slots_[entity] = slot;
+
+  positions_[slot] = entities_.size();
+  boxes_.push(aabb);
+  entities_.push_back(entity);
+  endpoint_slots_.push_back(slot);
+  sortFrom(entities_.size() - 1);
+}
+
+void SweepAndPrune::remove(Entity entity) {
+  auto it = slots_.find(entity);
+  if (it == slots_.end()) {
+    return;
+  }
+
+  uint32_t slot = it->second;
+  size_t index = positions_[slot];
+  boxes_.erase(index);
+  entities_.erase(entities_.begin() + index);
+  endpoint_slots_.erase(endpoint_slots_.begin() + index);
+  for (size_t i = index; i < entities_.size(); i++) {
+    positions_[endpoint_slots_[i]] = i;
+  }
+
+  free_slots_.push_back(slot);
+  slots_.erase(it);
+  refreshBlocks(index, entities_.size() + 1);
+}
+
+void SweepAndPrune::update(Entity entity, const AABB &aabb) {
+  auto it = slots_.find(entity);
+  if (it == slots_.end()) {
+    insert(entity, aabb);
+    return;
+  }
+
+  size_t index = positions_[it->second];
+  boxes_.set(index, aabb);
+  sortFrom(index);
+}
+
+void SweepAndPrune::entities(std::vector<Entity> &out) const {
+  out.insert(out.end(), entities_.begin(), entities_.end());
+}
+
+template <typename F>
+void SweepAndPrune::forEachOverlap(const AABB &box, size_t begin,
+                                   size_t end, F &&fn) const {
+  // Short runs, common with coherent motion, aren't worth a kernel call.
+  if (end - begin < kMinBatch) {
+    for (size_t i = begin; i < end; i++) {
+      if (boxes_.get(i).intersects(box)) fn(i);
+    }
+    return;
+  }
+
+  // One mask word per run of 64, so nothing is allocated per query.
+  for (size_t first = begin; first < end; first += 64) {
+    size_t last = std::min(first + 64, end);
+    uint64_t mask;
+    overlapMask(box, boxes_.view(first, last), std::span(&mask, 1));
+    forEachSetBit(std::span<const uint64_t>(&mask, 1), last - first,
+                  [&](size_t i) { fn(first + i); });
+  }
+}
+
+void SweepAndPrune::query(const AABB &aabb,
+                          std::vector<Entity> &out) const {
+  const std::vector<float> &lowers = boxes_.mins(axis_);
+  // Boxes from here on start after `aabb` ends.
+  size_t last = std::upper_bound(lowers.begin(), lowers.end(),
+                                 aabb.max[axis_]) -
+                lowers.begin();
+  if (last == 0) return;
+  size_t last_block = (last - 1) / kBlockSize;
+
+  // Depth-first over the subtrees holding blocks up to last_block whose
+  // boxes reach `aabb`. Each level pops one node and pushes at most two.
+  struct Node {
+    size_t index;
+    size_t first_block;
+    size_t blocks;
+  };
+  std::array<Node, 64> stack;
+  size_t top = 0;
+  stack[top++] = {1, 0, leaves_};
+  while (top > 0) {
+    Node node = stack[--top];
+    if (node.first_block > last_block ||
+        block_uppers_[node.index] < aabb.min[axis_]) {
+      continue;
+    }
+
+    if (node.blocks == 1) {
+      size_t begin = node.first_block * kBlockSize;
+      forEachOverlap(aabb, begin, std::min(begin + kBlockSize, last),
+                     [&](size_t i) { out.push_back(entities_[i]); });
+      continue;
+    }
+
+    size_t half = node.blocks / 2;
+    stack[top++] = {2 * node.index + 1, node.first_block + half, half};
+    stack[top++] = {2 * node.index, node.first_block, half};
+  }
+}
+
+void SweepAndPrune::queryPairs(
+    std::vector<std::pair<Entity, Entity>> &out) const {
+  const std::vector<float> &lowers = boxes_.mins(axis_);
+
+  for (size_t i = 0; i < entities_.size(); i++) {
+    AABB box = boxes_.get(i);
+    size_t end = i + 1;
+    while (end < entities_.size() && lowers[end] <= box.max[axis_]) {
+      end++;
+    }
+
+    forEachOverlap(box, i + 1, end, [&](size_t j) {
+      out.push_back(std::minmax(entities_[i], entities_[j]));
+    });
+  }
+}
+
+void SweepAndPrune::sync(std::span<const BroadphaseProxy> proxies) {
+  std::vector<bool> live(positions_.size(), false);
+  std::vector<BroadphaseProxy> added;
+
+  for (const BroadphaseProxy &proxy : proxies) {
+    auto it = slots_.find(proxy.entity);
+    if (it == slots_.end()) {
+      added.push_back(proxy);
+      continue;
+    }
+    boxes_.set(positions_[it->second], proxy.aabb);
+    live[it->second] = true;
+  }
+
+  // Sort (lower bound, source) keys rather than the entries themselves,
+  // then gather every column once. Sources past the old entries are the
+  // added ones.
+  std::vector<std::pair<float, uint32_t>> order;
+  order.reserve(entities_.size() + added.size());
+  for (uint32_t i = 0; i < entities_.size(); i++) {
+    if (live[endpoint_slots_[i]]) {
+      order.emplace_back(lower(i), i);
+    } else {
+      slots_.erase(entities_[i]);
+      free_slots_.push_back(endpoint_slots_[i]);
+    }
+  }
+
+  // Coherent motion leaves the array nearly sorted, where insertion sort
+  // is linear.
+  for (size_t i = 1; i < order.size(); i++) {
+    std::pair<float, uint32_t> moving = order[i];
+    size_t j = i;
+    for (; j > 0 && order[j - 1].first > moving.first; j--) {
+      order[j] = order[j - 1];
+    }
+    order[j] = moving;
+  }
+
+  auto by_lower = [](const auto &a, const auto &b) {
+    return a.first < b.first;
+  };
+  size_t middle = order.size();
+  uint32_t first_added = static_cast<uint32_t>(entities_.size());
+  for (uint32_t i = 0; i < added.size(); i++) {
+    order.emplace_back(added[i].aabb.min[axis_], first_added + i);
+  }
+  std::sort(order.begin() + middle, order.end(), by_lower);
+  std::inplace_merge(order.begin(), order.begin() + middle, order.end(),
+                     by_lower);
+
+  AABBBatch boxes;
+  std::vector<Entity> entities;
+  std::vector<uint32_t> endpoint_slots;
+  boxes.resize(order.size());
+  entities.resize(order.size());
+  endpoint_slots.resize(order.size());
+
+  for (size_t i = 0; i < order.size(); i++) {
+    uint32_t source = order[i].second;
+    AABB aabb;
+    if (source < first_added) {
+      aabb = boxes_.get(source);
+      entities[i] = entities_[source];
+      endpoint_slots[i] = endpoint_slots_[source];
+    } else {
+      const BroadphaseProxy &proxy = added[source - first_added];
+      aabb = proxy.aabb;
+      entities[i] = proxy.entity;
+      endpoint_slots[i] = allocateSlot();
+      slots_[proxy.entity] = endpoint_slots[i];
+    }
+    boxes.set(i, aabb);
+    positions_[endpoint_slots[i]] = i;
+  }
+
+  boxes_ = std::move(boxes);
+  entities_ = std::move(entities);
+  endpoint_slots_ = std::move(endpoint_slots);
+  clearBlocks();
+  refreshBlocks(0, entities_.size());
+}
+
+uint32_t SweepAndPrune::allocateSlot() {
+  if (free_slots_.empty()) {
+    positions_.push_back(0);
+    return static_cast<uint32_t>(positions_.size() - 1);
+  }
+
+  uint32_t slot = free_slots_.back();
+  free_slots_.pop_back();
+  return slot;
+}
+
+void SweepAndPrune::moveEntry(size_t from, size_t to) {
+  if (from == to) {
+    return;
+  }
+  boxes_.rotate(from, to);
+  rotateColumn(entities_, from, to);
+  rotateColumn(endpoint_slots_, from, to);
+}
+
+void SweepAndPrune::sortFrom(size_t index) {
+  float value = lower(index);
+
+  size_t target = index;
+  while (target > 0 && lower(target - 1) > value) target--;
+  while (target + 1 < entities_.size() && lower(target + 1) < value) {
+    target++;
+  }
+
+  moveEntry(index, target);
+  for (size_t i = std::min(index, target); i <= std::max(index, target);
+       i++) {
+    positions_[endpoint_slots_[i]] = i;
+  }
+  refreshBlocks(std::min(index, target), std::max(index, target) + 1);
+}
+
+void SweepAndPrune::refreshBlocks(size_t begin, size_t end) {
+  size_t blocks = (entities_.size() + kBlockSize - 1) / kBlockSize;
+  if (leaves_ == 0 || blocks > leaves_) {
+    leaves_ = std::bit_ceil(std::max<size_t>(blocks, 1));
+    block_uppers_.assign(2 * leaves_, -kInfinity);
+    begin = 0;
+    end = entities_.size();
+  }
+
+  const std::vector<float> &uppers = boxes_.maxs(axis_);
+  for (size_t block = begin / kBlockSize;
+       block < leaves_ && block * kBlockSize < end; block++) {
+    float upper = -kInfinity;
+    size_t block_end =
+        std::min((block + 1) * kBlockSize, entities_.size());
+    for (size_t i = block * kBlockSize; i < block_end; i++) {
+      upper = std::max(upper, uppers[i]);
+    }
+
+    size_t node = leaves_ + block;
+    block_uppers_[node] = upper;
+    for (node /= 2; node > 0; node /= 2) {
+      block_uppers_[node] =
+          std::max(block_uppers_[2 * node], block_uppers_[2 * node + 1]);
+    }
+  }
+}
@@ -0,0 +1,84 @@
+#include <algorithm>
+
+#include "sunset/thread_pool.h"
+
+ThreadPool::ThreadPool(size_t workers) {
+  workers_.reserve(workers);
+  for (size_t i = 0; i < workers; i++) {
+    workers_.emplace_back([this] { workerLoop(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard guard(mutex_);
+    stopping_ = true;
+  }
+  work_ready_.notify_all();
+  for (std::thread &worker : workers_) {
+    worker.join();
+  }
+}
+
+ThreadPool &ThreadPool::instance() {
+  static ThreadPool pool(
+      std::max(std::thread::hardware_concurrency(), 1u) - 1);
+  return pool;
+}
+
+void ThreadPool::parallelFor(size_t count, size_t grain,
+                             const RangeFn &fn) {
+  grain = std::max<size_t>(grain, 1);
+  if (workers_.empty() || count <= grain) {
+    if (count > 0) fn(0, count);
+    return;
+  }
+
+  std::lock_guard loop_guard(loop_mutex_);
+  std::unique_lock lock(mutex_);
+
+  chunks_ = std::min(concurrency() * 4, (count + grain - 1) / grain);
+  chunk_ = (count + chunks_ - 1) / chunks_;
+  chunks_ = (count + chunk_ - 1) / chunk_;
+  fn_ = &fn;
+  count_ = count;
+  next_chunk_ = 0;
+  finished_ = 0;
+  generation_++;
+  work_ready_.notify_all();
+
+  runChunks(lock);
+  work_done_.wait(lock, [this] { return finished_ == chunks_; });
+  fn_ = nullptr;
+}
+
+void ThreadPool::workerLoop() {
+  uint64_t seen = 0;
+  std::unique_lock lock(mutex_);
+
+  while (true) {
+    work_ready_.wait(
+        lock, [&] { return stopping_ || generation_ != seen; });
+    if (stopping_) {
+      return;
+    }
+    seen = generation_;
+    runChunks(lock);
+  }
+}
+
+void ThreadPool::runChunks(std::unique_lock<std::mutex> &lock) {
+  while (fn_ != nullptr && next_chunk_ < chunks_) {
+    size_t begin = next_chunk_++ * chunk_;
+    size_t end = std::min(begin + chunk_, count_);
+    const RangeFn &fn = *fn_;
+
+    lock.unlock();
+    fn(begin, end);
+    lock.lock();
+
+    if (++finished_ == chunks_) {
+      work_done_.notify_all();
+    }
+  }
+}
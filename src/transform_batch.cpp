@@ -0,0 +1,324 @@
+#include <cassert>
+
+#include "sunset/aabb_batch.h"
+
+#include "sunset/transform_batch.h"
+
+namespace {
+
+// The rotation part follows glm's mat3_cast term for term, so the scalar
+// kernel reproduces glm::toMat4 exactly.
+void composeScalar(const TRSBatch::View &transforms, size_t begin,
+                   std::span<glm::mat4> out) {
+  for (size_t i = begin; i < transforms.size; i++) {
+    float x = transforms.rotation_x[i];
+    float y = transforms.rotation_y[i];
+    float z = transforms.rotation_z[i];
+    float w = transforms.rotation_w[i];
+    float s = transforms.scale[i];
+
+    float xx = x * x, yy = y * y, zz = z * z;
+    float xy = x * y, xz = x * z, yz = y * z;
+    float wx = w * x, wy = w * y, wz = w * z;
+
+    glm::mat4 &m = out[i];
+    m[0] = glm::vec4(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz),
+                     2.0f * (xz - wy), 0.0f) *
+           s;
+    m[1] = glm::vec4(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz),
+                     2.0f * (yz + wx), 0.0f) *
+           s;
+    m[2] = glm::vec4(2.0f * (xz + wy), 2.0f * (yz - wx),
+                     1.0f - 2.0f * (xx + yy), 0.0f) *
+           s;
+    m[3] = glm::vec4(transforms.position_x[i], transforms.position_y[i],
+                     transforms.position_z[i], 1.0f);
+  }
+}
+
+// Only the upper 3x3 and the translation are multiplied; the last rows
+// are known to be 0 0 0 1.
+void multiplyScalar(std::span<const glm::mat4> parents,
+                    std::span<const glm::mat4> locals,
+                    std::span<glm::mat4> out) {
+  for (size_t i = 0; i < out.size(); i++) {
+    const glm::mat4 &parent = parents[i];
+    glm::mat4 local = locals[i];
+    for (int column = 0; column < 4; column++) {
+      out[i][column] = parent[0] * local[column].x +
+                       parent[1] * local[column].y +
+                       parent[2] * local[column].z;
+    }
+    out[i][3] += parent[3];
+  }
+}
+
+#ifdef SUNSET_X86_SIMD
+
+// Column `column` of four matrices, given one element per register: lane
+// k of `e0` is element 0 of matrix k's column, and so on.
+void storeColumnsSSE(__m128 e0, __m128 e1, __m128 e2, __m128 e3,
+                     glm::mat4 *out, int column) {
+  _MM_TRANSPOSE4_PS(e0, e1, e2, e3);
+  _mm_storeu_ps(&out[0][column][0], e0);
+  _mm_storeu_ps(&out[1][column][0], e1);
+  _mm_storeu_ps(&out[2][column][0], e2);
+  _mm_storeu_ps(&out[3][column][0], e3);
+}
+
+void composeSSE(const TRSBatch::View &transforms,
+                std::span<glm::mat4> out) {
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 two = _mm_set1_ps(2.0f);
+  size_t i = 0;
+  for (; i + 4 <= transforms.size; i += 4) {
+    __m128 x = _mm_loadu_ps(transforms.rotation_x + i);
+    __m128 y = _mm_loadu_ps(transforms.rotation_y + i);
+    __m128 z = _mm_loadu_ps(transforms.rotation_z + i);
+    __m128 w = _mm_loadu_ps(transforms.rotation_w + i);
+    __m128 s = _mm_loadu_ps(transforms.scale + i);
+
+    __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y);
+    __m128 zz = _mm_mul_ps(z, z), xy = _mm_mul_ps(x, y);
+    __m128 xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+    __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y);
+    __m128 wz = _mm_mul_ps(w, z);
+
+    storeColumnsSSE(
+        _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))),
+                   s),
+        _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), s),
+        _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), s), zero,
+        &out[i], 0);
+    storeColumnsSSE(
+        _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), s),
+        _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))),
+                   s),
+        _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), s), zero,
+        &out[i], 1);
+    storeColumnsSSE(
+        _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), s),
+        _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), s),
+        _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))),
+                   s),
+        zero, &out[i], 2);
+    storeColumnsSSE(_mm_loadu_ps(transforms.position_x + i),
+                    _mm_loadu_ps(transforms.position_y + i),
+                    _mm_loadu_ps(transforms.position_z + i), one, &out[i],
+                    3);
+  }
+  composeScalar(transforms, i, out);
+}
+
+void multiplySSE(std::span<const glm::mat4> parents,
+                 std::span<const glm::mat4> locals,
+                 std::span<glm::mat4> out) {
+  for (size_t i = 0; i < out.size(); i++) {
+    const float *parent = &parents[i][0][0];
+    __m128 p0 = _mm_loadu_ps(parent);
+    __m128 p1 = _mm_loadu_ps(parent + 4);
+    __m128 p2 = _mm_loadu_ps(parent + 8);
+    __m128 p3 = _mm_loadu_ps(parent + 12);
+
+    // All of the local matrix is read before `out`, which may be it, is
+    // written.
+    __m128 local[4];
+    for (int column = 0; column < 4; column++) {
+      local[column] = _mm_loadu_ps(&locals[i][column][0]);
+    }
+    for (int column = 0; column < 4; column++) {
+      __m128 l = local[column];
+      __m128 c = _mm_add_ps(
+          _mm_add_ps(
+              _mm_mul_ps(p0, _mm_shuffle_ps(l, l, _MM_SHUFFLE(0, 0, 0, 0))),
+              _mm_mul_ps(p1,
+                         _mm_shuffle_ps(l, l, _MM_SHUFFLE(1, 1, 1, 1)))),
+          _mm_mul_ps(p2, _mm_shuffle_ps(l, l, _MM_SHUFFLE(2, 2, 2, 2))));
+      if (column == 3) c = _mm_add_ps(c, p3);
+      _mm_storeu_ps(&out[i][column][0], c);
+    }
+  }
+}
+
+// As storeColumnsSSE, for eight matrices.
+__attribute__((target("avx2"))) void storeColumnsAVX2(
+    __m256 e0, __m256 e1, __m256 e2, __m256 e3, glm::mat4 *out,
+    int column) {
+  __m256 t0 = _mm256_unpacklo_ps(e0, e1);
+  __m256 t1 = _mm256_unpackhi_ps(e0, e1);
+  __m256 t2 = _mm256_unpacklo_ps(e2, e3);
+  __m256 t3 = _mm256_unpackhi_ps(e2, e3);
+  // Each register holds the column of matrix k in its low half and that
+  // of matrix k + 4 in its high half.
+  __m256 columns[4] = {
+      _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)),
+      _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2)),
+      _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)),
+      _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2)),
+  };
+  for (int k = 0; k < 4; k++) {
+    _mm_storeu_ps(&out[k][column][0], _mm256_castps256_ps128(columns[k]));
+    _mm_storeu_ps(&out[k + 4][column][0],
+                  _mm256_extractf128_ps(columns[k], 1));
+  }
+}
+
+__attribute__((target("avx2"))) void composeAVX2(
+    const TRSBatch::View &transforms, std::span<glm::mat4> out) {
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 two = _mm256_set1_ps(2.0f);
+  size_t i = 0;
+  for (; i + 8 <= transforms.size; i += 8) {
+    __m256 x = _mm256_loadu_ps(transforms.rotation_x + i);
+    __m256 y = _mm256_loadu_ps(transforms.rotation_y + i);
+    __m256 z = _mm256_loadu_ps(transforms.rotation_z + i);
+    __m256 w = _mm256_loadu_ps(transforms.rotation_w + i);
+    __m256 s = _mm256_loadu_ps(transforms.scale + i);
+
+    __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y);
+    __m256 zz = _mm256_mul_ps(z, z), xy = _mm256_mul_ps(x, y);
+    __m256 xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+    __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y);
+    __m256 wz = _mm256_mul_ps(w, z);
+
+    storeColumnsAVX2(
+        _mm256_mul_ps(
+            _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz))),
+            s),
+        _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xy, wz)), s),
+        _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xz, wy)), s), zero,
+        &out[i], 0);
+    storeColumnsAVX2(
+        _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), s),
+        _mm256_mul_ps(
+            _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz))),
+            s),
+        _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(yz, wx)), s), zero,
+        &out[i], 1);
+    storeColumnsAVX2(
+        _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xz, wy)), s),
+        _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), s),
+        _mm256_mul_ps(
+            _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy))),
+            s),
+        zero, &out[i], 2);
+    storeColumnsAVX2(_mm256_loadu_ps(transforms.position_x + i),
+                     _mm256_loadu_ps(transforms.position_y + i),
+                     _mm256_loadu_ps(transforms.position_z + i), one,
+                     &out[i], 3);
+  }
+  composeScalar(transforms, i, out);
+}
+
+// Two columns of the result per register, each parent column broadcast
+// to both halves.
+__attribute__((target("avx2"))) void multiplyAVX2(
+    std::span<const glm::mat4> parents, std::span<const glm::mat4> locals,
+    std::span<glm::mat4> out) {
+  for (size_t i = 0; i < out.size(); i++) {
+    const float *parent = &parents[i][0][0];
+    __m256 p0 = _mm256_broadcast_ps(
+        reinterpret_cast<const __m128 *>(parent));
+    __m256 p1 = _mm256_broadcast_ps(
+        reinterpret_cast<const __m128 *>(parent + 4));
+    __m256 p2 = _mm256_broadcast_ps(
+        reinterpret_cast<const __m128 *>(parent + 8));
+    // The translation only goes into the last column.
+    __m256 p3 = _mm256_blend_ps(
+        _mm256_setzero_ps(),
+        _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(parent + 12)),
+        0xF0);
+
+    __m256 local[2] = {_mm256_loadu_ps(&locals[i][0][0]),
+                       _mm256_loadu_ps(&locals[i][2][0])};
+    for (int half = 0; half < 2; half++) {
+      __m256 l = local[half];
+      __m256 c = _mm256_add_ps(
+          _mm256_add_ps(
+              _mm256_mul_ps(p0,
+                            _mm256_permute_ps(l, _MM_SHUFFLE(0, 0, 0, 0))),
+              _mm256_mul_ps(p1,
+                            _mm256_permute_ps(l, _MM_SHUFFLE(1, 1, 1, 1)))),
+          _mm256_mul_ps(p2, _mm256_permute_ps(l, _MM_SHUFFLE(2, 2, 2, 2))));
+      if (half == 1) c = _mm256_add_ps(c, p3);
+      _mm256_storeu_ps(&out[i][2 * half][0], c);
+    }
+  }
+}
+
+#endif
+
+} // namespace
+
+void TRSBatch::clear() {
+  for (std::vector<float> *column :
+       {&position_x_, &position_y_, &position_z_, &rotation_x_,
+        &rotation_y_, &rotation_z_, &rotation_w_, &scale_}) {
+    column->clear();
+  }
+}
+
+void TRSBatch::reserve(size_t count) {
+  for (std::vector<float> *column :
+       {&position_x_, &position_y_, &position_z_, &rotation_x_,
+        &rotation_y_, &rotation_z_, &rotation_w_, &scale_}) {
+    column->reserve(count);
+  }
+}
+
+void TRSBatch::push(const glm::vec3 &position, const glm::quat &rotation,
+                    float scale) {
+  position_x_.push_back(position.x);
+  position_y_.push_back(position.y);
+  position_z_.push_back(position.z);
+  rotation_x_.push_back(rotation.x);
+  rotation_y_.push_back(rotation.y);
+  rotation_z_.push_back(rotation.z);
+  rotation_w_.push_back(rotation.w);
+  scale_.push_back(scale);
+}
+
+TRSBatch::View TRSBatch::view() const {
+  return {position_x_.data(), position_y_.data(), position_z_.data(),
+          rotation_x_.data(), rotation_y_.data(), rotation_z_.data(),
+          rotation_w_.data(), scale_.data(),      size()};
+}
+
+void composeTRS(const TRSBatch::View &transforms,
+                std::span<glm::mat4> out) {
+  assert(out.size() >= transforms.size);
+
+  switch (simdLevel()) {
+#ifdef SUNSET_X86_SIMD
+    case SimdLevel::AVX2:
+      composeAVX2(transforms, out);
+      return;
+    case SimdLevel::SSE:
+      composeSSE(transforms, out);
+      return;
+#endif
+    default:
+      composeScalar(transforms, 0, out);
+  }
+}
+
+void multiplyAffine(std::span<const glm::mat4> parents,
+                    std::span<const glm::mat4> locals,
+                    std::span<glm::mat4> out) {
+  assert(parents.size() >= out.size() && locals.size() >= out.size());
+
+  switch (simdLevel()) {
+#ifdef SUNSET_X86_SIMD
+    case SimdLevel::AVX2:
+      multiplyAVX2(parents, locals, out);
+      return;
+    case SimdLevel::SSE:
+      multiplySSE(parents, locals, out);
+      return;
+#endif
+    default:
+      multiplyScalar(parents, locals, out);
+  }
+}
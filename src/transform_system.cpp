@@ -0,0 +1,73 @@
+#include <algorithm>
+
+#include "sunset/transform_system.h"
+
+namespace {
+
+// Whether the blended pose differs from the current one.
+bool interpolating(const Transform &transform, float alpha) {
+  return alpha < 1.0f && transform.previous &&
+         (transform.previous->position != transform.position ||
+          transform.previous->rotation != transform.rotation);
+}
+
+} // namespace
+
+void TransformSystem::update(ECS &ecs, float alpha) {
+  changed_.clear();
+  ecs.forEach(std::function([&](Entity entity, Transform *root) {
+    if (root->parent.has_value()) return;
+
+    stack_.assign(1, {entity, nullptr, -1});
+    while (!stack_.empty()) {
+      Pending pending = stack_.back();
+      stack_.pop_back();
+      Transform *transform = ecs.getComponent<Transform>(pending.entity);
+      if (!transform) continue;
+
+      bool blended = interpolating(*transform, alpha);
+      bool changed =
+          pending.parent_depth >= 0 || transform->dirty || blended;
+      int depth = pending.parent_depth + 1;
+      if (changed) changed_.push_back({transform, pending.parent, depth});
+      // A blended matrix is stale as soon as alpha moves on.
+      transform->dirty = blended;
+
+      for (Entity child : transform->children) {
+        stack_.push_back({child, transform, changed ? depth : -1});
+      }
+    }
+  }));
+
+  std::stable_sort(changed_.begin(), changed_.end(),
+                   [](const Changed &a, const Changed &b) {
+                     return a.depth < b.depth;
+                   });
+
+  poses_.clear();
+  for (const Changed &changed : changed_) {
+    const Transform &transform = *changed.transform;
+    poses_.push(transform.interpolatedPosition(alpha),
+                transform.interpolatedRotation(alpha), transform.scale);
+  }
+  matrices_.resize(changed_.size());
+  composeTRS(poses_.view(), matrices_);
+
+  // Parents at one depth are all done before the next one starts, so
+  // each level is a single batch.
+  parents_.resize(changed_.size());
+  for (size_t begin = 0, end = 0; begin < changed_.size(); begin = end) {
+    while (end < changed_.size() &&
+           changed_[end].depth == changed_[begin].depth) {
+      const Transform *parent = changed_[end].parent;
+      parents_[end] = parent ? parent->cached_model : glm::mat4(1.0f);
+      end++;
+    }
+    std::span<glm::mat4> level(matrices_.data() + begin, end - begin);
+    multiplyAffine(std::span(parents_).subspan(begin, end - begin), level,
+                   level);
+    for (size_t i = begin; i < end; i++) {
+      changed_[i].transform->cached_model = matrices_[i];
+    }
+  }
+}
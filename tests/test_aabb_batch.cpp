@@ -0,0 +1,106 @@
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "sunset/aabb_batch.h"
+
+namespace {
+
+AABB randomBox(std::mt19937 &rng) {
+  std::uniform_real_distribution<float> pos(-10.0f, 10.0f);
+  std::uniform_real_distribution<float> size(0.0f, 4.0f);
+  glm::vec3 min{pos(rng), pos(rng), pos(rng)};
+  return {min, min + glm::vec3(size(rng), size(rng), size(rng))};
+}
+
+// Every level the CPU has must match the scalar kernels exactly, for
+// batch sizes that exercise the vector tails.
+class AABBBatchTest : public ::testing::TestWithParam<SimdLevel> {
+ protected:
+  void SetUp() override {
+    if (GetParam() > detectSimdLevel()) {
+      GTEST_SKIP() << "CPU lacks this instruction set";
+    }
+  }
+
+  void TearDown() override { setSimdLevel(detectSimdLevel()); }
+};
+
+TEST_P(AABBBatchTest, MatchesScalar) {
+  std::mt19937 rng(7);
+
+  for (size_t count : {0, 1, 3, 4, 7, 8, 63, 64, 65, 131}) {
+    AABBBatch batch;
+    for (size_t i = 0; i < count; i++) {
+      batch.push(randomBox(rng));
+    }
+    // Boxes sharing a face with the query still overlap.
+    AABB box = randomBox(rng);
+    if (count > 2) {
+      AABB touching = batch.get(2);
+      touching.min.x = box.max.x;
+      batch.set(2, touching);
+    }
+
+    Ray ray{box.getCenter(),
+            glm::vec3(1.0f, -0.5f, count % 2 == 0 ? 0.0f : 0.25f)};
+
+    setSimdLevel(SimdLevel::Scalar);
+    std::vector<uint64_t> scalar_mask(maskWords(count));
+    std::vector<float> scalar_hits(count);
+    overlapMask(box, batch.view(), scalar_mask);
+    raySlabs(ray, 20.0f, batch.view(), scalar_hits);
+
+    setSimdLevel(GetParam());
+    std::vector<uint64_t> mask(maskWords(count), ~uint64_t{0});
+    std::vector<float> hits(count);
+    overlapMask(box, batch.view(), mask);
+    raySlabs(ray, 20.0f, batch.view(), hits);
+
+    EXPECT_EQ(mask, scalar_mask);
+    for (size_t i = 0; i < count; i++) {
+      EXPECT_EQ((mask[i / 64] >> (i % 64)) & 1,
+                batch.get(i).intersects(box) ? 1u : 0u);
+      EXPECT_EQ(hits[i], scalar_hits[i]);
+    }
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(Levels, AABBBatchTest,
+                         ::testing::Values(SimdLevel::Scalar,
+                                           SimdLevel::SSE,
+                                           SimdLevel::AVX2));
+
+TEST(AABBBatch, RaySlabsMatchRayIntersect) {
+  AABBBatch batch;
+  batch.push({glm::vec3(2.0f, -1.0f, -1.0f), glm::vec3(3.0f, 1.0f, 1.0f)});
+  batch.push({glm::vec3(-1.0f), glm::vec3(1.0f)});
+  batch.push({glm::vec3(2.0f, 2.0f, -1.0f), glm::vec3(3.0f, 3.0f, 1.0f)});
+  batch.push({glm::vec3(9.0f, -1.0f, -1.0f), glm::vec3(10.0f, 1.0f, 1.0f)});
+
+  Ray ray{glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f)};
+  std::vector<float> hits(batch.size());
+  raySlabs(ray, 5.0f, batch.view(), hits);
+
+  float miss = std::numeric_limits<float>::infinity();
+  EXPECT_EQ(hits, (std::vector<float>{2.0f, 0.0f, miss, miss}));
+}
+
+TEST(AABBBatch, RotateKeepsColumnsTogether) {
+  AABBBatch batch;
+  for (int i = 0; i < 5; i++) {
+    batch.push({glm::vec3(static_cast<float>(i)),
+                glm::vec3(static_cast<float>(i) + 0.5f)});
+  }
+
+  batch.rotate(4, 1);
+  EXPECT_EQ(batch.mins(1), (std::vector<float>{0, 4, 1, 2, 3}));
+  EXPECT_EQ(batch.get(1).max, glm::vec3(4.5f));
+
+  batch.erase(1);
+  EXPECT_EQ(batch.mins(2), (std::vector<float>{0, 1, 2, 3}));
+}
+
+} // namespace
@@ -0,0 +1,326 @@
+#include <algorithm>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "sunset/aabb_tree.h"
+#include "sunset/hash_grid.h"
+#include "sunset/octree.h"
+#include "sunset/static_bvh.h"
+#include "sunset/sweep_and_prune.h"
+
+namespace {
+
+AABB randomBox(std::mt19937 &rng, float extent, float max_size) {
+  std::uniform_real_distribution<float> pos(-extent, extent);
+  std::uniform_real_distribution<float> size(0.01f, max_size);
+  glm::vec3 min{pos(rng), pos(rng), pos(rng)};
+  return {min, min + glm::vec3(size(rng), size(rng), size(rng))};
+}
+
+std::vector<Entity> bruteForce(const std::vector<BroadphaseProxy> &proxies,
+                               const AABB &query) {
+  std::vector<Entity> out;
+  for (const BroadphaseProxy &proxy : proxies) {
+    if (proxy.aabb.intersects(query)) out.push_back(proxy.entity);
+  }
+  return out;
+}
+
+std::vector<Entity> bruteForceRay(
+    const std::vector<BroadphaseProxy> &proxies, const Ray &ray,
+    float max_distance) {
+  std::vector<Entity> out;
+  for (const BroadphaseProxy &proxy : proxies) {
+    if (ray.intersect(proxy.aabb, max_distance)) {
+      out.push_back(proxy.entity);
+    }
+  }
+  return out;
+}
+
+// The broadphase may report extra candidates, but never miss one.
+void expectSuperset(std::vector<Entity> found,
+                    std::vector<Entity> expected) {
+  std::sort(found.begin(), found.end());
+  std::sort(expected.begin(), expected.end());
+  EXPECT_TRUE(std::includes(found.begin(), found.end(), expected.begin(),
+                            expected.end()));
+  EXPECT_EQ(std::adjacent_find(found.begin(), found.end()), found.end());
+}
+
+void checkBroadphase(Broadphase &broadphase) {
+  std::mt19937 rng(1234);
+  std::vector<BroadphaseProxy> proxies;
+  for (Entity e = 1; e <= 500; e++) {
+    proxies.push_back({e, randomBox(rng, 50.0f, 2.0f)});
+    broadphase.insert(e, proxies.back().aabb);
+  }
+  EXPECT_EQ(broadphase.size(), proxies.size());
+
+  for (size_t step = 0; step < 20; step++) {
+    std::uniform_real_distribution<float> jitter(-0.5f, 0.5f);
+    for (BroadphaseProxy &proxy : proxies) {
+      proxy.aabb = proxy.aabb.translate(
+          glm::vec3(jitter(rng), jitter(rng), jitter(rng)));
+      broadphase.update(proxy.entity, proxy.aabb);
+    }
+
+    for (size_t i = 0; i < 20; i++) {
+      AABB query = randomBox(rng, 50.0f, 10.0f);
+      std::vector<Entity> found;
+      broadphase.query(query, found);
+      expectSuperset(found, bruteForce(proxies, query));
+    }
+
+    std::uniform_real_distribution<float> coord(-50.0f, 50.0f);
+    for (size_t i = 0; i < 20; i++) {
+      Ray ray{{coord(rng), coord(rng), coord(rng)},
+              {coord(rng), coord(rng), coord(rng)}};
+      std::vector<Entity> found;
+      broadphase.queryRay(ray, 1.0f, found);
+      expectSuperset(found, bruteForceRay(proxies, ray, 1.0f));
+    }
+  }
+
+  std::vector<std::pair<Entity, Entity>> pairs;
+  broadphase.queryPairs(pairs);
+  std::sort(pairs.begin(), pairs.end());
+  EXPECT_EQ(std::adjacent_find(pairs.begin(), pairs.end()), pairs.end());
+  for (size_t i = 0; i < proxies.size(); i++) {
+    for (size_t j = i + 1; j < proxies.size(); j++) {
+      if (!proxies[i].aabb.intersects(proxies[j].aabb)) continue;
+      std::pair<Entity, Entity> pair{proxies[i].entity, proxies[j].entity};
+      EXPECT_NE(std::find(pairs.begin(), pairs.end(), pair), pairs.end());
+    }
+  }
+
+  // Drop every other body through sync.
+  std::vector<BroadphaseProxy> kept;
+  for (size_t i = 0; i < proxies.size(); i += 2) {
+    kept.push_back(proxies[i]);
+  }
+  broadphase.sync(kept);
+  EXPECT_EQ(broadphase.size(), kept.size());
+  EXPECT_FALSE(broadphase.contains(proxies[1].entity));
+
+  std::vector<Entity> found;
+  broadphase.query(AABB{glm::vec3(-100.0f), glm::vec3(100.0f)}, found);
+  EXPECT_EQ(found.size(), kept.size());
+
+  // Move the rest and bring back the dropped ones in one sync.
+  for (BroadphaseProxy &proxy : proxies) {
+    proxy.aabb = proxy.aabb.translate(glm::vec3(1.0f, 0.0f, 0.0f));
+  }
+  broadphase.sync(proxies);
+  EXPECT_EQ(broadphase.size(), proxies.size());
+  for (size_t i = 0; i < 20; i++) {
+    AABB query = randomBox(rng, 50.0f, 10.0f);
+    found.clear();
+    broadphase.query(query, found);
+    expectSuperset(found, bruteForce(proxies, query));
+  }
+}
+
+} // namespace
+
+TEST(TestBroadphase, DynamicAABBTree) {
+  DynamicAABBTree tree;
+  checkBroadphase(tree);
+}
+
+TEST(TestBroadphase, DynamicAABBTreeStaysBalanced) {
+  DynamicAABBTree tree(0.0f);
+  // Sorted inserts degenerate into a list without rotations.
+  for (Entity e = 1; e <= 1024; e++) {
+    glm::vec3 min{static_cast<float>(e), 0.0f, 0.0f};
+    tree.insert(e, {min, min + glm::vec3(0.5f)});
+  }
+  EXPECT_LE(tree.height(), 20);
+}
+
+TEST(TestBroadphase, SweepAndPrune) {
+  SweepAndPrune sap;
+  checkBroadphase(sap);
+}
+
+TEST(TestBroadphase, SweepAndPruneAlongZ) {
+  SweepAndPrune sap(2);
+  checkBroadphase(sap);
+}
+
+// A conveyor along the sweep axis sorts first and overlaps queries far
+// from its lower bound.
+TEST(TestBroadphase, SweepAndPruneLongBox) {
+  SweepAndPrune sap;
+  std::mt19937 rng(7);
+  std::vector<BroadphaseProxy> proxies = {
+      {1, AABB{{-100.0f, -1.0f, -1.0f}, {100.0f, 1.0f, 1.0f}}}};
+  sap.insert(1, proxies[0].aabb);
+  for (Entity e = 2; e <= 300; e++) {
+    proxies.push_back({e, randomBox(rng, 50.0f, 2.0f)});
+    sap.insert(e, proxies.back().aabb);
+  }
+
+  for (int step = 0; step < 2; step++) {
+    for (size_t i = 0; i < 50; i++) {
+      AABB query = randomBox(rng, 50.0f, 10.0f);
+      std::vector<Entity> found;
+      sap.query(query, found);
+      expectSuperset(found, bruteForce(proxies, query));
+    }
+    // Then shrink it and drop a few boxes.
+    proxies[0].aabb.max.x = -90.0f;
+    sap.update(1, proxies[0].aabb);
+    for (size_t i = 0; i < 10; i++) {
+      sap.remove(proxies.back().entity);
+      proxies.pop_back();
+    }
+  }
+
+  std::vector<Entity> found;
+  sap.query(AABB{{40.0f, -1.0f, -1.0f}, {41.0f, 1.0f, 1.0f}}, found);
+  EXPECT_EQ(std::find(found.begin(), found.end(), 1), found.end());
+}
+
+TEST(TestBroadphase, HashGrid) {
+  HashGrid grid;
+  checkBroadphase(grid);
+}
+
+TEST(TestBroadphase, HashGridCoarseCells) {
+  HashGrid grid(8.0f);
+  checkBroadphase(grid);
+}
+
+TEST(TestBroadphase, LooseOcTree) {
+  LooseOcTree octree(AABB{glm::vec3(-64.0f), glm::vec3(64.0f)});
+  checkBroadphase(octree);
+}
+
+TEST(TestBroadphase, LooseOcTreeKeepsOutsideBoxes) {
+  LooseOcTree octree(AABB{glm::vec3(-1.0f), glm::vec3(1.0f)});
+  AABB far{glm::vec3(100.0f), glm::vec3(101.0f)};
+  octree.insert(1, far);
+
+  std::vector<Entity> found;
+  octree.query(far, found);
+  EXPECT_EQ(found, std::vector<Entity>{1});
+
+  octree.move(1, AABB{glm::vec3(0.0f), glm::vec3(0.1f)});
+  found.clear();
+  octree.query(far, found);
+  EXPECT_TRUE(found.empty());
+}
+
+TEST(TestBroadphase, LooseOcTreeRaycastAndFrustum) {
+  LooseOcTree octree(AABB{glm::vec3(-64.0f), glm::vec3(64.0f)});
+  for (Entity e = 1; e <= 10; e++) {
+    glm::vec3 min{static_cast<float>(e) * 4.0f, 0.0f, 0.0f};
+    octree.insert(e, {min, min + glm::vec3(1.0f)});
+  }
+
+  std::vector<RayHit> hits;
+  octree.raycast({glm::vec3(0.0f, 0.5f, 0.5f), glm::vec3(1.0f, 0.0f, 0.0f)},
+                 14.0f, hits);
+  ASSERT_EQ(hits.size(), 3u);
+  EXPECT_EQ(hits[0].entity, 1u);
+  EXPECT_FLOAT_EQ(hits[0].distance, 4.0f);
+  EXPECT_EQ(hits[2].entity, 3u);
+
+  // Slab x in [10, 22].
+  Frustum frustum{};
+  frustum.planes[0] = {1.0f, 0.0f, 0.0f, -10.0f};
+  frustum.planes[1] = {-1.0f, 0.0f, 0.0f, 22.0f};
+  frustum.planes[2] = frustum.planes[3] = {0.0f, 1.0f, 0.0f, 100.0f};
+  frustum.planes[4] = frustum.planes[5] = {0.0f, 0.0f, 1.0f, 100.0f};
+
+  std::vector<Entity> visible;
+  octree.queryFrustum(frustum, visible);
+  std::sort(visible.begin(), visible.end());
+  EXPECT_EQ(visible, (std::vector<Entity>{3, 4, 5}));
+}
+
+TEST(TestBroadphase, StaticBVH) {
+  std::mt19937 rng(99);
+  std::vector<BroadphaseProxy> proxies;
+  for (Entity e = 1; e <= 1000; e++) {
+    proxies.push_back({e, randomBox(rng, 50.0f, 4.0f)});
+  }
+  // Stacked copies share a centroid and can't be split by area.
+  for (Entity e = 1001; e <= 1020; e++) {
+    proxies.push_back({e, AABB{glm::vec3(0.0f), glm::vec3(1.0f)}});
+  }
+  StaticBVH bvh(proxies);
+  EXPECT_EQ(bvh.size(), proxies.size());
+  ASSERT_NE(bvh.find(7), nullptr);
+  EXPECT_EQ(bvh.find(7)->min, proxies[6].aabb.min);
+  EXPECT_EQ(bvh.find(5000), nullptr);
+
+  // Round trip through the scene file format.
+  std::ostringstream output;
+  ASSERT_TRUE(writePropertyTree(output, *bvh.serialize()).ok());
+  std::istringstream input(output.str());
+  absl::StatusOr<PropertyTree> tree = readPropertyTree(input);
+  ASSERT_TRUE(tree.ok());
+  absl::StatusOr<StaticBVH> loaded = StaticBVH::deserialize(*tree);
+  ASSERT_TRUE(loaded.ok()) << loaded.status();
+
+  std::uniform_real_distribution<float> coord(-50.0f, 50.0f);
+  for (const StaticBVH *index : {&bvh, &*loaded}) {
+    for (size_t i = 0; i < 50; i++) {
+      AABB query = randomBox(rng, 50.0f, 10.0f);
+      std::vector<Entity> found;
+      index->query(query, found);
+      std::sort(found.begin(), found.end());
+      EXPECT_EQ(found, bruteForce(proxies, query));
+
+      Ray ray{{coord(rng), coord(rng), coord(rng)},
+              {coord(rng), coord(rng), coord(rng)}};
+      found.clear();
+      index->queryRay(ray, 1.0f, found);
+      std::sort(found.begin(), found.end());
+      EXPECT_EQ(found, bruteForceRay(proxies, ray, 1.0f));
+    }
+  }
+
+  tree->properties.pop_back();
+  EXPECT_FALSE(StaticBVH::deserialize(*tree).ok());
+}
+
+// A chain of inner nodes, each with a one-box leaf on the left.
+PropertyTree chainBVH(int32_t depth) {
+  std::vector<float> node_boxes, boxes;
+  std::vector<int32_t> node_links, entities;
+  auto box = [](std::vector<float> &out, float x, float width = 1.0f) {
+    out.insert(out.end(), {x, 0.0f, 0.0f, x + width, 1.0f, 1.0f});
+  };
+  for (int32_t i = 0; i < depth; i++) {
+    box(node_boxes, static_cast<float>(i), static_cast<float>(depth - i));
+    node_links.insert(node_links.end(), {2 * i + 2, 0});
+    box(node_boxes, static_cast<float>(i));
+    node_links.insert(node_links.end(), {i, 1});
+    box(boxes, static_cast<float>(i));
+    entities.push_back(i + 1);
+  }
+  box(node_boxes, static_cast<float>(depth));
+  node_links.insert(node_links.end(), {depth, 1});
+  box(boxes, static_cast<float>(depth));
+  entities.push_back(depth + 1);
+  return {"StaticBVH", {node_boxes, node_links, entities, boxes}};
+}
+
+TEST(TestBroadphase, StaticBVHRejectsDeepTrees) {
+  absl::StatusOr<StaticBVH> shallow = StaticBVH::deserialize(chainBVH(100));
+  ASSERT_TRUE(shallow.ok()) << shallow.status();
+  std::vector<Entity> found;
+  // The two deepest leaves.
+  shallow->query(AABB{{99.5f, 0.0f, 0.0f}, {100.5f, 1.0f, 1.0f}}, found);
+  std::sort(found.begin(), found.end());
+  EXPECT_EQ(found, (std::vector<Entity>{100, 101}));
+
+  // Would overflow the traversal stack.
+  EXPECT_FALSE(StaticBVH::deserialize(chainBVH(1000)).ok());
+}
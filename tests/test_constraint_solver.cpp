@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+
+#include "sunset/constraint_solver.h"
+
+namespace {
+
+TEST(ConstraintSolver, PullsAChainBackToLength) {
+  ConstraintSolver solver;
+  // A fixed anchor with a stretched chain of five links below it.
+  std::vector<uint32_t> bodies{
+      solver.addBody(glm::vec3(0.0f), glm::vec3(0.0f), 0.0f)};
+  for (int i = 1; i <= 5; i++) {
+    bodies.push_back(solver.addBody(glm::vec3(0.0f, -1.5f * i, 0.0f),
+                                    glm::vec3(0.0f), 1.0f));
+  }
+  for (size_t i = 0; i + 1 < bodies.size(); i++) {
+    solver.addConstraint(i, bodies[i], bodies[i + 1], 1.0f);
+  }
+
+  // Alternating links share bodies, so a chain takes two colours.
+  solver.solve(50);
+  EXPECT_EQ(solver.colours(), 2u);
+
+  EXPECT_EQ(solver.position(bodies[0]), glm::vec3(0.0f));
+  for (size_t i = 0; i + 1 < bodies.size(); i++) {
+    float length = glm::length(solver.position(bodies[i + 1]) -
+                               solver.position(bodies[i]));
+    EXPECT_NEAR(length, 1.0f, 0.01f) << "link " << i;
+  }
+}
+
+TEST(ConstraintSolver, FixedBodiesDontAddColours) {
+  ConstraintSolver solver;
+  uint32_t anchor = solver.addBody(glm::vec3(0.0f), glm::vec3(0.0f), 0.0f);
+  for (int i = 0; i < 8; i++) {
+    uint32_t body = solver.addBody(glm::vec3(static_cast<float>(i), 2, 0),
+                                   glm::vec3(0.0f), 1.0f);
+    solver.addConstraint(i, anchor, body, 1.0f);
+  }
+
+  solver.solve(1);
+  EXPECT_EQ(solver.colours(), 1u);
+  EXPECT_EQ(solver.position(anchor), glm::vec3(0.0f));
+}
+
+TEST(ConstraintSolver, RemovesRelativeVelocityAndKeepsMomentum) {
+  ConstraintSolver solver;
+  uint32_t a = solver.addBody(glm::vec3(0.0f), glm::vec3(-1.0f, 0, 0), 1.0f);
+  uint32_t b = solver.addBody(glm::vec3(1.0f, 0, 0), glm::vec3(1.0f, 1, 0),
+                              0.5f);
+  solver.addConstraint(0, a, b, 1.0f);
+  solver.solve(4);
+
+  glm::vec3 relative = solver.velocity(b) - solver.velocity(a);
+  EXPECT_NEAR(relative.x, 0.0f, 1e-5f);
+  EXPECT_NEAR(relative.y, 1.0f, 1e-5f);
+
+  // Masses are 1 and 2.
+  glm::vec3 momentum = solver.velocity(a) + 2.0f * solver.velocity(b);
+  EXPECT_NEAR(momentum.x, 1.0f, 1e-5f);
+  EXPECT_NEAR(momentum.y, 2.0f, 1e-5f);
+}
+
+TEST(ConstraintSolver, WarmStartsFromTheLastStep) {
+  ConstraintSolver solver;
+  uint32_t a = solver.addBody(glm::vec3(0.0f), glm::vec3(0.0f), 0.0f);
+  uint32_t b = solver.addBody(glm::vec3(0, -1, 0), glm::vec3(0, -1, 0),
+                              1.0f);
+  solver.addConstraint(7, a, b, 1.0f);
+  solver.solve(1);
+  EXPECT_NEAR(solver.velocity(b).y, 0.0f, 1e-5f);
+
+  // The same pull again: last step's impulse alone cancels it, so no
+  // iterations are needed.
+  solver.clear();
+  a = solver.addBody(glm::vec3(0.0f), glm::vec3(0.0f), 0.0f);
+  b = solver.addBody(glm::vec3(0, -1, 0), glm::vec3(0, -1, 0), 1.0f);
+  solver.addConstraint(7, a, b, 1.0f);
+  solver.solve(0);
+  EXPECT_NEAR(solver.velocity(b).y, 0.0f, 1e-5f);
+}
+
+} // namespace
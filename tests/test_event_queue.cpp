@@ -0,0 +1,212 @@
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "sunset/event_queue.h"
+
+struct Ping {
+  int value;
+};
+
+struct Pong {
+  int value;
+};
+
+struct Delta {
+  int sum;
+
+  void merge(const Delta &next) { sum += next.sum; }
+};
+
+TEST(TestEventQueue, DeliversInOrder) {
+  EventQueue queue;
+  std::vector<int> seen;
+
+  queue.subscribe(
+      std::function([&](const Ping &ping) { seen.push_back(ping.value); }));
+  queue.subscribe(std::function(
+      [&](const Pong &pong) { seen.push_back(-pong.value); }));
+
+  queue.send(Ping{1});
+  queue.send(Pong{2});
+  queue.send(Ping{3});
+  queue.process();
+
+  EXPECT_EQ(seen, (std::vector<int>{1, -2, 3}));
+}
+
+TEST(TestEventQueue, HandlersMaySendDuringProcess) {
+  EventQueue queue;
+  std::vector<int> seen;
+
+  queue.subscribe(std::function([&](const Ping &ping) {
+    seen.push_back(ping.value);
+    if (ping.value < 3) queue.send(Ping{ping.value + 1});
+  }));
+
+  queue.send(Ping{1});
+  queue.process();
+
+  EXPECT_EQ(seen, (std::vector<int>{1, 2, 3}));
+}
+
+TEST(TestEventQueue, CoalescesLatest) {
+  EventQueue queue;
+  std::vector<int> seen;
+
+  queue.setCoalescing<Ping, CoalescePolicy::KeepLatest>();
+  queue.subscribe(
+      std::function([&](const Ping &ping) { seen.push_back(ping.value); }));
+  queue.subscribe(std::function(
+      [&](const Pong &pong) { seen.push_back(-pong.value); }));
+
+  queue.send(Ping{1});
+  queue.send(Pong{2});
+  queue.send(Ping{3});
+  queue.send(Ping{4});
+  queue.process();
+
+  // The merged event keeps the slot of the first one.
+  EXPECT_EQ(seen, (std::vector<int>{4, -2}));
+
+  seen.clear();
+  queue.send(Ping{5});
+  queue.process();
+  EXPECT_EQ(seen, (std::vector<int>{5}));
+}
+
+TEST(TestEventQueue, CoalescesSum) {
+  EventQueue queue;
+  std::vector<int> seen;
+
+  queue.setCoalescing<Delta, CoalescePolicy::Sum>();
+  queue.subscribe(
+      std::function([&](const Delta &delta) { seen.push_back(delta.sum); }));
+
+  queue.send(Delta{1});
+  queue.send(Delta{2});
+  queue.send(Delta{3});
+  queue.process();
+  EXPECT_EQ(seen, (std::vector<int>{6}));
+
+  queue.setCoalescing<Delta, CoalescePolicy::KeepAll>();
+  seen.clear();
+  queue.send(Delta{1});
+  queue.send(Delta{2});
+  queue.process();
+  EXPECT_EQ(seen, (std::vector<int>{1, 2}));
+}
+
+TEST(TestEventQueue, CoalescesEventsSentByHandlers) {
+  EventQueue queue;
+  std::vector<int> seen;
+
+  queue.setCoalescing<Delta, CoalescePolicy::Sum>();
+  queue.subscribe(std::function([&](const Ping &ping) {
+    queue.send(Delta{ping.value});
+  }));
+  queue.subscribe(
+      std::function([&](const Delta &delta) { seen.push_back(delta.sum); }));
+
+  queue.send(Ping{1});
+  queue.send(Ping{2});
+  queue.send(Delta{10});
+  queue.process();
+
+  // Delta{10} is queued first; both handler-sent deltas fold into it.
+  EXPECT_EQ(seen, (std::vector<int>{13}));
+}
+
+TEST(TestEventQueue, FlushesOnlyTheRequestedPhase) {
+  EventQueue queue;
+  std::vector<int> seen;
+
+  queue.route<Pong>(EventPhase::PostPhysics);
+  queue.subscribe(
+      std::function([&](const Ping &ping) { seen.push_back(ping.value); }));
+  queue.subscribe(std::function(
+      [&](const Pong &pong) { seen.push_back(-pong.value); }));
+
+  queue.send(Ping{1});
+  queue.send(Pong{2});
+  queue.send(Pong{3});
+
+  queue.process(EventPhase::PostPhysics);
+  EXPECT_EQ(seen, (std::vector<int>{-2, -3}));
+
+  queue.process(EventPhase::PreRender);
+  EXPECT_EQ(seen, (std::vector<int>{-2, -3}));
+
+  queue.process();
+  EXPECT_EQ(seen, (std::vector<int>{-2, -3, 1}));
+}
+
+TEST(TestEventQueue, EndOfFrameDrainsEarlierPhases) {
+  EventQueue queue;
+  std::vector<int> seen;
+
+  queue.route<Pong>(EventPhase::PostPhysics);
+  queue.subscribe(std::function([&](const Ping &ping) {
+    seen.push_back(ping.value);
+    queue.send(Pong{ping.value + 1});
+  }));
+  queue.subscribe(std::function(
+      [&](const Pong &pong) { seen.push_back(-pong.value); }));
+
+  queue.send(Pong{1});
+  queue.send(Ping{2});
+  queue.process();
+
+  EXPECT_EQ(seen, (std::vector<int>{-1, 2, -3}));
+}
+
+TEST(TestEventQueue, RecordsPerFrameStats) {
+  EventQueue queue;
+  if (!queue.stats().enabled) {
+    GTEST_SKIP() << "built without SUNSET_EVENT_STATS";
+  }
+
+  queue.subscribe(std::function([](const Ping &) {}));
+  queue.subscribe(std::function([](const Ping &) {}));
+
+  queue.send(Ping{1});
+  queue.send(Ping{2});
+  queue.send(Pong{3});
+  queue.process();
+
+  EventQueueStats stats = queue.stats();
+  EXPECT_EQ(stats.frames, 1u);
+  EXPECT_EQ(stats.last_peak_depth, 3u);
+  ASSERT_EQ(stats.types.size(), 2u);
+
+  const EventTypeStats &ping = stats.types[0];
+  EXPECT_EQ(ping.last_sent, 2u);
+  EXPECT_EQ(ping.last_delivered, 2u);
+  ASSERT_EQ(ping.handler_time.size(), 2u);
+  EXPECT_EQ(ping.handler_time[0].count, 2u);
+  EXPECT_EQ(ping.handler_time[1].count, 2u);
+
+  const EventTypeStats &pong = stats.types[1];
+  EXPECT_EQ(pong.last_sent, 1u);
+  EXPECT_EQ(pong.last_delivered, 1u);
+  EXPECT_TRUE(pong.handler_time.empty());
+
+  queue.process();
+  stats = queue.stats();
+  EXPECT_EQ(stats.types[0].last_sent, 0u);
+  EXPECT_EQ(stats.types[0].total_sent, 2u);
+}
+
+TEST(TestEventQueue, HistogramBuckets) {
+  LatencyHistogram histogram;
+  histogram.record(absl::Nanoseconds(10));
+  histogram.record(absl::Microseconds(3));
+  histogram.record(absl::Microseconds(100));
+
+  EXPECT_EQ(histogram.count, 3u);
+  EXPECT_EQ(histogram.buckets[0], 1u);
+  EXPECT_EQ(histogram.buckets[2], 1u);
+  EXPECT_EQ(histogram.buckets[7], 1u);
+  EXPECT_EQ(histogram.max, absl::Microseconds(100));
+  EXPECT_EQ(histogram.percentile(0.5), absl::Microseconds(4));
+}
@@ -0,0 +1,141 @@
+#include <cmath>
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "sunset/heightfield.h"
+#include "sunset/physics.h"
+
+namespace {
+
+// 17x9 samples of a wavy surface, 0.5 apart, with its corner at
+// (-2, 1, 3).
+Heightfield makeTerrain() {
+  std::vector<float> heights;
+  for (int z = 0; z < 9; z++) {
+    for (int x = 0; x < 17; x++) {
+      heights.push_back(std::sin(x * 0.7f) + std::cos(z * 1.3f) * 0.5f);
+    }
+  }
+  return Heightfield({-2.0f, 1.0f, 3.0f}, 0.5f, 17, std::move(heights));
+}
+
+TEST(Heightfield, InterpolatesBetweenSamples) {
+  Heightfield terrain({0.0f, 1.0f, 0.0f}, 2.0f, 2,
+                      {0.0f, 2.0f, 4.0f, 6.0f});
+
+  EXPECT_FLOAT_EQ(*terrain.heightAt(0.0f, 0.0f), 1.0f);
+  EXPECT_FLOAT_EQ(*terrain.heightAt(2.0f, 2.0f), 7.0f);
+  EXPECT_FLOAT_EQ(*terrain.heightAt(1.0f, 0.0f), 2.0f);
+  EXPECT_FLOAT_EQ(*terrain.heightAt(1.0f, 1.0f), 4.0f);
+  EXPECT_FALSE(terrain.heightAt(2.5f, 1.0f));
+  EXPECT_FALSE(terrain.heightAt(1.0f, -0.5f));
+
+  // A plane rising by 1 along x and 2 along z per unit.
+  glm::vec3 normal = terrain.normalAt(0.5f, 1.5f);
+  glm::vec3 expected = glm::normalize(glm::vec3(-1.0f, 1.0f, -2.0f));
+  EXPECT_NEAR(glm::length(normal - expected), 0.0f, 1e-6f);
+}
+
+TEST(Heightfield, MaxHeightMatchesDenseSampling) {
+  Heightfield terrain = makeTerrain();
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> x_dist(-3.0f, 7.0f);
+  std::uniform_real_distribution<float> z_dist(2.0f, 8.0f);
+  std::uniform_real_distribution<float> size_dist(0.0f, 1.5f);
+
+  for (int i = 0; i < 200; i++) {
+    glm::vec3 min{x_dist(rng), 0.0f, z_dist(rng)};
+    AABB box{min, min + glm::vec3(size_dist(rng), 1.0f, size_dist(rng))};
+    std::optional<float> highest = terrain.maxHeight(box);
+
+    std::optional<float> sampled;
+    for (int sx = 0; sx <= 64; sx++) {
+      for (int sz = 0; sz <= 64; sz++) {
+        std::optional<float> height = terrain.heightAt(
+            box.min.x + (box.max.x - box.min.x) * sx / 64.0f,
+            box.min.z + (box.max.z - box.min.z) * sz / 64.0f);
+        if (height) sampled = std::max(sampled.value_or(*height), *height);
+      }
+    }
+
+    ASSERT_EQ(highest.has_value(), sampled.has_value()) << "box " << i;
+    if (highest) {
+      EXPECT_GE(*highest, *sampled - 1e-5f) << "box " << i;
+      EXPECT_LE(*highest, *sampled + 0.05f) << "box " << i;
+    }
+  }
+}
+
+TEST(Heightfield, RaycastMatchesMarching) {
+  Heightfield terrain = makeTerrain();
+  std::mt19937 rng(11);
+  std::uniform_real_distribution<float> x_dist(-4.0f, 8.0f);
+  std::uniform_real_distribution<float> z_dist(1.0f, 9.0f);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+  for (int i = 0; i < 200; i++) {
+    Ray ray{{x_dist(rng), 3.5f, z_dist(rng)},
+            {unit(rng) * 4.0f, -std::abs(unit(rng)) - 0.1f,
+             unit(rng) * 4.0f}};
+    std::optional<float> hit = terrain.raycast(ray, 4.0f);
+
+    // First point below the surface when stepping along the ray.
+    std::optional<float> marched;
+    for (int step = 0; step <= 40000 && !marched; step++) {
+      float t = step * 1e-4f;
+      glm::vec3 p = ray.at(t);
+      std::optional<float> height = terrain.heightAt(p.x, p.z);
+      if (height && p.y <= *height) marched = t;
+    }
+
+    ASSERT_EQ(hit.has_value(), marched.has_value()) << "ray " << i;
+    if (hit) EXPECT_NEAR(*hit, *marched, 2e-4f) << "ray " << i;
+  }
+
+  // Starting under the surface hits right away.
+  EXPECT_EQ(terrain.raycast(Ray{{0.0f, -5.0f, 5.0f}, {1, 0, 0}}, 10.0f),
+            0.0f);
+  // Pointing up from above it never does.
+  EXPECT_FALSE(terrain.raycast(Ray{{0.0f, 5.0f, 5.0f}, {0, 1, 0}}, 10.0f));
+}
+
+TEST(Heightfield, SerializeRoundTrips) {
+  Heightfield terrain = makeTerrain();
+  absl::StatusOr<Heightfield> loaded =
+      Heightfield::deserialize(*terrain.serialize());
+  ASSERT_TRUE(loaded.ok()) << loaded.status();
+  EXPECT_EQ(loaded->columns(), 17);
+  EXPECT_EQ(loaded->rows(), 9);
+  EXPECT_EQ(*loaded->heightAt(1.3f, 4.1f), *terrain.heightAt(1.3f, 4.1f));
+
+  PropertyTree ragged{"Heightfield",
+                      {std::vector<float>{0, 0, 0}, 1.0f, int32_t{3},
+                       std::vector<float>{0, 1, 2, 3, 4}}};
+  EXPECT_FALSE(Heightfield::deserialize(ragged).ok());
+
+  // As the Python tools write it.
+  PropertyTree narrow{"Heightfield",
+                      {std::vector<float>{0, 0, 0}, 1.0f, int16_t{2},
+                       std::vector<float>{0, 1, 2, 3}}};
+  loaded = Heightfield::deserialize(narrow);
+  ASSERT_TRUE(loaded.ok()) << loaded.status();
+  EXPECT_EQ(loaded->columns(), 2);
+  EXPECT_EQ(loaded->rows(), 2);
+}
+
+TEST(Heightfield, TerrainComponentRoundTrips) {
+  TerrainComponent terrain{makeTerrain(),
+                           {.friction = 0.25f, .restitution = 0.1f}};
+  absl::StatusOr<TerrainComponent> loaded =
+      TerrainComponent::deserialize(*terrain.serialize());
+  ASSERT_TRUE(loaded.ok()) << loaded.status();
+  EXPECT_EQ(loaded->heightfield.columns(), 17);
+  EXPECT_EQ(loaded->heightfield.rows(), 9);
+  EXPECT_EQ(*loaded->heightfield.heightAt(1.3f, 4.1f),
+            *terrain.heightfield.heightAt(1.3f, 4.1f));
+  EXPECT_EQ(loaded->material.friction, 0.25f);
+  EXPECT_EQ(loaded->material.restitution, 0.1f);
+}
+
+} // namespace
@@ -0,0 +1,706 @@
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "sunset/physics.h"
+#include "sunset/state_hash.h"
+#include "sunset/thread_pool.h"
+
+namespace {
+
+AABB boxAt(glm::vec3 center, glm::vec3 half_extents) {
+  return {center - half_extents, center + half_extents};
+}
+
+Entity addBody(ECS &ecs, glm::vec3 center, glm::vec3 half_extents,
+               PhysicsComponent physics = {}) {
+  Entity entity = ecs.createEntity();
+  physics.collider = boxAt(center, half_extents);
+  ecs.addComponents(entity, Transform{.position = center}, physics);
+  return entity;
+}
+
+Entity addStatic(ECS &ecs, glm::vec3 center, glm::vec3 half_extents) {
+  return addBody(ecs, center, half_extents,
+                 {.type = PhysicsComponent::Type::Static});
+}
+
+struct Scene {
+  ECS ecs;
+  EventQueue event_queue;
+  PhysicsSystem physics;
+
+  void step() {
+    physics.update(ecs, event_queue, physics.step());
+    event_queue.process();
+  }
+};
+
+// Columns of falling boxes on a floor, jittered so neighbours knock into
+// each other. Enough bodies and islands to be split across workers.
+void buildPile(Scene &scene) {
+  addStatic(scene.ecs, glm::vec3(0.0f, -1.0f, 0.0f),
+            glm::vec3(40.0f, 1.0f, 40.0f));
+  for (int column = 0; column < 24; column++) {
+    for (int level = 0; level < 8; level++) {
+      float jitter = 0.05f * static_cast<float>((column + level) % 5 - 2);
+      glm::vec3 center{static_cast<float>(column % 6) * 1.4f + jitter,
+                       0.6f + static_cast<float>(level) * 1.2f,
+                       static_cast<float>(column / 6) * 1.4f - jitter};
+      addBody(scene.ecs, center, glm::vec3(0.5f),
+              {.velocity = {jitter, 0.0f, 0.0f},
+               .acceleration = {0.0f, -0.05f, 0.0f}});
+    }
+  }
+}
+
+TEST(Physics, PileMatchesAcrossThreadCounts) {
+  ThreadPool serial(0);
+  ThreadPool parallel(3);
+  Scene a, b;
+  a.physics.setThreadPool(&serial);
+  b.physics.setThreadPool(&parallel);
+  buildPile(a);
+  buildPile(b);
+
+  for (int tick = 0; tick < 120; tick++) {
+    a.step();
+    b.step();
+    StateHash a_state = hashPhysicsState(a.ecs);
+    StateHash b_state = hashPhysicsState(b.ecs);
+    ASSERT_EQ(a_state.hash, b_state.hash) << "tick " << tick;
+  }
+}
+
+// Per-step displacement `motion` at the reference tick rate.
+glm::vec3 velocityFor(glm::vec3 motion) {
+  return motion / PhysicsSystem::kMotionScale;
+}
+
+TEST(Physics, ContinuousBodyDoesNotTunnel) {
+  Scene scene;
+  Entity wall = addStatic(scene.ecs, glm::vec3(5.0f, 0.0f, 0.0f),
+                          glm::vec3(0.025f, 2.0f, 2.0f));
+  // Moves 20 times its own size per step.
+  Entity bullet = addBody(scene.ecs, glm::vec3(0.0f), glm::vec3(0.05f),
+                          {.velocity = velocityFor({2.0f, 0.0f, 0.0f}),
+                           .continuous = true});
+
+  std::vector<Collision> collisions;
+  scene.event_queue.subscribe(std::function(
+      [&](const Collision &hit) { collisions.push_back(hit); }));
+
+  auto *physics = scene.ecs.getComponent<PhysicsComponent>(bullet);
+  for (int tick = 0; tick < 6; tick++) {
+    scene.step();
+    EXPECT_LE(physics->collider.max.x, 4.975f) << "tick " << tick;
+  }
+  ASSERT_FALSE(collisions.empty());
+  EXPECT_EQ(collisions[0].entity_a, bullet);
+  EXPECT_EQ(collisions[0].entity_b, wall);
+  // Bounced back off the wall.
+  EXPECT_LT(physics->velocity.x, 0.0f);
+}
+
+TEST(Physics, ContinuousBodySlidesAlongFace) {
+  Scene scene;
+  addBody(scene.ecs, glm::vec3(2.0f, 0.0f, 0.0f),
+          glm::vec3(0.025f, 2.0f, 10.0f),
+          {.type = PhysicsComponent::Type::Infinite});
+  Entity bullet = addBody(scene.ecs, glm::vec3(0.0f), glm::vec3(0.05f),
+                          {.velocity = velocityFor({5.0f, 0.0f, 1.0f}),
+                           .continuous = true});
+
+  // Hits the face 39% of the way, then keeps the motion along it.
+  scene.step();
+  glm::vec3 position = scene.ecs.getComponent<Transform>(bullet)->position;
+  EXPECT_NEAR(position.x, 1.925f, 1e-3f);
+  EXPECT_NEAR(position.y, 0.0f, 1e-5f);
+  EXPECT_NEAR(position.z, 1.0f, 1e-3f);
+}
+
+Entity addFloor(ECS &ecs) {
+  return addStatic(ecs, glm::vec3(0.0f, -1.0f, 0.0f),
+                   glm::vec3(10.0f, 1.0f, 10.0f));
+}
+
+// Unit box that falls and lands without bouncing.
+Entity addCrate(ECS &ecs, glm::vec3 center) {
+  Entity entity = ecs.createEntity();
+  ecs.addComponents(
+      entity, Transform{.position = center},
+      PhysicsComponent{.acceleration = {0.0f, -0.05f, 0.0f},
+                       .material = {.restitution = 0.0f},
+                       .collider = boxAt(center, glm::vec3(0.5f))},
+      MovementIntent{});
+  return entity;
+}
+
+bool sleeping(Scene &scene, Entity entity) {
+  return scene.ecs.getComponent<PhysicsComponent>(entity)->sleeping;
+}
+
+// Steps until `entity` sleeps, returning the steps taken, or -1 if it is
+// still awake after `limit`.
+int stepUntilAsleep(Scene &scene, Entity entity, int limit) {
+  for (int tick = 1; tick <= limit; tick++) {
+    scene.step();
+    if (sleeping(scene, entity)) return tick;
+  }
+  return -1;
+}
+
+TEST(Physics, RestingIslandFallsAsleep) {
+  Scene scene;
+  addFloor(scene.ecs);
+  Entity bottom = addCrate(scene.ecs, glm::vec3(0.0f, 0.6f, 0.0f));
+  Entity top = addCrate(scene.ecs, glm::vec3(0.0f, 1.8f, 0.0f));
+
+  int ticks = stepUntilAsleep(scene, bottom, 120);
+  ASSERT_NE(ticks, -1);
+  // Not before it rested for half a second, and with the box on it.
+  EXPECT_GE(static_cast<float>(ticks) * scene.physics.step(), 0.5f);
+  EXPECT_TRUE(sleeping(scene, top));
+
+  glm::vec3 position = scene.ecs.getComponent<Transform>(top)->position;
+  for (int tick = 0; tick < 10; tick++) scene.step();
+  EXPECT_TRUE(sleeping(scene, bottom));
+  EXPECT_EQ(scene.ecs.getComponent<Transform>(top)->position, position);
+}
+
+TEST(Physics, MovementIntentWakesIsland) {
+  Scene scene;
+  addFloor(scene.ecs);
+  Entity bottom = addCrate(scene.ecs, glm::vec3(0.0f, 0.6f, 0.0f));
+  Entity top = addCrate(scene.ecs, glm::vec3(0.0f, 1.8f, 0.0f));
+  ASSERT_NE(stepUntilAsleep(scene, bottom, 120), -1);
+
+  scene.ecs.getComponent<MovementIntent>(bottom)->displacement = {
+      0.2f, 0.0f, 0.0f};
+  scene.step();
+  EXPECT_FALSE(sleeping(scene, bottom));
+  EXPECT_FALSE(sleeping(scene, top));
+  EXPECT_NEAR(scene.ecs.getComponent<Transform>(bottom)->position.x, 0.2f,
+              1e-5f);
+}
+
+TEST(Physics, WakeSkipsRemovedNeighbours) {
+  Scene scene;
+  addFloor(scene.ecs);
+  Entity bottom = addCrate(scene.ecs, glm::vec3(0.0f, 0.6f, 0.0f));
+  Entity top = addCrate(scene.ecs, glm::vec3(0.0f, 1.8f, 0.0f));
+  Entity side = addCrate(scene.ecs, glm::vec3(1.0f, 0.6f, 0.0f));
+  ASSERT_NE(stepUntilAsleep(scene, bottom, 120), -1);
+
+  // Both are still in the broadphase until the next update.
+  scene.ecs.destroyEntity(top);
+  scene.ecs.removeComponent<PhysicsComponent>(side);
+  scene.physics.wake(scene.ecs, bottom);
+  EXPECT_FALSE(sleeping(scene, bottom));
+  scene.step();
+}
+
+TEST(Physics, MoveObjectPassesRemovedBodies) {
+  Scene scene;
+  Entity mover = addBody(scene.ecs, glm::vec3(0.0f), glm::vec3(0.5f));
+  Entity destroyed =
+      addBody(scene.ecs, glm::vec3(2.0f, 0.0f, 0.0f), glm::vec3(0.5f));
+  Entity stripped =
+      addBody(scene.ecs, glm::vec3(4.0f, 0.0f, 0.0f), glm::vec3(0.5f));
+  scene.step();
+
+  // Both are still in the broadphase until the next update.
+  scene.ecs.destroyEntity(destroyed);
+  scene.ecs.removeComponent<PhysicsComponent>(stripped);
+  EXPECT_FALSE(scene.physics.moveObject(
+      scene.ecs, mover, glm::vec3(5.0f, 0.0f, 0.0f), scene.event_queue));
+  EXPECT_EQ(scene.ecs.getComponent<Transform>(mover)->position,
+            glm::vec3(5.0f, 0.0f, 0.0f));
+}
+
+TEST(Physics, PushWakesSleepingBody) {
+  Scene scene;
+  addFloor(scene.ecs);
+  Entity crate = addCrate(scene.ecs, glm::vec3(0.0f, 0.6f, 0.0f));
+  // Floats just above the floor so nothing slows it down.
+  Entity pusher = addBody(scene.ecs, glm::vec3(-3.0f, 0.52f, 0.0f),
+                          glm::vec3(0.5f),
+                          {.material = {.restitution = 0.0f}});
+  ASSERT_NE(stepUntilAsleep(scene, crate, 120), -1);
+
+  scene.ecs.getComponent<PhysicsComponent>(pusher)->velocity =
+      velocityFor({0.2f, 0.0f, 0.0f});
+  for (int tick = 0; tick < 20 && sleeping(scene, crate); tick++) {
+    scene.step();
+  }
+  EXPECT_FALSE(sleeping(scene, crate));
+  scene.step();
+  EXPECT_GT(scene.ecs.getComponent<Transform>(crate)->position.x, 0.0f);
+}
+
+TEST(Physics, BodyInColliderStaysAwake) {
+  Scene scene;
+  addFloor(scene.ecs);
+  addBody(scene.ecs, glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(2.0f),
+          {.type = PhysicsComponent::Type::Collider});
+  Entity crate = addCrate(scene.ecs, glm::vec3(0.0f, 0.6f, 0.0f));
+
+  EXPECT_EQ(stepUntilAsleep(scene, crate, 120), -1);
+}
+
+TEST(Physics, ColliderReportsEnterAndExitOnce) {
+  Scene scene;
+  Entity volume = addBody(scene.ecs, glm::vec3(0.0f), glm::vec3(1.0f),
+                          {.type = PhysicsComponent::Type::Collider});
+  // Spends a few steps wholly inside on its way through.
+  Entity body = addBody(scene.ecs, glm::vec3(-3.0f, 0.0f, 0.0f),
+                        glm::vec3(0.5f),
+                        {.velocity = velocityFor({0.25f, 0.0f, 0.0f})});
+
+  std::vector<EnterCollider> entered;
+  std::vector<ExitCollider> exited;
+  scene.event_queue.subscribe(std::function(
+      [&](const EnterCollider &event) { entered.push_back(event); }));
+  scene.event_queue.subscribe(std::function(
+      [&](const ExitCollider &event) { exited.push_back(event); }));
+
+  auto *physics = scene.ecs.getComponent<PhysicsComponent>(body);
+  int ticks_inside = 0;
+  for (int tick = 0; tick < 40; tick++) {
+    scene.step();
+    if (physics->collider.min.x > -1.0f &&
+        physics->collider.max.x < 1.0f) {
+      ticks_inside++;
+      EXPECT_EQ(entered.size(), 1u) << "tick " << tick;
+      EXPECT_TRUE(exited.empty()) << "tick " << tick;
+    }
+  }
+  EXPECT_GT(ticks_inside, 2);
+  EXPECT_GT(physics->collider.min.x, 1.0f);
+
+  ASSERT_EQ(entered.size(), 1u);
+  EXPECT_EQ(entered[0].entity, body);
+  EXPECT_EQ(entered[0].collider, volume);
+  ASSERT_EQ(exited.size(), 1u);
+  EXPECT_EQ(exited[0].entity, body);
+  EXPECT_EQ(exited[0].collider, volume);
+}
+
+// Scattered boxes of every type that stay where they are, and the same
+// bodies in a flat list to check queries against.
+struct QueryScene : Scene {
+  struct Body {
+    Entity entity;
+    PhysicsComponent::Type type;
+    AABB collider;
+  };
+  std::vector<Body> bodies;
+
+  QueryScene() {
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> position(-20.0f, 20.0f);
+    std::uniform_real_distribution<float> size(0.1f, 1.5f);
+    constexpr PhysicsComponent::Type kTypes[] = {
+        PhysicsComponent::Type::Regular, PhysicsComponent::Type::Static,
+        PhysicsComponent::Type::Infinite, PhysicsComponent::Type::Collider};
+    for (int i = 0; i < 300; i++) {
+      PhysicsComponent::Type type = kTypes[i % 4];
+      glm::vec3 center{position(rng), position(rng), position(rng)};
+      glm::vec3 half_extents{size(rng), size(rng), size(rng)};
+      Entity entity = addBody(ecs, center, half_extents, {.type = type});
+      bodies.push_back({entity, type, boxAt(center, half_extents)});
+    }
+    physics.bakeStatic(ecs);
+  }
+
+  bool accepts(const Body &body, const QueryFilter &filter) const {
+    return filter.ignore != body.entity &&
+           (filter.colliders ||
+            body.type != PhysicsComponent::Type::Collider);
+  }
+
+  // Nearest box, grown by `half_extents`, that `ray` enters.
+  std::optional<RayHit> cast(const Ray &ray, float max_distance,
+                             glm::vec3 half_extents,
+                             const QueryFilter &filter) const {
+    std::optional<RayHit> nearest;
+    for (const Body &body : bodies) {
+      if (!accepts(body, filter)) continue;
+      std::optional<float> distance = ray.intersect(
+          {body.collider.min - half_extents,
+           body.collider.max + half_extents},
+          max_distance);
+      if (distance && (!nearest || *distance < nearest->distance)) {
+        nearest = RayHit{body.entity, *distance};
+      }
+    }
+    return nearest;
+  }
+};
+
+void expectSameHit(const std::optional<RayHit> &hit,
+                   const std::optional<RayHit> &expected) {
+  ASSERT_EQ(hit.has_value(), expected.has_value());
+  if (!hit) return;
+  EXPECT_EQ(hit->entity, expected->entity);
+  EXPECT_NEAR(hit->distance, expected->distance, 1e-4f);
+}
+
+// Every filter, including one leaving out what the query hits
+// unfiltered.
+std::vector<QueryFilter> filtersFor(const std::optional<RayHit> &hit) {
+  std::vector<QueryFilter> filters = {{}, {.colliders = true}};
+  if (hit) {
+    filters.push_back({.ignore = hit->entity});
+    filters.push_back({.ignore = hit->entity, .colliders = true});
+  }
+  return filters;
+}
+
+TEST(Physics, RaycastMatchesBruteForce) {
+  QueryScene scene;
+  std::mt19937 rng(12);
+  std::uniform_real_distribution<float> position(-20.0f, 20.0f);
+  std::normal_distribution<float> direction(0.0f, 1.0f);
+
+  constexpr float kMaxDistance = 30.0f;
+  std::vector<Ray> rays;
+  for (int i = 0; i < 200; i++) {
+    rays.push_back(
+        {{position(rng), position(rng), position(rng)},
+         glm::normalize(glm::vec3(direction(rng), direction(rng),
+                                  direction(rng)))});
+  }
+
+  int hits = 0;
+  std::vector<std::optional<RayHit>> batch(rays.size());
+  for (const QueryFilter &filter : {QueryFilter{},
+                                    QueryFilter{.colliders = true}}) {
+    scene.physics.raycast(scene.ecs, rays, kMaxDistance, batch, filter);
+    for (size_t i = 0; i < rays.size(); i++) {
+      SCOPED_TRACE(i);
+      expectSameHit(batch[i], scene.cast(rays[i], kMaxDistance,
+                                         glm::vec3(0.0f), filter));
+    }
+  }
+
+  for (size_t i = 0; i < rays.size(); i++) {
+    SCOPED_TRACE(i);
+    std::optional<RayHit> any = scene.cast(
+        rays[i], kMaxDistance, glm::vec3(0.0f), {.colliders = true});
+    hits += any.has_value();
+    for (const QueryFilter &filter : filtersFor(any)) {
+      expectSameHit(
+          scene.physics.raycast(scene.ecs, rays[i], kMaxDistance, filter),
+          scene.cast(rays[i], kMaxDistance, glm::vec3(0.0f), filter));
+    }
+  }
+  // Enough of both to mean something.
+  EXPECT_GT(hits, 20);
+  EXPECT_LT(hits, 180);
+}
+
+TEST(Physics, SweepAABBMatchesBruteForce) {
+  QueryScene scene;
+  std::mt19937 rng(13);
+  std::uniform_real_distribution<float> position(-20.0f, 20.0f);
+  std::uniform_real_distribution<float> size(0.1f, 1.0f);
+  std::normal_distribution<float> motion(0.0f, 8.0f);
+
+  std::vector<AABB> boxes;
+  std::vector<glm::vec3> motions;
+  for (int i = 0; i < 200; i++) {
+    boxes.push_back(
+        boxAt({position(rng), position(rng), position(rng)},
+              {size(rng), size(rng), size(rng)}));
+    motions.push_back({motion(rng), motion(rng), motion(rng)});
+  }
+
+  auto expected = [&](size_t i, const QueryFilter &filter) {
+    glm::vec3 half_extents = (boxes[i].max - boxes[i].min) * 0.5f;
+    return scene.cast(Ray{boxes[i].getCenter(), motions[i]}, 1.0f,
+                      half_extents, filter);
+  };
+
+  std::vector<std::optional<RayHit>> batch(boxes.size());
+  for (const QueryFilter &filter : {QueryFilter{},
+                                    QueryFilter{.colliders = true}}) {
+    scene.physics.sweepAABB(scene.ecs, boxes, motions, batch, filter);
+    for (size_t i = 0; i < boxes.size(); i++) {
+      SCOPED_TRACE(i);
+      expectSameHit(batch[i], expected(i, filter));
+    }
+  }
+
+  int hits = 0;
+  for (size_t i = 0; i < boxes.size(); i++) {
+    SCOPED_TRACE(i);
+    std::optional<RayHit> any = expected(i, {.colliders = true});
+    hits += any.has_value();
+    for (const QueryFilter &filter : filtersFor(any)) {
+      expectSameHit(
+          scene.physics.sweepAABB(scene.ecs, boxes[i], motions[i], filter),
+          expected(i, filter));
+    }
+  }
+  EXPECT_GT(hits, 20);
+}
+
+TEST(Physics, OverlapQueriesMatchBruteForce) {
+  QueryScene scene;
+  std::mt19937 rng(14);
+  std::uniform_real_distribution<float> position(-20.0f, 20.0f);
+  std::uniform_real_distribution<float> size(0.5f, 4.0f);
+
+  int found = 0;
+  for (int i = 0; i < 100; i++) {
+    SCOPED_TRACE(i);
+    glm::vec3 center{position(rng), position(rng), position(rng)};
+    AABB box = boxAt(center, {size(rng), size(rng), size(rng)});
+    float radius = size(rng);
+
+    for (const QueryFilter &filter :
+         {QueryFilter{}, QueryFilter{.colliders = true},
+          QueryFilter{.ignore = scene.bodies[i].entity,
+                      .colliders = true}}) {
+      std::vector<Entity> in_box, in_sphere;
+      for (const QueryScene::Body &body : scene.bodies) {
+        if (!scene.accepts(body, filter)) continue;
+        if (body.collider.intersects(box)) in_box.push_back(body.entity);
+        glm::vec3 offset =
+            glm::clamp(center, body.collider.min, body.collider.max) -
+            center;
+        if (glm::dot(offset, offset) <= radius * radius) {
+          in_sphere.push_back(body.entity);
+        }
+      }
+      found += static_cast<int>(in_box.size() + in_sphere.size());
+
+      std::vector<Entity> out;
+      scene.physics.overlapAABB(scene.ecs, box, out, filter);
+      EXPECT_EQ(out, in_box);
+
+      out.clear();
+      scene.physics.overlapSphere(scene.ecs, center, radius, out, filter);
+      EXPECT_EQ(out, in_sphere);
+    }
+  }
+  EXPECT_GT(found, 50);
+}
+
+TEST(Physics, QueriesSkipBodiesDestroyedSinceUpdate) {
+  QueryScene scene;
+  // One of each type, so both the broadphase and the static BVH hold a
+  // destroyed body.
+  for (int i = 0; i < 4; i++) {
+    scene.ecs.destroyEntity(scene.bodies[i].entity);
+  }
+  scene.bodies.erase(scene.bodies.begin(), scene.bodies.begin() + 4);
+
+  QueryFilter filter{.colliders = true};
+  std::vector<Entity> expected, out;
+  for (const QueryScene::Body &body : scene.bodies) {
+    expected.push_back(body.entity);
+  }
+  AABB everything = boxAt(glm::vec3(0.0f), glm::vec3(30.0f));
+  scene.physics.overlapAABB(scene.ecs, everything, out, filter);
+  EXPECT_EQ(out, expected);
+
+  out.clear();
+  scene.physics.overlapSphere(scene.ecs, glm::vec3(0.0f), 60.0f, out,
+                              filter);
+  EXPECT_EQ(out, expected);
+
+  Ray ray{glm::vec3(-30.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f)};
+  expectSameHit(scene.physics.raycast(scene.ecs, ray, 60.0f, filter),
+                scene.cast(ray, 60.0f, glm::vec3(0.0f), filter));
+  AABB box = boxAt(ray.origin, glm::vec3(2.0f));
+  expectSameHit(
+      scene.physics.sweepAABB(scene.ecs, box, ray.direction * 60.0f,
+                              filter),
+      scene.cast({ray.origin, ray.direction * 60.0f}, 1.0f,
+                 glm::vec3(2.0f), filter));
+}
+
+// Bodies far enough apart never to meet, some fixed and some asleep,
+// all with a MovementIntent.
+std::vector<Entity> buildDrifters(ECS &ecs) {
+  std::vector<Entity> entities;
+  std::mt19937 rng(15);
+  std::normal_distribution<float> velocity(0.0f, 0.5f);
+  std::normal_distribution<float> acceleration(0.0f, 0.005f);
+  for (int i = 0; i < 64; i++) {
+    glm::vec3 center{static_cast<float>(i % 8) * 100.0f, 0.0f,
+                     static_cast<float>(i / 8) * 100.0f};
+    PhysicsComponent physics{
+        .velocity = {velocity(rng), velocity(rng), velocity(rng)},
+        .acceleration = {acceleration(rng), acceleration(rng),
+                         acceleration(rng)},
+        .collider = boxAt(center, glm::vec3(0.5f))};
+    if (i % 5 == 0) physics.type = PhysicsComponent::Type::Static;
+    if (i % 3 == 0) {
+      physics.velocity = glm::vec3(0.0f);
+      physics.sleeping = true;
+    }
+    Entity entity = ecs.createEntity();
+    ecs.addComponents(entity, Transform{.position = center}, physics,
+                      MovementIntent{});
+    entities.push_back(entity);
+  }
+  return entities;
+}
+
+// How PhysicsSystem::update integrated and moved bodies straight from
+// their components, before BodyStore, for bodies that touch nothing.
+void referenceStep(ECS &ecs, float dt) {
+  float ticks = dt * PhysicsSystem::kReferenceTickRate;
+  ecs.forEach(std::function([&](Entity, PhysicsComponent *physics,
+                                Transform *transform,
+                                MovementIntent *intent) {
+    glm::vec3 displacement = intent->displacement;
+    intent->displacement = glm::vec3(0.0f);
+    if (physics->type == PhysicsComponent::Type::Static) return;
+    bool pushed = displacement != glm::vec3(0.0f);
+    if (physics->sleeping) {
+      if (physics->velocity == glm::vec3(0.0f) && !pushed) return;
+      physics->sleeping = false;
+    }
+
+    physics->velocity += physics->acceleration * ticks;
+    if (physics->velocity == glm::vec3(0.0f) && !pushed) return;
+    glm::vec3 direction =
+        physics->velocity * PhysicsSystem::kMotionScale * ticks;
+    if (pushed) direction += displacement;
+    transform->position += direction;
+  }));
+}
+
+TEST(Physics, BodyStoreMatchesComponentStep) {
+  Scene scene;
+  ECS reference;
+  std::vector<Entity> entities = buildDrifters(scene.ecs);
+  ASSERT_EQ(buildDrifters(reference), entities);
+
+  for (int tick = 0; tick < 60; tick++) {
+    // Nudge a few bodies each step, waking some sleeping ones.
+    for (size_t i = tick % 7; i < entities.size(); i += 7) {
+      for (ECS *ecs : {&scene.ecs, &reference}) {
+        ecs->getComponent<MovementIntent>(entities[i])->displacement = {
+            0.1f, 0.0f, 0.0f};
+      }
+    }
+    scene.step();
+    referenceStep(reference, scene.physics.step());
+
+    ASSERT_EQ(hashPhysicsState(scene.ecs).hash,
+              hashPhysicsState(reference).hash)
+        << "tick " << tick;
+    for (Entity entity : entities) {
+      ASSERT_EQ(sleeping(scene, entity),
+                reference.getComponent<PhysicsComponent>(entity)->sleeping)
+          << "tick " << tick << " entity " << entity;
+    }
+  }
+}
+
+TEST(Physics, IntentVelocityIsTickRateIndependent) {
+  glm::vec3 end[2];
+  float tick_rates[2] = {60.0f, 144.0f};
+  for (int i = 0; i < 2; i++) {
+    Scene scene;
+    scene.physics.configure({.tick_rate = tick_rates[i]});
+    Entity walker = scene.ecs.createEntity();
+    scene.ecs.addComponents(
+        walker, Transform{.position = glm::vec3(0.0f)},
+        PhysicsComponent{.collider = {glm::vec3(-0.5f), glm::vec3(0.5f)}},
+        MovementIntent{.velocity = {0.1f, 0.0f, -0.05f}});
+    // One second.
+    for (int tick = 0; tick < static_cast<int>(tick_rates[i]); tick++) {
+      scene.step();
+    }
+    end[i] = scene.ecs.getComponent<Transform>(walker)->position;
+  }
+  EXPECT_NEAR(end[0].x, 6.0f, 1e-3f);
+  EXPECT_NEAR(end[0].z, -3.0f, 1e-3f);
+  EXPECT_NEAR(end[1].x, end[0].x, 1e-3f);
+  EXPECT_NEAR(end[1].z, end[0].z, 1e-3f);
+}
+
+TEST(Physics, MovementIntentRoundTrips) {
+  MovementIntent intent{.displacement = {1.0f, -2.0f, 0.5f},
+                        .velocity = {0.25f, 0.0f, -4.0f}};
+  std::optional<PropertyTree> tree = intent.serialize();
+  ASSERT_TRUE(tree);
+  absl::StatusOr<MovementIntent> read = MovementIntent::deserialize(*tree);
+  ASSERT_TRUE(read.ok()) << read.status();
+  EXPECT_EQ(read->displacement, intent.displacement);
+  EXPECT_EQ(read->velocity, intent.velocity);
+
+  read = MovementIntent::deserialize(PropertyTree{"MovementIntent"});
+  ASSERT_TRUE(read.ok()) << read.status();
+  EXPECT_EQ(read->velocity, glm::vec3(0.0f));
+}
+
+TEST(Physics, ConstraintRoundTrips) {
+  Constraint constraint{.other = 70000, .distance = 2.5f};
+  std::optional<PropertyTree> tree = constraint.serialize();
+  ASSERT_TRUE(tree);
+  absl::StatusOr<Constraint> read = Constraint::deserialize(*tree);
+  ASSERT_TRUE(read.ok()) << read.status();
+  EXPECT_EQ(read->other, constraint.other);
+  EXPECT_EQ(read->distance, constraint.distance);
+}
+
+TEST(Physics, MasslessRegularBodyHoldsStill) {
+  Scene scene;
+  Entity anchor = addBody(scene.ecs, glm::vec3(0.0f), glm::vec3(0.1f),
+                          {.mass = 0.0f});
+  Entity bob = scene.ecs.createEntity();
+  scene.ecs.addComponents(
+      bob, Transform{.position = {2.0f, 0.0f, 0.0f}},
+      PhysicsComponent{.collider = boxAt({2.0f, 0.0f, 0.0f},
+                                         glm::vec3(0.1f))},
+      Constraint{.other = anchor, .distance = 1.0f});
+
+  for (int tick = 0; tick < 10; tick++) scene.step();
+  glm::vec3 position = scene.ecs.getComponent<Transform>(bob)->position;
+  // Pulled in to the anchor, which keeps a zero inverse mass.
+  EXPECT_NEAR(position.x, 1.0f, 1e-3f);
+  EXPECT_NEAR(position.y, 0.0f, 1e-5f);
+  EXPECT_EQ(scene.ecs.getComponent<Transform>(anchor)->position,
+            glm::vec3(0.0f));
+}
+
+TEST(Physics, MasslessRegularBodyIsRejectedOnLoad) {
+  auto vec3 = [](std::string name, glm::vec3 v) {
+    return serializeVec3(std::move(name), v);
+  };
+  auto tree = [&](float mass, int16_t type) {
+    return PropertyTree{
+        "PhysicsComponent",
+        {},
+        {vec3("Velocity", glm::vec3(0.0f)),
+         vec3("Acceleration", glm::vec3(0.0f)),
+         {"Mass", {mass}},
+         {"Type", {type}},
+         {"Material", {}, {{"Friction", {0.5f}}, {"Restitution", {1.0f}}}},
+         {"Collider",
+          {},
+          {vec3("Min", glm::vec3(-1.0f)), vec3("Max", glm::vec3(1.0f))}},
+         {"CollisionSource", {int16_t{3}}}}};
+  };
+  constexpr int16_t kRegular = 0;
+  constexpr int16_t kStatic = 3;
+
+  absl::StatusOr<PhysicsComponent> physics =
+      PhysicsComponent::deserialize(tree(2.0f, kRegular));
+  ASSERT_TRUE(physics.ok()) << physics.status();
+  EXPECT_EQ(physics->mass, 2.0f);
+  EXPECT_EQ(physics->collision_source, 3u);
+
+  EXPECT_FALSE(PhysicsComponent::deserialize(tree(0.0f, kRegular)).ok());
+  EXPECT_FALSE(PhysicsComponent::deserialize(tree(-1.0f, kRegular)).ok());
+  EXPECT_TRUE(PhysicsComponent::deserialize(tree(0.0f, kStatic)).ok());
+}
+
+} // namespace
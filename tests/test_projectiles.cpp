@@ -0,0 +1,121 @@
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "sunset/aabb_batch.h"
+#include "sunset/physics.h"
+#include "sunset/projectiles.h"
+
+namespace {
+
+Entity addWall(ECS &ecs, const AABB &box) {
+  Entity entity = ecs.createEntity();
+  ecs.addComponents(entity, Transform{.position = box.getCenter()},
+                    PhysicsComponent{.type = PhysicsComponent::Type::Static,
+                                     .collider = box});
+  return entity;
+}
+
+TEST(Projectiles, MoveLikeBodies) {
+  ECS ecs;
+  EventQueue event_queue;
+  PhysicsSystem physics;
+
+  glm::vec3 velocity{0.3f, 0.2f, -0.1f};
+  glm::vec3 acceleration{0.0f, -0.01f, 0.0f};
+  Entity body = ecs.createEntity();
+  ecs.addComponents(
+      body, Transform{.position = glm::vec3(0.0f)},
+      PhysicsComponent{.velocity = velocity,
+                       .acceleration = acceleration,
+                       .collider = {glm::vec3(-0.01f), glm::vec3(0.01f)}});
+
+  ProjectileSystem projectiles(1);
+  projectiles.spawn(Projectile{.position = glm::vec3(0.0f),
+                               .velocity = velocity,
+                               .acceleration = acceleration,
+                               .collides = false});
+
+  for (int i = 0; i < 30; i++) {
+    physics.update(ecs, event_queue, physics.step());
+    projectiles.update(ecs, physics, event_queue, physics.step());
+  }
+  glm::vec3 expected = ecs.getComponent<Transform>(body)->position;
+  EXPECT_NEAR(glm::length(projectiles.position(0) - expected), 0.0f,
+              1e-4f);
+}
+
+TEST(Projectiles, StopAtCollidersAndExpire) {
+  ECS ecs;
+  EventQueue event_queue;
+  PhysicsSystem physics;
+  Entity wall = addWall(ecs, {{4.0f, -2.0f, -2.0f}, {5.0f, 2.0f, 2.0f}});
+  physics.update(ecs, event_queue, physics.step());
+
+  std::vector<ProjectileHit> hits;
+  event_queue.subscribe(std::function(
+      [&](const ProjectileHit &hit) { hits.push_back(hit); }));
+
+  ProjectileSystem projectiles(3);
+  // Into the wall, away from it with a short life, and a spark that
+  // flies through it.
+  ASSERT_TRUE(projectiles.spawn(
+      {.position = glm::vec3(0.0f), .velocity = {2.0f, 0.0f, 0.0f},
+       .damage = 4.0f}));
+  ASSERT_TRUE(projectiles.spawn({.position = glm::vec3(0.0f),
+                                 .velocity = {-2.0f, 0.0f, 0.0f},
+                                 .lifetime = 0.5f}));
+  ASSERT_TRUE(projectiles.spawn({.position = {0.0f, 1.0f, 0.0f},
+                                 .velocity = {2.0f, 0.0f, 0.0f},
+                                 .collides = false}));
+  EXPECT_FALSE(projectiles.spawn({.position = glm::vec3(0.0f),
+                                  .velocity = glm::vec3(0.0f)}));
+
+  for (int i = 0; i < 60; i++) {
+    projectiles.update(ecs, physics, event_queue, physics.step());
+    event_queue.process();
+  }
+
+  ASSERT_EQ(hits.size(), 1u);
+  EXPECT_EQ(hits[0].entity, wall);
+  EXPECT_NEAR(hits[0].position.x, 4.0f, 1e-4f);
+  EXPECT_FLOAT_EQ(hits[0].damage, 4.0f);
+
+  ASSERT_EQ(projectiles.size(), 1u);
+  EXPECT_GT(projectiles.position(0).x, 5.0f);
+  EXPECT_FLOAT_EQ(projectiles.position(0).y, 1.0f);
+}
+
+TEST(Projectiles, SimdMatchesScalar) {
+  ECS ecs;
+  EventQueue event_queue;
+  PhysicsSystem physics;
+  std::mt19937 rng(3);
+  std::normal_distribution<float> dist(0.0f, 1.0f);
+
+  // An odd count, so the vector kernels leave a tail.
+  ProjectileSystem vector(37), scalar(37);
+  for (int i = 0; i < 37; i++) {
+    Projectile projectile{
+        .position = {dist(rng), dist(rng), dist(rng)},
+        .velocity = {dist(rng), dist(rng), dist(rng)},
+        .acceleration = {dist(rng) * 0.01f, -0.01f, 0.0f},
+        .collides = false};
+    vector.spawn(projectile);
+    scalar.spawn(projectile);
+  }
+
+  SimdLevel level = simdLevel();
+  for (int i = 0; i < 10; i++) {
+    vector.update(ecs, physics, event_queue, physics.step());
+    setSimdLevel(SimdLevel::Scalar);
+    scalar.update(ecs, physics, event_queue, physics.step());
+    setSimdLevel(level);
+  }
+  for (size_t i = 0; i < 37; i++) {
+    EXPECT_EQ(vector.position(i), scalar.position(i)) << i;
+    EXPECT_EQ(vector.velocity(i), scalar.velocity(i)) << i;
+  }
+}
+
+} // namespace
@@ -261,6 +261,35 @@ TEST(TestPropertyTree, ExplicitlyNamedProperties) {
   ASSERT_EQ(vec2->y, 2.0);
 }
 
+TEST(TestPropertyTree, WriteMatchesRead) {
+  // The Vector2 tree above.
+  PropertyTree vec2{"Vector2", {1.0}, {PropertyTree{"y", {2.0}}}};
+  std::ostringstream output;
+  ASSERT_TRUE(writePropertyTree(output, vec2).ok());
+  EXPECT_EQ(output.str().size(), 52u);
+  EXPECT_EQ(output.str()[0], 0x27);
+
+  PropertyTree tree{"Root",
+                    {uint8_t{1}, int16_t{-2}, int32_t{3}, int64_t{-4},
+                     5.0f, std::string("six"),
+                     std::vector<uint8_t>{7, 8},
+                     std::vector<int32_t>{9, -10},
+                     std::vector<float>{11.5f}},
+                    {vec2, PropertyTree{"Empty"}}};
+  output.str("");
+  ASSERT_TRUE(writePropertyTree(output, tree).ok());
+
+  std::istringstream input(output.str());
+  absl::StatusOr<PropertyTree> read = readPropertyTree(input);
+  ASSERT_TRUE(read.ok());
+  EXPECT_EQ(read->name, "Root");
+  EXPECT_EQ(read->properties, tree.properties);
+  ASSERT_EQ(read->children.size(), 2u);
+  EXPECT_EQ(read->children[0].children[0].properties,
+            vec2.children[0].properties);
+  EXPECT_EQ(read->children[1].name, "Empty");
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
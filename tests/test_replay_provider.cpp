@@ -0,0 +1,125 @@
+#include <filesystem>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "sunset/replay_provider.h"
+
+namespace {
+
+// Plays a fixed script of events, one entry per frame.
+class ScriptedIO : public IOProvider {
+ public:
+  explicit ScriptedIO(std::vector<std::function<void(EventQueue &)>> frames)
+      : frames_(std::move(frames)) {}
+
+  bool poll(EventQueue &event_queue) override {
+    if (frame_ >= frames_.size()) return false;
+    frames_[frame_++](event_queue);
+    return true;
+  }
+
+  bool valid() override { return true; }
+
+ private:
+  std::vector<std::function<void(EventQueue &)>> frames_;
+  size_t frame_{0};
+};
+
+struct Seen {
+  size_t frame;
+  std::string what;
+
+  bool operator==(const Seen &) const = default;
+};
+
+void subscribeAll(EventQueue &queue, std::vector<Seen> &seen,
+                  size_t &frame) {
+  queue.subscribe(std::function([&](const KeyDown &event) {
+    seen.push_back({frame, "down " + std::to_string(int(event.key))});
+  }));
+  queue.subscribe(std::function([&](const KeyPressed &event) {
+    seen.push_back({frame, "pressed " + event.map.to_string()});
+  }));
+  queue.subscribe(std::function([&](const MouseMoved &event) {
+    seen.push_back({frame, "moved " + std::to_string(event.x) + " " +
+                               std::to_string(event.y) + " " +
+                               std::to_string(event.dx) + " " +
+                               std::to_string(event.dy)});
+  }));
+  queue.subscribe(std::function([&](const MouseDown &event) {
+    seen.push_back({frame, "click " + std::to_string(event.button)});
+  }));
+}
+
+} // namespace
+
+TEST(TestReplayProvider, ReplaysFrameExact) {
+  std::filesystem::path path =
+      std::filesystem::temp_directory_path() / "sunset_replay_test.bin";
+
+  KeyPressed held;
+  held.map.set(static_cast<size_t>(Key::W));
+  held.map.set(static_cast<size_t>(Key::F12));
+
+  std::vector<std::function<void(EventQueue &)>> script = {
+      [&](EventQueue &q) { q.send(KeyDown{Key::W, ModShift}); },
+      [&](EventQueue &q) {},
+      [&](EventQueue &q) {
+        q.send(held);
+        q.send(MouseMoved{10.5, 20.25, 1.0, -2.0});
+        q.send(MouseDown{1, 0});
+      },
+      // Idle frames at the end are replayed too.
+      [&](EventQueue &q) {},
+      [&](EventQueue &q) {},
+  };
+
+  std::vector<Seen> recorded;
+  size_t recorded_frames = 0;
+  {
+    EventQueue queue;
+    size_t &frame = recorded_frames;
+    subscribeAll(queue, recorded, frame);
+
+    RecordingIO io(std::make_unique<ScriptedIO>(script), queue, path);
+    ASSERT_TRUE(io.valid());
+    while (io.poll(queue)) {
+      frame++;
+      queue.process();
+    }
+  }
+
+  std::vector<Seen> replayed;
+  size_t replayed_frames = 0;
+  {
+    EventQueue queue;
+    size_t &frame = replayed_frames;
+    subscribeAll(queue, replayed, frame);
+
+    ReplayIO io(path);
+    ASSERT_TRUE(io.valid());
+    while (io.poll(queue)) {
+      frame++;
+      queue.process();
+    }
+  }
+
+  EXPECT_EQ(recorded.size(), 4u);
+  EXPECT_EQ(recorded, replayed);
+  EXPECT_EQ(recorded_frames, script.size());
+  EXPECT_EQ(replayed_frames, recorded_frames);
+
+  std::filesystem::remove(path);
+}
+
+TEST(TestReplayProvider, RejectsGarbage) {
+  std::filesystem::path path =
+      std::filesystem::temp_directory_path() / "sunset_replay_bad.bin";
+  std::ofstream(path) << "not a recording";
+
+  ReplayIO io(path);
+  EXPECT_FALSE(io.valid());
+
+  std::filesystem::remove(path);
+}
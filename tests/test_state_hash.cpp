@@ -0,0 +1,113 @@
+#include <filesystem>
+#include <fstream>
+
+#include <gtest/gtest.h>
+
+#include "sunset/physics.h"
+#include "sunset/state_hash.h"
+
+namespace {
+
+// Three bodies; the middle one moves along x by `speed` per tick.
+struct World {
+  ECS ecs;
+  std::vector<Entity> bodies;
+
+  World() {
+    for (int i = 0; i < 3; i++) {
+      Entity entity = ecs.createEntity();
+      ecs.addComponents(entity,
+                        Transform{.position = glm::vec3(i, 0.0f, 0.0f)},
+                        PhysicsComponent{});
+      bodies.push_back(entity);
+    }
+  }
+
+  void tick(float speed) {
+    ecs.getComponent<PhysicsComponent>(bodies[1])->velocity.x = speed;
+    ecs.getComponent<Transform>(bodies[1])->position.x += speed;
+  }
+};
+
+} // namespace
+
+TEST(StateHash, CoversPositionsAndVelocities) {
+  World a;
+  World b;
+  EXPECT_EQ(hashPhysicsState(a.ecs).hash, hashPhysicsState(b.ecs).hash);
+
+  b.ecs.getComponent<PhysicsComponent>(b.bodies[2])->velocity.y = 1e-6f;
+  EXPECT_NE(hashPhysicsState(a.ecs).hash, hashPhysicsState(b.ecs).hash);
+
+  // Bit for bit: -0 and 0 differ.
+  World c;
+  c.ecs.getComponent<Transform>(c.bodies[0])->position.z = -0.0f;
+  EXPECT_NE(hashPhysicsState(a.ecs).hash, hashPhysicsState(c.ecs).hash);
+}
+
+TEST(StateHash, VerifierFindsFirstDivergence) {
+  std::filesystem::path path =
+      std::filesystem::temp_directory_path() / "sunset_state_hash_test.bin";
+
+  {
+    World world;
+    StateHashRecorder recorder(path);
+    for (int i = 0; i < 6; i++) {
+      world.tick(0.5f);
+      recorder.record(hashPhysicsState(world.ecs));
+    }
+  }
+
+  World same;
+  StateHashVerifier matching(path);
+  ASSERT_TRUE(matching.valid());
+  for (int i = 0; i < 6; i++) {
+    same.tick(0.5f);
+    EXPECT_FALSE(matching.verify(hashPhysicsState(same.ecs)));
+  }
+  EXPECT_FALSE(matching.exhausted());
+  EXPECT_FALSE(matching.verify(hashPhysicsState(same.ecs)));
+  EXPECT_TRUE(matching.exhausted());
+  EXPECT_EQ(matching.ticks(), 6u);
+
+  World other;
+  StateHashVerifier diverging(path);
+  std::optional<Divergence> divergence;
+  for (int i = 0; i < 6 && !divergence; i++) {
+    other.tick(i < 3 ? 0.5f : 0.25f);
+    divergence = diverging.verify(hashPhysicsState(other.ecs));
+  }
+  ASSERT_TRUE(divergence);
+  EXPECT_EQ(divergence->tick, 3u);
+  EXPECT_EQ(divergence->entity, other.bodies[1]);
+
+  std::filesystem::remove(path);
+}
+
+TEST(StateHash, VerifierRejectsCorruptCount) {
+  std::filesystem::path path = std::filesystem::temp_directory_path() /
+                               "sunset_state_hash_corrupt.bin";
+
+  {
+    World world;
+    StateHashRecorder recorder(path);
+    ASSERT_TRUE(recorder.valid());
+    recorder.record(hashPhysicsState(world.ecs));
+  }
+  // Overwrite the body count after the header, tick and hash.
+  {
+    std::fstream file(path, std::ios::binary | std::ios::in |
+                                std::ios::out);
+    file.seekp(4 + sizeof(uint16_t) + sizeof(uint32_t) + sizeof(uint64_t));
+    uint32_t count = 0xffffffff;
+    file.write(reinterpret_cast<const char *>(&count), sizeof(count));
+  }
+
+  World world;
+  StateHashVerifier verifier(path);
+  ASSERT_TRUE(verifier.valid());
+  EXPECT_FALSE(verifier.verify(hashPhysicsState(world.ecs)));
+  EXPECT_FALSE(verifier.valid());
+
+  std::filesystem::remove(path);
+}
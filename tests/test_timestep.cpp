@@ -0,0 +1,45 @@
+#include <gtest/gtest.h>
+
+#include "sunset/timestep.h"
+
+namespace {
+
+TEST(FixedTimestep, RunsWholeStepsAndCarriesTheRest) {
+  FixedTimestep timestep(0.25f);
+
+  EXPECT_EQ(timestep.advance(0.1f), 0);
+  EXPECT_NEAR(timestep.alpha(), 0.4f, 1e-5f);
+
+  EXPECT_EQ(timestep.advance(0.5f), 2);
+  EXPECT_NEAR(timestep.alpha(), 0.4f, 1e-5f);
+
+  EXPECT_EQ(timestep.advance(0.15f), 1);
+  EXPECT_NEAR(timestep.alpha(), 0.0f, 1e-5f);
+}
+
+TEST(FixedTimestep, DropsTimeBeyondMaxSubsteps) {
+  FixedTimestep timestep(0.25f, 3);
+
+  EXPECT_EQ(timestep.advance(10.0f), 3);
+  EXPECT_EQ(timestep.alpha(), 0.0f);
+  EXPECT_EQ(timestep.advance(0.25f), 1);
+}
+
+TEST(FixedTimestep, StepRateIsIndependentOfFrameRate) {
+  FixedTimestep fast(1.0f / 60.0f);
+  FixedTimestep slow(1.0f / 60.0f);
+
+  int fast_steps = 0;
+  for (int frame = 0; frame < 144; frame++) {
+    fast_steps += fast.advance(1.0f / 144.0f);
+  }
+  int slow_steps = 0;
+  for (int frame = 0; frame < 30; frame++) {
+    slow_steps += slow.advance(1.0f / 30.0f);
+  }
+
+  EXPECT_NEAR(fast_steps, 60, 1);
+  EXPECT_NEAR(slow_steps, 60, 1);
+}
+
+} // namespace
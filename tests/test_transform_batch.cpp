@@ -0,0 +1,78 @@
+#include <random>
+
+#include <gtest/gtest.h>
+#include <glm/ext/matrix_transform.hpp>
+
+#include "sunset/aabb_batch.h"
+#include "sunset/transform_batch.h"
+
+namespace {
+
+void expectNear(const glm::mat4 &a, const glm::mat4 &b) {
+  for (int column = 0; column < 4; column++) {
+    for (int row = 0; row < 4; row++) {
+      EXPECT_NEAR(a[column][row], b[column][row], 1e-5f)
+          << "[" << column << "][" << row << "]";
+    }
+  }
+}
+
+// An odd count, so the vector kernels leave a tail.
+constexpr size_t kCount = 37;
+
+struct Poses {
+  TRSBatch batch;
+  std::vector<glm::mat4> expected;
+
+  Poses(uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+    for (size_t i = 0; i < kCount; i++) {
+      glm::vec3 position{dist(rng), dist(rng), dist(rng)};
+      glm::quat rotation = glm::normalize(
+          glm::quat(dist(rng), dist(rng), dist(rng), dist(rng)));
+      float s = scale(rng);
+      batch.push(position, rotation, s);
+
+      glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+      model *= glm::toMat4(rotation);
+      expected.push_back(glm::scale(model, glm::vec3(s)));
+    }
+  }
+};
+
+TEST(TransformBatch, ComposeMatchesGlm) {
+  Poses poses(5);
+  SimdLevel level = simdLevel();
+  for (SimdLevel kernel :
+       {SimdLevel::Scalar, SimdLevel::SSE, SimdLevel::AVX2}) {
+    setSimdLevel(kernel);
+    std::vector<glm::mat4> out(kCount);
+    composeTRS(poses.batch.view(), out);
+    for (size_t i = 0; i < kCount; i++) {
+      SCOPED_TRACE(i);
+      expectNear(out[i], poses.expected[i]);
+    }
+  }
+  setSimdLevel(level);
+}
+
+TEST(TransformBatch, MultiplyMatchesGlm) {
+  Poses parents(6), locals(7);
+  SimdLevel level = simdLevel();
+  for (SimdLevel kernel :
+       {SimdLevel::Scalar, SimdLevel::SSE, SimdLevel::AVX2}) {
+    setSimdLevel(kernel);
+    // In place, as TransformSystem does it.
+    std::vector<glm::mat4> out = locals.expected;
+    multiplyAffine(parents.expected, out, out);
+    for (size_t i = 0; i < kCount; i++) {
+      SCOPED_TRACE(i);
+      expectNear(out[i], parents.expected[i] * locals.expected[i]);
+    }
+  }
+  setSimdLevel(level);
+}
+
+} // namespace
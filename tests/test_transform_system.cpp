@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include "sunset/transform_system.h"
+
+namespace {
+
+void expectNear(const glm::mat4 &a, const glm::mat4 &b) {
+  for (int column = 0; column < 4; column++) {
+    for (int row = 0; row < 4; row++) {
+      EXPECT_NEAR(a[column][row], b[column][row], 1e-5f)
+          << "[" << column << "][" << row << "]";
+    }
+  }
+}
+
+// A root with a child that has a child of its own, and an unrelated
+// entity.
+struct Scene {
+  ECS ecs;
+  Entity root, child, grandchild, other;
+
+  Scene() {
+    root = ecs.createEntity();
+    child = ecs.createEntity();
+    grandchild = ecs.createEntity();
+    other = ecs.createEntity();
+
+    glm::quat turn = glm::angleAxis(0.5f, glm::vec3(0, 1, 0));
+    ecs.addComponents(root, Transform{.position = {1.0f, 0.0f, 0.0f},
+                                      .rotation = turn,
+                                      .scale = 2.0f});
+    ecs.addComponents(child, Transform{.position = {0.0f, 1.0f, 0.0f},
+                                       .rotation = turn,
+                                       .parent = root});
+    ecs.addComponents(grandchild,
+                      Transform{.position = {0.0f, 0.0f, 3.0f},
+                                .rotation = glm::quat(1, 0, 0, 0),
+                                .parent = child});
+    ecs.addComponents(other, Transform{.position = {5.0f, 5.0f, 5.0f},
+                                       .rotation = glm::quat(1, 0, 0, 0)});
+
+    // Components are copied bytewise, so the child lists are filled in
+    // place.
+    ecs.getComponent<Transform>(root)->children.push_back(child);
+    ecs.getComponent<Transform>(child)->children.push_back(grandchild);
+  }
+
+  const glm::mat4 &world(Entity entity) {
+    return ecs.getComponent<Transform>(entity)->cached_model;
+  }
+};
+
+TEST(TransformSystem, MatchesModelMatrix) {
+  Scene scene;
+  TransformSystem transforms;
+  transforms.update(scene.ecs);
+  EXPECT_EQ(transforms.recomputed(), 4u);
+  for (Entity entity :
+       {scene.root, scene.child, scene.grandchild, scene.other}) {
+    expectNear(scene.world(entity),
+               calculateModelMatrix(scene.ecs, entity));
+  }
+}
+
+TEST(TransformSystem, RecomputesOnlyDirtySubtrees) {
+  Scene scene;
+  TransformSystem transforms;
+  transforms.update(scene.ecs);
+  transforms.update(scene.ecs);
+  EXPECT_EQ(transforms.recomputed(), 0u);
+
+  Transform *child = scene.ecs.getComponent<Transform>(scene.child);
+  child->position.x += 1.0f;
+  child->dirty = true;
+  transforms.update(scene.ecs);
+  EXPECT_EQ(transforms.recomputed(), 2u);
+  expectNear(scene.world(scene.grandchild),
+             calculateModelMatrix(scene.ecs, scene.grandchild));
+}
+
+TEST(TransformSystem, RefreshesBlendedMatrices) {
+  Scene scene;
+  TransformSystem transforms;
+  Transform *other = scene.ecs.getComponent<Transform>(scene.other);
+  other->previous = Transform::Pose{{4.0f, 5.0f, 5.0f}, other->rotation};
+
+  transforms.update(scene.ecs, 0.25f);
+  expectNear(scene.world(scene.other),
+             calculateModelMatrix(scene.ecs, scene.other, 0.25f));
+  transforms.update(scene.ecs, 0.75f);
+  EXPECT_EQ(transforms.recomputed(), 1u);
+  expectNear(scene.world(scene.other),
+             calculateModelMatrix(scene.ecs, scene.other, 0.75f));
+
+  // Caught up with the current pose once it stops blending.
+  other->previous = Transform::Pose{other->position, other->rotation};
+  transforms.update(scene.ecs, 0.5f);
+  EXPECT_EQ(transforms.recomputed(), 1u);
+  expectNear(scene.world(scene.other),
+             calculateModelMatrix(scene.ecs, scene.other));
+  transforms.update(scene.ecs, 0.5f);
+  EXPECT_EQ(transforms.recomputed(), 0u);
+}
+
+} // namespace
@@ -203,12 +203,36 @@ class Instance:
     def to_property_tree(self):
         return Node("Instance", children=[Node("Components", children=[c.to_property_tree() for c in self.comps])])
 
+@dataclass
+class PhysicsSettings:
+    # 0: AABB tree, 1: sweep and prune, 2: hash grid, 3: loose octree
+    broadphase: int = 0
+    cell_size: float = 1.0
+    sweep_axis: int = 0
+    bounds: tuple[vec3, vec3] = ((-512.0, -512.0, -512.0), (512.0, 512.0, 512.0))
+    tick_rate: float = 60.0
+    max_substeps: int = 5
+
+    def to_property_tree(self):
+        return Node("PhysicsSettings", children=[
+            Node("Broadphase", props=[self.broadphase]),
+            Node("CellSize", props=[self.cell_size]),
+            Node("SweepAxis", props=[self.sweep_axis]),
+            Node("Bounds", children=[
+                Node("Min", props=list(self.bounds[0])),
+                Node("Max", props=list(self.bounds[1])),
+            ]),
+            Node("TickRate", props=[self.tick_rate]),
+            Node("MaxSubsteps", props=[self.max_substeps]),
+        ])
+
 @dataclass
 class Scene:
     resources: list[Node]
     instances: list[Instance]
 
-def generate_model(s, instances: list[Instance], rsrc: list[Node]):
+def generate_model(s, instances: list[Instance], rsrc: list[Node],
+                   physics: PhysicsSettings | None = None):
     ii = [i.to_property_tree() for i in instances]
 
     scene = Node("Scene", children=[
@@ -216,5 +240,7 @@ def generate_model(s, instances: list[Instance], rsrc: list[Node]):
         Node("Instances", children=ii),
         Node("Resources", children=rsrc),
     ])
+    if physics is not None:
+        scene.children.append(physics.to_property_tree())
 
     write_node(s, scene)